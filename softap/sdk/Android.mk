@@ -59,6 +59,10 @@ ifdef WIFI_DRIVER_DEF_CONF_FILE
 LOCAL_CFLAGS += -DWIFI_DRIVER_DEF_CONF_FILE=\"$(WIFI_DRIVER_DEF_CONF_FILE)\"
 endif
 
+ifeq ($(QSAP_CONFIG_SNAPSHOT),true)
+LOCAL_CFLAGS += -DQSAP_CONFIG_SNAPSHOT
+endif
+
 LOCAL_CFLAGS += -Wall -Wextra -Werror
 
 LOCAL_SRC_FILES := qsap_api.c \
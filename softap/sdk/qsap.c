@@ -377,7 +377,7 @@ end:
     return ret;
 }
 
-s32 wifi_qsap_stop_bss(void)
+s32 wifi_qsap_stop_bss_ctx(qsap_ctx_t *pctx)
 {
 #define QCIEEE80211_IOCTL_STOPBSS   (SIOCIWFIRSTPRIV + 6)
     s32 sock;
@@ -388,18 +388,18 @@ s32 wifi_qsap_stop_bss(void)
     s32 len = 128;
     struct iwreq wrq;
 
-    if(ENABLE != is_softap_enabled()) {
+    if(ENABLE != is_softap_enabled_ctx(pctx)) {
         ret = eERR_BSS_NOT_STARTED;
         return ret;
     }
 
-    if(NULL == (iface = qsap_get_config_value(CONFIG_FILE, &qsap_str[STR_INTERFACE], interface, (u32*)&len))) {
+    if(NULL == (iface = qsap_ctx_get_iface(pctx, interface, (u32*)&len))) {
         ALOGE("%s :interface error \n", __func__);
         return ret;
     }
 
     /* Issue the stopbss command to driver */
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sock = qsap_ctx_get_sock(pctx);
 
     if (sock < 0) {
         ALOGE("Failed to open socket");
@@ -415,7 +415,6 @@ s32 wifi_qsap_stop_bss(void)
 
     /* Here IOCTL is always returning non Zero: temporary fix untill driver is fixed*/
     ret = 0;
-    close(sock);
 
     if (ret) {
         ALOGE("IOCTL stopbss failed: %d", ret);
@@ -429,12 +428,17 @@ s32 wifi_qsap_stop_bss(void)
     return ret;
 }
 
-s32 is_softap_enabled(void)
+s32 wifi_qsap_stop_bss(void)
+{
+    return wifi_qsap_stop_bss_ctx(qsap_ctx_default());
+}
+
+s32 is_softap_enabled_ctx(qsap_ctx_t *pctx)
 {
     s32 mode = 0;
     int ret;
 
-    ret = qsap_get_mode(&mode);
+    ret = qsap_get_mode_ctx(pctx, &mode);
     if (eSUCCESS != ret) {
        ALOGD("Failed to get the mode of operation\n");
        return eERR_UNKNOWN;
@@ -450,6 +454,11 @@ s32 is_softap_enabled(void)
     return DISABLE;
 }
 
+s32 is_softap_enabled(void)
+{
+    return is_softap_enabled_ctx(qsap_ctx_default());
+}
+
 s32 commit(void)
 {
 #ifndef SDK_TEST
@@ -535,15 +544,15 @@ s32 wifi_qsap_stop_softap_in_concurrency()
 #endif
 
 
-s32 wifi_qsap_stop_softap()
+s32 wifi_qsap_stop_softap_ctx(qsap_ctx_t *pctx)
 {
     s32 ret = eSUCCESS;
 
-    if ( is_softap_enabled() ) {
+    if ( is_softap_enabled_ctx(pctx) ) {
         ALOGD("Stopping BSS ..... ");
 
         /** Stop the BSS */
-        if (eSUCCESS != (ret = wifi_qsap_stop_bss()) ) {
+        if (eSUCCESS != (ret = wifi_qsap_stop_bss_ctx(pctx)) ) {
             ALOGE("failed \n");
             return ret;
         }
@@ -553,6 +562,11 @@ s32 wifi_qsap_stop_softap()
     return ret;
 }
 
+s32 wifi_qsap_stop_softap()
+{
+    return wifi_qsap_stop_softap_ctx(qsap_ctx_default());
+}
+
 s32 wifi_qsap_reload_softap()
 {
     s32 ret = eERR_RELOAD_SAP;
@@ -582,7 +596,6 @@ s32 wifi_qsap_reload_softap()
     return eSUCCESS;
 }
 
-static pid_t wigigSoftApPid = 0;
 static const char WIGIG_ENTROPY_FILE[]  = "/data/misc/wifi/wigig_entropy.bin";
 static unsigned char dummy_key[21]      = { 0x02, 0x11, 0xbe, 0x33, 0x43, 0x35,
                                             0x68, 0x47, 0x84, 0x99, 0xa9, 0x2b,
@@ -647,13 +660,14 @@ int wigig_ensure_entropy_file_exists()
     return 0;
 }
 
-s32 wifi_qsap_start_wigig_softap(void)
+s32 wifi_qsap_start_wigig_softap_ctx(qsap_ctx_t *pctx)
 {
+    pid_t *pwigig_pid = qsap_ctx_wigig_pid(pctx);
     pid_t pid = 1;
 
     ALOGD("%s", __func__);
 
-    if (wigigSoftApPid) {
+    if (*pwigig_pid) {
         ALOGE("Wigig SoftAP is already running");
         return eERR_START_SAP;
     }
@@ -677,33 +691,45 @@ s32 wifi_qsap_start_wigig_softap(void)
         exit(-1);
     }
 
-    wigigSoftApPid = pid;
+    *pwigig_pid = pid;
     ALOGD("Wigig SoftAP started successfully");
     usleep(AP_BSS_START_DELAY);
 
     return eSUCCESS;
 }
 
-s32 wifi_qsap_stop_wigig_softap(void)
+s32 wifi_qsap_start_wigig_softap(void)
+{
+    return wifi_qsap_start_wigig_softap_ctx(qsap_ctx_default());
+}
+
+s32 wifi_qsap_stop_wigig_softap_ctx(qsap_ctx_t *pctx)
 {
+    pid_t *pwigig_pid = qsap_ctx_wigig_pid(pctx);
+
     ALOGD("%s", __func__);
 
-    if (wigigSoftApPid == 0) {
+    if (*pwigig_pid == 0) {
         ALOGE("Wigig SoftAP is not running");
         return eSUCCESS;
     }
 
     ALOGD("Stopping the Wigig SoftAP...");
-    kill(wigigSoftApPid, SIGTERM);
-    waitpid(wigigSoftApPid, NULL, 0);
+    kill(*pwigig_pid, SIGTERM);
+    waitpid(*pwigig_pid, NULL, 0);
 
-    wigigSoftApPid = 0;
+    *pwigig_pid = 0;
     ALOGD("Wigig SoftAP stopped successfully");
     usleep(AP_BSS_STOP_DELAY);
     return eSUCCESS;
 }
 
-s32 wifi_qsap_set_tx_power(s32 tx_power)
+s32 wifi_qsap_stop_wigig_softap(void)
+{
+    return wifi_qsap_stop_wigig_softap_ctx(qsap_ctx_default());
+}
+
+s32 wifi_qsap_set_tx_power_ctx(qsap_ctx_t *pctx, s32 tx_power)
 {
 #define QCSAP_IOCTL_SET_MAX_TX_POWER   (SIOCIWFIRSTPRIV + 22)
     s32 sock;
@@ -713,13 +739,13 @@ s32 wifi_qsap_set_tx_power(s32 tx_power)
     s32 len = 128;
     struct iwreq wrq;
 
-    if(NULL == (iface = qsap_get_config_value(CONFIG_FILE, &qsap_str[STR_INTERFACE], interface, (u32*)&len))) {
+    if(NULL == (iface = qsap_ctx_get_iface(pctx, interface, (u32*)&len))) {
         ALOGE("%s :interface error \n", __func__);
         return ret;
     }
 
     /* Issue QCSAP_IOCTL_SET_MAX_TX_POWER ioctl */
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sock = qsap_ctx_get_sock(pctx);
 
     if (sock < 0) {
         ALOGE("%s :socket error \n", __func__);
@@ -732,7 +758,6 @@ s32 wifi_qsap_set_tx_power(s32 tx_power)
     wrq.u.data.flags = 0;
 
     ret = ioctl(sock, QCSAP_IOCTL_SET_MAX_TX_POWER, &wrq);
-    close(sock);
 
     if (ret) {
         ALOGE("%s :IOCTL set tx power failed: %d\n", __func__, ret);
@@ -744,3 +769,8 @@ s32 wifi_qsap_set_tx_power(s32 tx_power)
 
     return ret;
 }
+
+s32 wifi_qsap_set_tx_power(s32 tx_power)
+{
+    return wifi_qsap_set_tx_power_ctx(qsap_ctx_default(), tx_power);
+}
@@ -31,9 +31,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <errno.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <linux/wireless.h>
@@ -41,6 +48,12 @@
 #include <sys/un.h>
 #include <sys/select.h>
 #include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <net/if.h>
@@ -73,9 +86,9 @@
 
 #define UNUSED __attribute__ ((unused))
 
-/** If this variable is enabled, the soft AP is reloaded, after the commit
-  * command is received */
-static volatile int gIniUpdated = 0;
+/** Set of the driver ini parameters (bit index into qsap_str[]) whose value
+  * changed. If any, the soft AP is reloaded, after the commit command is received */
+static volatile u32 gIniUpdated = 0;
 
 /** Supported command requests.
   * WANRING: The enum eCMD_REQ in the file qsap_api.h should be
@@ -97,103 +110,144 @@ s8 *Conf_req[CONF_REQ_LAST] = {
     "60g",
 };
 
+/** Identity of a file found valid by check_for_configuration_files(). The
+  * readers compare it without a lock while an update may be recording it, see
+  * qsap_file_check_match(). 'seq' is odd during the update */
+struct qsap_file_check {
+    u32    seq;
+    u8     valid;
+    dev_t  dev;
+    ino_t  ino;
+    off_t  size;
+    struct timespec mtime;
+};
+
+struct qsap_ctrl_conn;
+
+/** Soft AP instance */
+struct qsap_ctx {
+    s8     conf[MAX_FILE_PATH_LEN];      /** hostapd configuration file */
+    s8     ini[MAX_FILE_PATH_LEN];       /** driver ini file, fIni if empty */
+    s8     iface[IFNAMSIZ];              /** interface, from the configuration file if empty */
+    struct qsap_ctrl_conn *ctrl;         /** hostapd control interface connection, NULL until used */
+    int    sock;                         /** socket for the driver ioctls, -1 until first used */
+    pid_t  wigig_pid;                    /** hostapd of the 60 GHz soft AP, 0 if not started */
+    struct qsap_file_check conf_check;   /** last check of the configuration file */
+};
+
+#define QSAP_STD_CTX(file)    { .conf = file, .sock = -1 }
+
+/** Instance of each request qualifier in Conf_req[], then the default instance */
+static struct qsap_ctx std_ctx[CONF_REQ_LAST + 1] = {
+    [CONF_2g]       = QSAP_STD_CTX(CONFIG_FILE_2G),
+    [CONF_5g]       = QSAP_STD_CTX(CONFIG_FILE_5G),
+    [CONF_owe]      = QSAP_STD_CTX(CONFIG_FILE_OWE),
+    [CONF_60g]      = QSAP_STD_CTX(CONFIG_FILE_60G),
+    [CONF_REQ_LAST] = QSAP_STD_CTX(CONFIG_FILE),
+};
+
+#define DEFAULT_CTX    (&std_ctx[CONF_REQ_LAST])
+
 /*
- * WARNING: On updating the cmd_list, the enum esap_cmd in file
- * qsap_api.h must be updates to reflect the changes
+ * The cmd_list is indexed by the enum esap_cmd in file qsap_api.h, every
+ * command number must have an entry here. The command lookup table built
+ * from this list reports a missing entry.
  */
 static struct Command cmd_list[eCMD_LAST] = {
-    { "ssid",                  "QualcommSoftAP" },
-    { "ignore_broadcast_ssid", "0"              },
-    { "channel",               "1"              },
-    { "beacon_int",            "100"            },
-    { "dtim_period",           "2"              },
-    { "hw_mode",               "n"              },
-    { "auth_algs",             "3"              },
-    { "security_mode",         "0"              },
-    { "wep_key0",              NULL             },
-    { "wep_key1",              NULL             },
-    { "wep_key2",              NULL             },
-    { "wep_key3",              NULL             },
-    { "wep_default_key",       NULL             },
-    { "wpa_passphrase",        NULL             },
-    { "wpa_pairwise",          NULL             },
-    { "rsn_pairwise",          NULL             },
-    { "mac_address",           "00deadbeef04"   },
-    { "reset_ap",              NULL             },
-    { "macaddr_acl",           "0"              },
-    { "add_to_allow_list",     NULL             },
-    { "add_to_deny_list",      NULL             },
-    { "remove_from_allow_list", NULL            },
-    { "remove_from_deny_list", NULL             },
-    { "allow_list",            ""               },
-    { "deny_list",             ""               },
-    { "commit",                NULL             },
-    { "enable_softap",         NULL             },
-    { "disassoc_sta",          NULL             },
-    { "reset_to_default",      NULL             },
-    { "protection_flag",       "1"              },
-    { "data_rate",             "0"              },
-    { "sta_mac_list",          NULL             },
-    { "tx_power",              "27"             },
-    { "sdk_version",           SDK_VERSION      },
-    { "wmm_enabled",           "0"              },
+    [eCMD_SSID]                  = { "ssid",                   "QualcommSoftAP" },
+    [eCMD_BSSID]                 = { "ignore_broadcast_ssid",  "0"              },
+    [eCMD_CHAN]                  = { "channel",                "1"              },
+    [eCMD_BCN_INTERVAL]          = { "beacon_int",             "100"            },
+    [eCMD_DTIM_PERIOD]           = { "dtim_period",            "2"              },
+    [eCMD_HW_MODE]               = { "hw_mode",                "n"              },
+    [eCMD_AUTH_ALGS]             = { "auth_algs",              "3"              },
+    [eCMD_SEC_MODE]              = { "security_mode",          "0"              },
+    [eCMD_WEP_KEY0]              = { "wep_key0",               NULL             },
+    [eCMD_WEP_KEY1]              = { "wep_key1",               NULL             },
+    [eCMD_WEP_KEY2]              = { "wep_key2",               NULL             },
+    [eCMD_WEP_KEY3]              = { "wep_key3",               NULL             },
+    [eCMD_DEFAULT_KEY]           = { "wep_default_key",        NULL             },
+    [eCMD_PASSPHRASE]            = { "wpa_passphrase",         NULL             },
+    [eCMD_WPA_PAIRWISE]          = { "wpa_pairwise",           NULL             },
+    [eCMD_RSN_PAIRWISE]          = { "rsn_pairwise",           NULL             },
+    [eCMD_MAC_ADDR]              = { "mac_address",            "00deadbeef04"   },
+    [eCMD_RESET_AP]              = { "reset_ap",               NULL             },
+    [eCMD_MAC_ACL]               = { "macaddr_acl",            "0"              },
+    [eCMD_ADD_TO_ALLOW]          = { "add_to_allow_list",      NULL             },
+    [eCMD_ADD_TO_DENY]           = { "add_to_deny_list",       NULL             },
+    [eCMD_REMOVE_FROM_ALLOW]     = { "remove_from_allow_list", NULL             },
+    [eCMD_REMOVE_FROM_DENY]      = { "remove_from_deny_list",  NULL             },
+    [eCMD_ALLOW_LIST]            = { "allow_list",             ""               },
+    [eCMD_DENY_LIST]             = { "deny_list",              ""               },
+    [eCMD_COMMIT]                = { "commit",                 NULL             },
+    [eCMD_ENABLE_SOFTAP]         = { "enable_softap",          NULL             },
+    [eCMD_DISASSOC_STA]          = { "disassoc_sta",           NULL             },
+    [eCMD_RESET_TO_DEFAULT]      = { "reset_to_default",       NULL             },
+    [eCMD_PROTECTION_FLAG]       = { "protection_flag",        "1"              },
+    [eCMD_DATA_RATES]            = { "data_rate",              "0"              },
+    [eCMD_ASSOC_STA_MACS]        = { "sta_mac_list",           NULL             },
+    [eCMD_TX_POWER]              = { "tx_power",               "27"             },
+    [eCMD_SDK_VERSION]           = { "sdk_version",            SDK_VERSION      },
+    [eCMD_WMM_STATE]             = { "wmm_enabled",            "0"              },
 
     /** Warning: Do not change the order of the WPS commands */
-    { "wps_state",             "0"              },
-    { "config_methods",        NULL             },
-    { "uuid",                  NULL             },
-    { "device_name",           NULL             },
-    { "manufacturer",          NULL             },
-    { "model_name",            NULL             },
-    { "model_number",          NULL             },
-    { "serial_number",         NULL             },
-    { "device_type",           NULL             },
-    { "os_version",            NULL             },
-    { "friendly_name",         NULL             },
-    { "manufacturer_url",      NULL             },
-    { "model_description",     NULL             },
-    { "model_url",             NULL             },
-    { "upc",                   NULL             },
+    [eCMD_WPS_STATE]             = { "wps_state",              "0"              },
+    [eCMD_WPS_CONFIG_METHOD]     = { "config_methods",         NULL             },
+    [eCMD_UUID]                  = { "uuid",                   NULL             },
+    [eCMD_DEVICE_NAME]           = { "device_name",            NULL             },
+    [eCMD_MANUFACTURER]          = { "manufacturer",           NULL             },
+    [eCMD_MODEL_NAME]            = { "model_name",             NULL             },
+    [eCMD_MODEL_NUMBER]          = { "model_number",           NULL             },
+    [eCMD_SERIAL_NUMBER]         = { "serial_number",          NULL             },
+    [eCMD_DEVICE_TYPE]           = { "device_type",            NULL             },
+    [eCMD_OS_VERSION]            = { "os_version",             NULL             },
+    [eCMD_FRIENDLY_NAME]         = { "friendly_name",          NULL             },
+    [eCMD_MANUFACTURER_URL]      = { "manufacturer_url",       NULL             },
+    [eCMD_MODEL_DESC]            = { "model_description",      NULL             },
+    [eCMD_MODEL_URL]             = { "model_url",              NULL             },
+    [eCMD_UPC]                   = { "upc",                    NULL             },
     /************ WPS commands end *********/
 
-    { "fragm_threshold",       NULL             },
-    { "rts_threshold",         NULL             },
-    { "wpa_group_rekey",       NULL             },
-    { "country_code",          NULL             },
-    { "ap_isolate",            NULL             },
-    { "ieee80211d",            NULL             },
-    { "apstat",                NULL             },
-    { "auto_shut_off_time",    NULL             },
-    { "energy_detect_threshold", "128"          },
-    { "basic_rates",            NULL            },
-    { "require_ht",            NULL             },
-    { "ieee80211n",            "1"              },
-    { "setchannelrange",       NULL             },
-    { "autochannel",           NULL             },
-    { "ieee80211w",            NULL             },
-    { "wpa_key_mgmt",          NULL             },
-    { "max_num_sta",           "8"              },
-    { "ieee80211ac",           NULL             },
-    { "vht_oper_chwidth",      NULL             },
-    { "chanlist",              NULL             },
-    { "ht_capab",              NULL             },
-    { "ieee80211h",            NULL             },
-    { "enable_wigig_softap",   NULL             },
-    { "interface",             NULL             },
-    { "ssid2",                 NULL             },
-    { "bridge",                NULL             },
-    { "ctrl_interface",        NULL             },
-    { "vendor_elements",       NULL             },
-    { "assocresp_elements",    NULL             },
-    { "acs_exclude_dfs",       NULL             },
-    { "wowlan_triggers",       "any"            },
-    { "accept_mac_file",       NULL             },
-    { "deny_mac_file",         NULL             },
-    { "owe_transition_ifname", NULL             },
-    { "sae_require_mfp",       NULL             },
-    { "ieee80211ax",           NULL             },
-    { "enable_edmg",           NULL             },
-    { "edmg_channel",          NULL             },
+    [eCMD_FRAG_THRESHOLD]        = { "fragm_threshold",        NULL             },
+    [eCMD_RTS_THRESHOLD]         = { "rts_threshold",          NULL             },
+    [eCMD_GTK_TIMEOUT]           = { "wpa_group_rekey",        NULL             },
+    [eCMD_COUNTRY_CODE]          = { "country_code",           NULL             },
+    [eCMD_INTRA_BSS_FORWARD]     = { "ap_isolate",             NULL             },
+    [eCMD_REGULATORY_DOMAIN]     = { "ieee80211d",             NULL             },
+    [eCMD_AP_STATISTICS]         = { "apstat",                 NULL             },
+    [eCMD_AP_AUTOSHUTOFF]        = { "auto_shut_off_time",     NULL             },
+    [eCMD_AP_ENERGY_DETECT_TH]   = { "energy_detect_threshold", "128"            },
+    [eCMD_BASIC_RATES]           = { "basic_rates",            NULL             },
+    [eCMD_REQUIRE_HT]            = { "require_ht",             NULL             },
+    [eCMD_IEEE80211N]            = { "ieee80211n",             "1"              },
+    [eCMD_SET_CHANNEL_RANGE]     = { "setchannelrange",        NULL             },
+    [eCMD_GET_AUTO_CHANNEL]      = { "autochannel",            NULL             },
+    [eCMD_IEEE80211W]            = { "ieee80211w",             NULL             },
+    [eCMD_WPA_KEY_MGMT]          = { "wpa_key_mgmt",           NULL             },
+    [eCMD_SET_MAX_CLIENTS]       = { "max_num_sta",            "8"              },
+    [eCMD_IEEE80211AC]           = { "ieee80211ac",            NULL             },
+    [eCMD_VHT_OPER_CH_WIDTH]     = { "vht_oper_chwidth",       NULL             },
+    [eCMD_ACS_CHAN_LIST]         = { "chanlist",               NULL             },
+    [eCMD_HT_CAPAB]              = { "ht_capab",               NULL             },
+    [eCMD_IEEE80211H]            = { "ieee80211h",             NULL             },
+    [eCMD_ENABLE_WIGIG_SOFTAP]   = { "enable_wigig_softap",    NULL             },
+    [eCMD_INTERFACE]             = { "interface",              NULL             },
+    [eCMD_SSID2]                 = { "ssid2",                  NULL             },
+    [eCMD_BRIDGE]                = { "bridge",                 NULL             },
+    [eCMD_CTRL_INTERFACE]        = { "ctrl_interface",         NULL             },
+    [eCMD_VENDOR_ELEMENT]        = { "vendor_elements",        NULL             },
+    [eCMD_ASSOCRESP_ELEMENT]     = { "assocresp_elements",     NULL             },
+    [eCMD_ACS_EXCLUDE_DFS]       = { "acs_exclude_dfs",        NULL             },
+    [eCMD_WOWLAN_TRIGGERS]       = { "wowlan_triggers",        "any"            },
+    [eCMD_ACCEPT_MAC_FILE]       = { "accept_mac_file",        NULL             },
+    [eCMD_DENY_MAC_FILE]         = { "deny_mac_file",          NULL             },
+    [eCMD_OWE_TRANS_IFNAME]      = { "owe_transition_ifname",  NULL             },
+    [eCMD_SAE_REQUIRE_MPF]       = { "sae_require_mfp",        NULL             },
+    [eCMD_IEEE80211AX]           = { "ieee80211ax",            NULL             },
+    [eCMD_ENABLE_EDMG]           = { "enable_edmg",            NULL             },
+    [eCMD_EDMG_CHANNEL]          = { "edmg_channel",           NULL             },
+    [eCMD_BEGIN]                 = { "begin",                  NULL             },
+    [eCMD_ABORT]                 = { "abort",                  NULL             },
 
 };
 
@@ -224,11 +278,21 @@ char *hw_mode[HW_MODE_UNKNOWN] = {
     "b", "g", "n", "g-only", "n-only", "a", "any", "ad"
 };
 
-/** configuration file path */
+/** Configuration file of the default instance, for the requests without a
+  * qualifier and the API functions without a context argument. It is never
+  * changed by a request, the instance of a request is passed down explicitly.
+  */
 char *pconffile = CONFIG_FILE;
 char *fIni =  WIFI_DRIVER_CONF_FILE;
 s8 ini_file[PROPERTY_VALUE_MAX] = {0};
 
+static void qsap_check_config_files(struct qsap_ctx *pctx);
+static void qsap_event_release_ctx(struct qsap_ctx *pctx);
+static void qsap_live_flush(int apply);
+static void qsap_live_release_ctx(struct qsap_ctx *pctx);
+static void qsap_ctrl_conn_release_ctx(struct qsap_ctx *pctx);
+static void qsap_chunk_release_ctx(struct qsap_ctx *pctx);
+
 static int qsap_scnprintf(char *str, size_t size, const char *format, ...)
 {
     va_list arg_ptr;
@@ -242,2322 +306,6799 @@ static int qsap_scnprintf(char *str, size_t size, const char *format, ...)
     return (ret < (int)size) ? ret : (int)(size - 1);
 }
 
+/** Driver ini file of an instance */
+static s8 *qsap_ctx_ini(struct qsap_ctx *pctx)
+{
+    return pctx->ini[0] ? pctx->ini : fIni;
+}
+
 /**
  * @brief
- *        For a give configuration parameter, read the configuration value from the file.
- * @param pfile [IN] configuration file path
- * @param pcmd [IN] pointer to the comand structure
- * @param presp [OUT] buffer to store the configuration value
- * @param plen [IN-OUT] The length of the buffer is provided as input.
- *                      The length of the configuration parameter value, stored
- *                      in the 'presp', is provided as the output
- * @param ignore_comment [IN] if set, read the commented value also
- * @return void
-*/
-static s32 qsap_read_cfg(s8 *pfile, struct Command * pcmd, s8 *presp, u32 *plen, s8 *var, s32 ignore_comment)
+ *        Create a soft AP instance.
+ * @param pconf [IN] hostapd configuration file, CONFIG_FILE if NULL
+ * @param pini [IN] driver ini file, the default ini file if NULL
+ * @param piface [IN] interface, the interface of the configuration file if NULL
+ * @return the instance, to be released with qsap_ctx_destroy(),
+ *         NULL if a path is too long or on lack of memory
+**/
+qsap_ctx_t *qsap_ctx_create(const s8 *pconf, const s8 *pini, const s8 *piface)
 {
-    FILE *fcfg;
-    s8    buf[MAX_CONF_LINE_LEN];
-    u16   len;
-    s8   *val;
+    struct qsap_ctx *pctx;
 
-    /** Open the configuration file */
-    fcfg = fopen(pfile, "r");
+    if(NULL == pconf)
+        pconf = CONFIG_FILE;
 
-    if(NULL == fcfg) {
-        ALOGE("%s : unable to open file \n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-        return eERR_FILE_OPEN;
+    if((strlen(pconf) >= MAX_FILE_PATH_LEN) || (pini && (strlen(pini) >= MAX_FILE_PATH_LEN)) ||
+       (piface && (strlen(piface) >= IFNAMSIZ))) {
+        ALOGE("%s: invalid argument\n", __func__);
+        return NULL;
     }
 
-    /** Read the line from the configuration file */
-    len = strlen(pcmd->name);
-    while(NULL != fgets(buf, MAX_CONF_LINE_LEN, fcfg)) {
-        s8 *pline = buf;
-
-        if (strlen(buf) == 0)
-           continue;
-
-        /** Skip the commented lines */
-        if(buf[0] == '#') {
-            if (ignore_comment) {
-                pline++;
-            }
-            else continue;
-        }
+    if(NULL == (pctx = calloc(1, sizeof(*pctx)))) {
+        ALOGE("%s: out of memory\n", __func__);
+        return NULL;
+    }
 
-        /** Identify the configuration parameter in the configuration file */
-        if(!strncmp(pline, pcmd->name, len) && (pline[len] == '=')) {
-            int tmp_indx;
+    strlcpy(pctx->conf, pconf, sizeof(pctx->conf));
+    if(pini)
+        strlcpy(pctx->ini, pini, sizeof(pctx->ini));
+    if(piface)
+        strlcpy(pctx->iface, piface, sizeof(pctx->iface));
+    pctx->sock = -1;
 
-           /* Delate all \r \n combinations infront of the config string */
-            tmp_indx = strlen(buf)-1;
-            while( (buf[tmp_indx] == '\r') || (buf[tmp_indx] == '\n') ) tmp_indx--;
+    return pctx;
+}
 
-            buf[tmp_indx+1] = '\0';
+/** Release an instance of qsap_ctx_create(). The default instances are not released */
+void qsap_ctx_destroy(qsap_ctx_t *pctx)
+{
+    if((NULL == pctx) || ((pctx >= std_ctx) && (pctx <= DEFAULT_CTX)))
+        return;
 
-            if ( NULL != var ) {
-                val = strchr(pline, '=');
-                if(NULL == val)
-                    break;
-                *plen = qsap_scnprintf(presp, *plen, "%s %s%s", SUCCESS, var, val);
-            }
-            else {
-                *plen = qsap_scnprintf(presp, *plen, "%s %s", SUCCESS, pline);
-            }
-            fclose(fcfg);
-            return eSUCCESS;
-        }
-    }
+    qsap_event_release_ctx(pctx);
+    qsap_live_release_ctx(pctx);
+    qsap_ctrl_conn_release_ctx(pctx);
+    qsap_chunk_release_ctx(pctx);
 
-#if 0
-    /** Configuration parameter is absent in the file */
-    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_FEATURE_NOT_ENABLED);
-#else
-    /** Value not found in the configuration file */
-    /** Send the default value, if we are reading from ini file */
-    if ( pcmd->default_value ) {
-        *plen = qsap_scnprintf(presp, *plen, "%s %s=%s", SUCCESS, var?var:pcmd->name, pcmd->default_value);
-        fclose(fcfg);
-        return eSUCCESS;
-    }
-    else {
-        /** Configuration parameter is absent in the file */
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_FEATURE_NOT_ENABLED);
-    }
-#endif
+    if(pctx->sock >= 0)
+        close(pctx->sock);
+    free(pctx);
 
-    fclose(fcfg);
+    return;
+}
 
-    return eERR_CONFIG_PARAM_MISSING;
+/** Default instance, on CONFIG_FILE */
+qsap_ctx_t *qsap_ctx_default(void)
+{
+    return DEFAULT_CTX;
 }
 
 /**
  * @brief
- *        Write the configuration parameter value into the configuration file.
- * @param pfile [IN] configuration file path.
- * @param pcmd [IN] command name
- * @param pVal [IN] configuration parameter to be written to the file.
- * @param presp [OUT] buffer to store the configuration value.
- * @param plen [IN-OUT] The length of the buffer is provided as input.
- *                      The length of the configuration parameter value, stored
- *                      in the 'presp', is provided as the output
- * @return void
-*/
-static s32 qsap_write_cfg(s8 *pfile, struct Command * pcmd, s8 *pVal, s8 *presp, u32 *plen, s32 inifile)
+ *        Get the interface of an instance.
+ * @param pctx [IN] instance
+ * @param pbuf [OUT] buffer to store the null terminated interface name
+ * @param plen [IN-OUT] length of the buffer, length of the name on return
+ * @return pointer to the interface name, NULL if it can not be read
+**/
+s8 *qsap_ctx_get_iface(qsap_ctx_t *pctx, s8 *pbuf, u32 *plen)
 {
-    FILE *fcfg, *ftmp;
-    s8 buf[MAX_CONF_LINE_LEN+1];
-    s16 len, result = FALSE;
-
-    ALOGD("cmd=%s, Val:%s, INI:%d \n", pcmd->name, pVal, inifile);
+    s8 *pif;
 
-    /** Open the configuration file */
-    fcfg = fopen(pfile, "r");
-    if(NULL == fcfg) {
-        ALOGE("%s : unable to open file \n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-        return eERR_FILE_OPEN;
+    if(pctx->iface[0]) {
+        *plen = qsap_scnprintf(pbuf, *plen, "%s", pctx->iface);
+        return pbuf;
     }
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pfile);
-
-    /** Open a temporary file */
-    ftmp = fopen(buf, "w+");
-    if(NULL == ftmp) {
-        ALOGE("%s : unable to open tmp file \n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-        fclose(fcfg);
-        return eERR_FILE_OPEN;
-    }
+    if(NULL == (pif = qsap_get_config_value(pctx->conf, &qsap_str[STR_INTERFACE], pbuf, plen)))
+        return NULL;
+    pbuf[*plen] = '\0';
 
-    /** Read the values from the configuration file */
-    len = strlen(pcmd->name);
-    while(NULL != fgets(buf, MAX_CONF_LINE_LEN, fcfg)) {
-        s8 *pline = buf;
+    return pif;
+}
 
-        /** commented line */
-        if(buf[0] == '#')
-            pline++;
-
-        /** Identify the configuration parameter to be updated */
-        if((!strncmp(pline, pcmd->name, len)) && (result == FALSE)) {
-            if(pline[len] == '=') {
-                qsap_scnprintf(buf, sizeof(buf), "%s=%s\n", pcmd->name, pVal);
-                result = TRUE;
-                ALOGD("Updated:%s\n", buf);
-            }
-        }
+/** Socket for the driver ioctls of an instance, opened on first use. It is
+  * owned by the instance, the caller must not close it */
+int qsap_ctx_get_sock(qsap_ctx_t *pctx)
+{
+    int sock = __atomic_load_n(&pctx->sock, __ATOMIC_ACQUIRE);
+    int none = -1;
 
-        if(inifile && (!strncmp(pline, "END", 3)))
-            break;
+    if(sock >= 0)
+        return sock;
 
-        fprintf(ftmp, "%s", buf);
-    }
+    if((sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+        return sock;
 
-    if (result == FALSE) {
-        /* Configuration line not found */
-        /* Add the new line at the end of file */
-        qsap_scnprintf(buf, sizeof(buf), "%s=%s\n", pcmd->name, pVal);
-        fprintf(ftmp, "%s", buf);
-        ALOGD("Adding a new line in %s file: [%s] \n", inifile ? "inifile" : "hostapd.conf", buf);
+    /** Another thread may have opened it meanwhile */
+    if(!__atomic_compare_exchange_n(&pctx->sock, &none, sock, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        close(sock);
+        sock = none;
     }
 
-    if(inifile) {
-        gIniUpdated = 1;
-        fprintf(ftmp, "END\n");
-        while(NULL != fgets(buf, MAX_CONF_LINE_LEN, fcfg))
-            fprintf(ftmp, "%s", buf);
-    }
+    return sock;
+}
 
-    fclose(fcfg);
-    fclose(ftmp);
+/** Process id of the 60 GHz hostapd of an instance */
+pid_t *qsap_ctx_wigig_pid(qsap_ctx_t *pctx)
+{
+    return &pctx->wigig_pid;
+}
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pfile);
+/** Destination of the response of a request. A fixed buffer keeps the parts
+  * of the response that fit, a growable buffer is reallocated as needed.
+  */
+struct qsap_resp {
+    s8  *buf;     /** response buffer, null terminated */
+    u32  size;    /** size of the buffer */
+    u32  len;     /** length of the response in the buffer */
+    u8   grow;    /** the buffer is allocated, and grows as needed */
+    u8   full;    /** a part of the response did not fit in the buffer */
+};
 
-    /** Restore the updated configuration file */
-    result = rename(buf, pfile);
+/** Initial size of a growable response buffer */
+#define QSAP_RESP_INIT_SIZE    (MAX_RESP_LEN + 1)
 
-    *plen = qsap_scnprintf(presp, *plen, "%s", (result == eERR_UNKNOWN) ? ERR_FEATURE_NOT_ENABLED : SUCCESS);
+static void qsap_resp_init(struct qsap_resp *pr, s8 *pbuf, u32 size)
+{
+    pr->buf = pbuf;
+    pr->size = size;
+    pr->len = 0;
+    pr->grow = FALSE;
+    pr->full = FALSE;
+    if(size > 0)
+        pbuf[0] = '\0';
+}
 
-    /** Remove the temporary file. Dont care the return value */
-    unlink(buf);
+/** Drop the response stored so far, the buffer is kept */
+static void qsap_resp_reset(struct qsap_resp *pr)
+{
+    pr->len = 0;
+    pr->full = FALSE;
+    if(pr->size > 0)
+        pr->buf[0] = '\0';
+}
 
-    /* chmod is needed because open() didn't set permisions properly */
-    if (chmod(pfile, 0660) < 0) {
-        ALOGE("Error changing permissions of %s to 0660: %s",
-                pfile, strerror(errno));
-        unlink(pfile);
-        return -1;
+static s32 qsap_resp_init_alloc(struct qsap_resp *pr)
+{
+    if(NULL == (pr->buf = malloc(QSAP_RESP_INIT_SIZE))) {
+        ALOGE("%s: out of memory\n", __func__);
+        return eERR_UNKNOWN;
     }
-    if(result == eERR_UNKNOWN)
-        return eERR_FEATURE_NOT_ENABLED;
+    pr->size = QSAP_RESP_INIT_SIZE;
+    pr->len = 0;
+    pr->grow = TRUE;
+    pr->full = FALSE;
+    pr->buf[0] = '\0';
 
     return eSUCCESS;
 }
 
 /**
- * @brief Read the security mode set in the configuration
- * @param pfile [IN] configuration file path.
- * @param presp [OUT] buffer to store the security mode.
- * @param plen [IN-OUT] The length of the buffer is provided as input.
- *                      The length of the security mode value, stored
- *                      in the 'presp', is provided as the output
- * @return void
-*/
-static sec_mode_t qsap_read_security_mode(s8 *pfile, s8 *presp, u32 *plen)
+ * @brief
+ *        Get the space at the end of the response, for want more bytes
+ *        and the null termination. A growable buffer is extended to fit.
+ * @param pr [IN-OUT] response
+ * @param want [IN] number of bytes to be written
+ * @param pavail [OUT] available space, including the null termination
+ * @return pointer to the end of the response
+**/
+static s8 *qsap_resp_space(struct qsap_resp *pr, u32 want, u32 *pavail)
 {
-    sec_mode_t mode;
-    u32 temp = *plen;
-
-    /** Read the WEP default key */
-    qsap_read_cfg(pfile, &cmd_list[eCMD_DEFAULT_KEY], presp, plen, NULL, GET_ENABLED_ONLY);
-
-    if ( !strcmp(presp, ERR_FEATURE_NOT_ENABLED) ) {
-        *plen = temp;
+    if(pr->grow && (pr->size - pr->len < want + 1)) {
+        u32 size = pr->size * 2;
+        s8 *pbuf;
 
-        /* WEP, is not enabled */
+        if(size < pr->len + want + 1)
+            size = pr->len + want + 1;
 
-        /** Read WPA security status */
-        qsap_read_cfg(pfile, &qsap_str[STR_WPA], presp, plen, NULL, GET_ENABLED_ONLY);
-        if ( !strcmp(presp, ERR_FEATURE_NOT_ENABLED) ) {
-            /** WPA is disabled, No security */
-            mode = SEC_MODE_NONE;
-        }
-        else {
-            /** WPA, WPA2 or WPA-WPA2 mixed security */
-            s8 * ptmp = presp;
-            while((*plen)-- && (*ptmp++ != '=') );
-            mode =     *plen ? (
-                    *ptmp == '1' ? SEC_MODE_WPA_PSK :
-                    *ptmp == '2' ? SEC_MODE_WPA2_PSK :
-                    *ptmp == '3' ? SEC_MODE_WPA_WPA2_PSK : SEC_MODE_INVALID ): SEC_MODE_INVALID;
-        }
-    }
-    else {
-        /** Verify if, WPA is disabled */
-        *plen = temp;
-        qsap_read_cfg(pfile, &qsap_str[STR_WPA], presp, plen, NULL, GET_ENABLED_ONLY);
-        if ( !strcmp(presp, ERR_FEATURE_NOT_ENABLED) ) {
-            /** WPA is disabled, hence WEP is enabled */
-            mode = SEC_MODE_WEP;
+        if(NULL != (pbuf = realloc(pr->buf, size))) {
+            pr->buf = pbuf;
+            pr->size = size;
         }
         else {
-            *plen = qsap_scnprintf(presp, temp, "%s", ERR_UNKNOWN);
-            return SEC_MODE_INVALID;
+            ALOGE("%s: out of memory\n", __func__);
         }
     }
 
-    if(mode != SEC_MODE_INVALID) {
-        *plen = qsap_scnprintf(presp, temp,"%s %s=%d", SUCCESS, cmd_list[eCMD_SEC_MODE].name, mode);
-    }
-    else {
-        *plen = qsap_scnprintf(presp, temp,"%s", ERR_NOT_SUPPORTED);
-    }
+    *pavail = pr->size - pr->len;
 
-    return mode;
+    return pr->buf + pr->len;
 }
 
 /**
  * @brief
- *         Enable or disable a configuration parameter in the configuration file.
- * @param pfile [IN] configuration file name
- * @param pcmd [IN] configuration command structure
- * @param status [IN] status to be set. The valid values are 'ENABLE' or 'DISABLE'
- * @return On success, return 0
- *         On failure, return -1
-*/
-static s32 qsap_change_cfg(s8 *pfile, struct Command * pcmd, u32 status)
+ *        Append formatted text to the response. The text is added as a whole:
+ *        if it does not fit in a fixed buffer, nothing is added and the
+ *        response is marked full.
+ * @return On success, eSUCCESS
+ *         If the text does not fit, eERR_UNKNOWN
+**/
+static s32 qsap_resp_printf(struct qsap_resp *pr, const char *format, ...)
 {
-    FILE *fcfg, *ftmp;
-    s8 buf[MAX_CONF_LINE_LEN+1];
-    u16 len;
+    va_list arg_ptr;
+    s8 *pout;
+    u32 avail;
+    int ret;
 
-    /** Open the configuartion file */
-    fcfg = fopen(pfile, "r");
-    if(NULL == fcfg) {
-        ALOGE("%s : unable to open file \n", __func__);
+    if(pr->full)
         return eERR_UNKNOWN;
-    }
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pfile);
+    pout = qsap_resp_space(pr, MAX_CONF_LINE_LEN, &avail);
+    va_start(arg_ptr, format);
+    ret = vsnprintf(pout, avail, format, arg_ptr);
+    va_end(arg_ptr);
+
+    if((ret >= 0) && ((u32)ret >= avail) && pr->grow) {
+        pout = qsap_resp_space(pr, ret, &avail);
+        va_start(arg_ptr, format);
+        ret = vsnprintf(pout, avail, format, arg_ptr);
+        va_end(arg_ptr);
+    }
 
-    /** Open a temporary file */
-    ftmp = fopen(buf, "w");
-    if(NULL == ftmp) {
-        ALOGE("%s : unable to open tmp file \n", __func__);
-        fclose(fcfg);
+    if((ret < 0) || ((u32)ret >= avail)) {
+        if(avail > 0)
+            *pout = '\0';
+        pr->full = TRUE;
         return eERR_UNKNOWN;
     }
 
-    /** Read the configuration parameters from the configuration file */
-    len = strlen(pcmd->name);
-    while(NULL != fgets(buf+1, MAX_CONF_LINE_LEN, fcfg)) {
-        s8 *p = buf+1;
-
-        /** Commented line */
-        if(p[0] == '#')
-            p++;
-
-        /** Identify the configuration parameter */
-        if(!strncmp(p, pcmd->name, len)) {
-            if(p[len] == '=') {
-                if(status == DISABLE) {
-                    fprintf(ftmp, "#%s", p);
-                }
-                else {
-                    fprintf(ftmp, "%s", p);
-                }
-                continue;
-            }
-        }
-        fprintf(ftmp, "%s", buf+1);
-    }
+    pr->len += ret;
 
-    fclose(fcfg);
-    fclose(ftmp);
+    return eSUCCESS;
+}
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pfile);
+/** Number of configuration files kept parsed in memory */
+#define QSAP_CFG_CACHE_MAX   (8)
 
-    /** Restore the new configuration file */
-    if(eERR_UNKNOWN == rename(buf, pfile)) {
-        ALOGE("unable to rename the file \n");
-        return eERR_UNKNOWN;
-    }
+/** Object released once no lock-free reader can be using it, see qsap_rcu_retire() */
+struct qsap_rcu_head {
+    struct qsap_rcu_head *next;
+    void (*release)(struct qsap_rcu_head *phead);
+};
 
-    /** Delete the temporary file */
-    unlink(buf);
+/** A line of a parsed configuration file. A line starting with '#' is
+  * 'commented', i.e. the parameter is disabled, and its text excludes the '#'.
+  * Enabling or disabling a parameter only changes this flag, the '#' is added
+  * back when the file is written.
+  * The key and the value point into the line text, which is either a part of
+  * the file image held by 'struct qsap_cfg' or, for a line updated in memory,
+  * the buffer 'alloc'. Lines which are not of the form [#]key=value have a
+  * zero 'klen'.
+  */
+struct qsap_cfg_line {
+    s8  *text;
+    u32  len;
+    s8  *key;
+    u32  klen;
+    s8  *val;
+    u32  vlen;
+    u8   commented;
+    s8  *alloc;
+};
 
-    /* chmod is needed because open() didn't set permisions properly */
-    if (chmod(pfile, 0660) < 0) {
-        ALOGE("Error changing permissions of %s to 0660: %s",
-                pfile, strerror(errno));
-        unlink(pfile);
-        return -1;
+/** Mapped configuration file, shared by a parsed image and its staged copies */
+struct qsap_cfg_map {
+    s8    *data;
+    size_t len;
+    u32    ref;
+};
+
+/** In-memory image of a configuration file, indexed by the command number.
+  * The image is valid as long as the file is not replaced or modified, which
+  * is detected by comparing the device, inode, size and mtime of the file.
+  * The file is mapped read-only and scanned in place. The SDK always replaces
+  * a configuration file by renaming a new one over it, so the mapped inode is
+  * never truncated under the image.
+  * A published image, in cfg_cache[], is never modified, so that the readers
+  * use it without any lock. An update is made on a copy staged in
+  * cfg_staged[], which is 'dirty' once changed. The copy replaces the
+  * published image once it is written to the file, at the end of the update or
+  * on commit of a transaction.
+  */
+struct qsap_cfg {
+    /** Must be the first member, see qsap_cfg_release() */
+    struct qsap_rcu_head rcu;
+    s8     path[MAX_FILE_PATH_LEN];
+    dev_t  dev;
+    ino_t  ino;
+    off_t  size;
+    struct timespec mtime;
+    u32    stamp;
+    /** Request pass in which the file identity was checked last */
+    u32    pass;
+    u8     dirty;
+    u8     noeol;
+    s8    *data;
+    /** NULL for an empty file */
+    struct qsap_cfg_map *map;
+    struct qsap_cfg_line *lines;
+    u32    nlines;
+    /** First line starting with "END", in the ini file. -1 if absent */
+    s32    end_line;
+    /** First line of each parameter, indexed by [GET_ENABLED_ONLY] and
+      * [GET_COMMENTED_VALUE]. -1 if the parameter is absent */
+    s32    cmd_line[eCMD_LAST][2];
+    s32    str_line[eSTR_LAST][2];
+};
+
+/** Published images, replaced atomically */
+static struct qsap_cfg *cfg_cache[QSAP_CFG_CACHE_MAX];
+/** Images being updated, used only by the thread holding cfg_lock */
+static struct qsap_cfg *cfg_staged[QSAP_CFG_CACHE_MAX];
+static u32 cfg_stamp;
+
+/** Current request pass of the thread, 0 outside of a pass. Within a pass, a
+  * file checked once is not checked again, so that a request reading many
+  * parameters touches each file at most once */
+static __thread u32 cfg_pass;
+static u32 cfg_pass_seq;
+
+/** Image of an empty file, which can not be mapped */
+static s8 cfg_empty[1];
+
+/** If this variable is enabled, a thread has a transaction open: its
+  * configuration updates are staged in the parsed configuration images, and
+  * written to the files on commit. Until then, the other threads of the
+  * process may not update the configuration, and read the published images */
+static int gTransaction = 0;
+/** Set in the thread which opened the transaction. Its readers see the staged
+  * updates, so they hold the lock */
+static __thread u8 cfg_tx_owner;
+
+/** Lock of the configuration updates.
+  * The readers do not take it: they run in a read-side section, see
+  * qsap_rcu_read_lock(), and use only the published images and snapshots,
+  * which are replaced but never modified. A reader which would have to fix a
+  * configuration file asks for a retry, and runs again holding the lock.
+  * The updates hold the lock together with an exclusive flock on
+  * QSAP_LOCK_FILE, so that the processes sharing the configuration files do
+  * not lose each other's updates. The flock is held for one request only, an
+  * open transaction does not hold up the other processes. A file they update
+  * meanwhile makes the commit of the transaction fail.
+  */
+static pthread_mutex_t cfg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Lock file shared by the processes updating the configuration files. The
+  * configuration files themselves are replaced on update, and can not hold
+  * the lock */
+#define QSAP_LOCK_FILE    "/data/vendor/wifi/hostapd/.qsap.lock"
+static int cfg_lock_fd = -1;
+
+#define QSAP_LOCK_READ     (0)
+#define QSAP_LOCK_WRITE    (1)
+
+/** Nesting depth and mode of the lock held by the thread */
+static __thread u32 cfg_lock_depth;
+static __thread u8 cfg_lock_mode;
+/** Set when the request of the thread must run again holding the lock */
+static __thread u8 cfg_lock_retry;
+
+/** Read-side sections, counted by phase. An object retired in a phase is
+  * released once the phase changed and the readers counted in it left, as
+  * none of them can still be using the object. The objects are retired by any
+  * thread, and released by the thread holding cfg_lock, which never waits for
+  * the readers */
+static u32 rcu_phase;
+static u32 rcu_readers[2];
+static struct qsap_rcu_head *rcu_retired;
+/** Objects retired before the last phase change, waiting for its readers */
+static struct qsap_rcu_head *rcu_waiting;
+/** Counter of the read-side section of the thread */
+static __thread u8 rcu_idx;
+
+/**
+ * @brief
+ *        Enter a read-side section. The published images and snapshots seen in
+ *        the section stay valid until qsap_rcu_read_unlock().
+*/
+static void qsap_rcu_read_lock(void)
+{
+    u32 phase;
+
+    /** A reader counted in a phase which has already changed would not be
+      * waited for, it is counted in the current phase instead */
+    do {
+        phase = __atomic_load_n(&rcu_phase, __ATOMIC_SEQ_CST);
+        rcu_idx = phase & 1;
+        __atomic_add_fetch(&rcu_readers[rcu_idx], 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&rcu_phase, __ATOMIC_SEQ_CST) == phase)
+            break;
+        __atomic_sub_fetch(&rcu_readers[rcu_idx], 1, __ATOMIC_SEQ_CST);
+    } while(1);
+}
+
+static void qsap_rcu_read_unlock(void)
+{
+    __atomic_sub_fetch(&rcu_readers[rcu_idx], 1, __ATOMIC_SEQ_CST);
+}
+
+/** Release an object once the readers which may be using it left. The object
+  * must already be unreachable from the published slots */
+static void qsap_rcu_retire(struct qsap_rcu_head *phead)
+{
+    phead->next = __atomic_load_n(&rcu_retired, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&rcu_retired, &phead->next, phead, FALSE,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        ;
+}
+
+static int qsap_rcu_pending(void)
+{
+    return (NULL != __atomic_load_n(&rcu_retired, __ATOMIC_RELAXED)) ||
+           (NULL != __atomic_load_n(&rcu_waiting, __ATOMIC_RELAXED));
+}
+
+static void qsap_rcu_release(struct qsap_rcu_head *phead)
+{
+    struct qsap_rcu_head *pnext;
+
+    for(; phead; phead = pnext) {
+        pnext = phead->next;
+        phead->release(phead);
     }
-    return 0;
 }
 
 /**
  * @brief
- *         Set the security mode in the configuration. The security mode
- *         can be :
- *                   1. No security
- *                   2. WEP
- *                   3. WPA
- *                   4. WPA2
- *                   5. WPA and WPA2 mixed mode
- * @param pfile [IN] configuration file name
- * @param sec_mode [IN] security mode to be set
- * @param presp [OUTPUT] presp The command output format :
- *                    On success,
- *                            success <cmd>=<value>
- *                    On failure,
- *                            failure <error message>
- * @param plen [IN-OUT] plen
- *                      [IN] The length of the buffer, presp
- *                      [OUT] The length of the response in the buffer, presp
+ *        Release the retired objects which no reader can be using. Called with
+ *        cfg_lock held. The objects of the readers still running are released
+ *        by a later call.
  * @return void
 */
-static void qsap_set_security_mode(s8 *pfile, u32 sec_mode, s8 *presp, u32 *plen)
+static void qsap_rcu_reclaim(void)
 {
-    s16 wep, wpa;
-    s8 sec[MAX_INT_STR];
-    s32 rsn_status = DISABLE;
-    s32 ret = eERR_UNKNOWN;
+    struct qsap_rcu_head *plist;
+    u32 prev;
 
-    /** Is valid security mode ? */
-    if(sec_mode >= SEC_MODE_INVALID) {
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
-        return;
+    plist = __atomic_load_n(&rcu_waiting, __ATOMIC_RELAXED);
+    if(NULL != plist) {
+        prev = (__atomic_load_n(&rcu_phase, __ATOMIC_SEQ_CST) - 1) & 1;
+        if(__atomic_load_n(&rcu_readers[prev], __ATOMIC_SEQ_CST))
+            return;
+        __atomic_store_n(&rcu_waiting, NULL, __ATOMIC_RELAXED);
+        qsap_rcu_release(plist);
     }
 
-    /** No security */
-    if(SEC_MODE_NONE == sec_mode) {
-        wep = DISABLE;
-        wpa = DISABLE;
+    plist = __atomic_exchange_n(&rcu_retired, NULL, __ATOMIC_SEQ_CST);
+    if(NULL == plist)
+        return;
+
+    /** The readers entering from now on can not find the objects retired */
+    prev = __atomic_fetch_add(&rcu_phase, 1, __ATOMIC_SEQ_CST) & 1;
+    if(__atomic_load_n(&rcu_readers[prev], __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&rcu_waiting, plist, __ATOMIC_RELAXED);
+        return;
     }
-    /** WEP security */
-    else if(SEC_MODE_WEP == sec_mode) {
-        wep = ENABLE;
-        wpa = DISABLE;
-    }
-    else {
-        /** WPA, WPA2 and mixed-mode security */
-        u16 wpa_val = 0;
-        u32 tmp = *plen;
-
-        wep = DISABLE;
-        wpa = ENABLE;
-
-        if(sec_mode == SEC_MODE_WPA_PSK)
-            wpa_val = WPA_IN_CONF_FILE;
-
-        else if(sec_mode == SEC_MODE_WPA2_PSK) {
-            wpa_val = WPA2_IN_CONF_FILE;
-            rsn_status = ENABLE;
-        }
-
-        else if(sec_mode == SEC_MODE_WPA_WPA2_PSK) {
-            wpa_val = WPA_WPA2_IN_CONF_FILE;
-            rsn_status = ENABLE;
-        }
 
-        qsap_scnprintf(sec, sizeof(sec), "%u", wpa_val);
-        qsap_write_cfg(pfile, &qsap_str[STR_WPA], sec, presp, plen, HOSTAPD_CONF_QCOM_FILE);
-        *plen = tmp;
-    }
+    qsap_rcu_release(plist);
+}
 
-    /** The configuration parameters for the security to be set are enabled
-      * and the configuration parameters for the other security types are
-      * disabled in the configuration file
-      */
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_DEFAULT_KEY], wep)) {
-        ALOGE("%s: wep_default_key error\n", __func__);
-        goto end;
+/**
+ * @brief
+ *        Take the configuration lock. A nested call only counts, the mode of
+ *        the outermost call applies.
+ * @param mode [IN] QSAP_LOCK_READ or QSAP_LOCK_WRITE
+ * @return void
+*/
+static void qsap_lock(u8 mode)
+{
+    if(cfg_lock_depth++) {
+        if((mode == QSAP_LOCK_WRITE) && (cfg_lock_mode == QSAP_LOCK_READ))
+            ALOGE("%s : update in a read-side section \n", __func__);
+        return;
     }
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_WEP_KEY0], wep)) {
-        ALOGE("%s: CMD_WEP_KEY0 \n", __func__);
-        goto end;
-    }
+    /** The staged images of an open transaction are read under the lock */
+    if((mode == QSAP_LOCK_READ) && cfg_tx_owner)
+        mode = QSAP_LOCK_WRITE;
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_WEP_KEY1], wep)) {
-        ALOGE("%s: CMD_WEP_KEY1 \n", __func__);
-        goto end;
-    }
+    cfg_lock_mode = mode;
+    cfg_lock_retry = FALSE;
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_WEP_KEY2], wep)) {
-        ALOGE("%s: CMD_WEP_KEY2 \n", __func__);
-        goto end;
+    if(mode == QSAP_LOCK_READ) {
+        qsap_rcu_read_lock();
+        return;
     }
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_WEP_KEY3], wep)) {
-        ALOGE("%s: CMD_WEP_KEY3 \n", __func__);
-        goto end;
-    }
+    pthread_mutex_lock(&cfg_lock);
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_PASSPHRASE], wpa)) {
-        ALOGE("%s: Passphrase error\n", __func__);
-        goto end;
-    }
+    if(cfg_lock_fd < 0)
+        cfg_lock_fd = TEMP_FAILURE_RETRY(open(QSAP_LOCK_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0660));
+    if((cfg_lock_fd >= 0) && (TEMP_FAILURE_RETRY(flock(cfg_lock_fd, LOCK_EX)) < 0))
+        ALOGE("%s : flock failed: %s \n", __func__, strerror(errno));
+}
 
-    if((sec_mode != SEC_MODE_NONE) && (sec_mode != SEC_MODE_WEP)) {
-        u32 state = !rsn_status;
+/**
+ * @brief
+ *        Release the configuration lock.
+ * @param pmode [IN-OUT] mode of the lock, may be NULL for QSAP_LOCK_WRITE.
+ *                       Set to QSAP_LOCK_WRITE if the request must be run
+ *                       again holding the lock.
+ * @return TRUE if the request must be run again, FALSE otherwise
+*/
+static int qsap_unlock(u8 *pmode)
+{
+    if(--cfg_lock_depth)
+        return FALSE;
 
-        if(sec_mode == SEC_MODE_WPA_WPA2_PSK) state = ENABLE;
+    if(cfg_lock_mode == QSAP_LOCK_WRITE) {
+        if(cfg_lock_fd >= 0)
+            flock(cfg_lock_fd, LOCK_UN);
 
-        if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_WPA_PAIRWISE], state)) {
-            ALOGE("%s: WPA Pairwise\n", __func__);
-            goto end;
-        }
+        qsap_rcu_reclaim();
+        pthread_mutex_unlock(&cfg_lock);
+        return FALSE;
     }
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &cmd_list[eCMD_RSN_PAIRWISE], rsn_status)) {
-        ALOGE("%s: WPA2 Pairwise\n", __func__);
-        goto end;
-    }
+    qsap_rcu_read_unlock();
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pfile, &qsap_str[STR_WPA], wpa)) {
-        ALOGE("%s: WPA\n", __func__);
-        goto end;
+    /** Release the images the readers replaced, unless an update is running */
+    if(qsap_rcu_pending() && (0 == pthread_mutex_trylock(&cfg_lock))) {
+        qsap_rcu_reclaim();
+        pthread_mutex_unlock(&cfg_lock);
     }
 
-    ret = eSUCCESS;
+    if(cfg_lock_retry && pmode) {
+        *pmode = QSAP_LOCK_WRITE;
+        return TRUE;
+    }
 
-end:
-    *plen = qsap_scnprintf(presp, *plen, "%s", (ret == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
+    return FALSE;
+}
 
-    return;
+/** Check if another thread has a transaction open, the thread may not update the configuration */
+static int qsap_tx_busy(void)
+{
+    return __atomic_load_n(&gTransaction, __ATOMIC_RELAXED) && !cfg_tx_owner;
 }
 
 /**
  * @brief
- *         Get the file path having the allow or deny MAC address list
- * @param pcfgfile [IN] configuration file name
- * @param pcmd [IN] pcmd pointer to the command string
- * @param pfile [OUT] buffer to store the return value, containing the file name
- *                   or the error message.
- * @param plen [IN-OUT] size of the buffer 'pfile', is provided as input and
- *                      the length of the file name is returned as output
- * @return
- *           On success, a pointer to the file name in the buffer 'pfile'.
- *           On failure, NULL is returned
+ *        Check if the thread may update the configuration files. A reader may
+ *        not, and is marked for a retry with the lock held.
+ * @return TRUE if the update is allowed
 */
-static s8 *qsap_get_allow_deny_file_name(s8 *pcfgfile, struct Command * pcmd, s8 *pfile, u32 *plen)
+static int qsap_lock_update(void)
 {
-    if(eSUCCESS == qsap_read_cfg(pcfgfile, pcmd, pfile, plen, NULL, GET_ENABLED_ONLY)) {
-        return strchr(pfile, '=') + 1;
+    if(cfg_lock_depth && (cfg_lock_mode == QSAP_LOCK_READ)) {
+        cfg_lock_retry = TRUE;
+        return FALSE;
     }
 
-    return NULL;
+    return TRUE;
 }
 
-int qsap_hostd_exec(int argc, char ** argv)  {
+/** Mark a parsed image as used in the current pass, the readers may do it concurrently */
+static void qsap_cfg_touch(struct qsap_cfg *pcfg)
+{
+    __atomic_store_n(&pcfg->stamp, __atomic_add_fetch(&cfg_stamp, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_store_n(&pcfg->pass, cfg_pass, __ATOMIC_RELAXED);
+}
 
-#define MAX_CMD_SIZE 256
-    char qcCmdBuf[MAX_CMD_SIZE], *pCmdBuf;
-    u32 len = MAX_CMD_SIZE;
-    int i = 2, ret;
+/** Free an image which was never published, or which no reader can be using */
+static void qsap_cfg_free(struct qsap_cfg *pcfg)
+{
+    u32 i;
 
-    if ( argc < 4 ) {
-        ALOGD("failure: invalid arguments");
-        return -1;
-    }
+    if(NULL == pcfg)
+        return;
 
-    argc -= 2;
-    pCmdBuf = qcCmdBuf;
+    for(i=0; pcfg->lines && (i<pcfg->nlines); i++)
+        free(pcfg->lines[i].alloc);
 
-    while (argc--) {
-        ret = snprintf(pCmdBuf, len, " %s", argv[i]);
-        if ((ret < 0) || (ret >= (int)len)) {
-            /* Error case */
-            /* TODO: Command too long send the error message */
-            *pCmdBuf = '\0';
-             break;
-        }
-        ALOGD("argv[%d] (%s)",i, argv[i]);
-        pCmdBuf += ret;
-        len -= ret;
-        i++;
+    if(pcfg->map && (0 == __atomic_sub_fetch(&pcfg->map->ref, 1, __ATOMIC_ACQ_REL))) {
+        munmap(pcfg->map->data, pcfg->map->len);
+        free(pcfg->map);
     }
+    free(pcfg->lines);
+    free(pcfg);
+}
 
-    ALOGD("QCCMD data (%s)", pCmdBuf);
-    len = MAX_CMD_SIZE;
-    qsap_hostd_exec_cmd(qcCmdBuf, qcCmdBuf, (u32*)&len);
-    return 0;
+static void qsap_cfg_release(struct qsap_rcu_head *phead)
+{
+    qsap_cfg_free((struct qsap_cfg *)phead);
 }
-/** Function to identify a valid MAC address */
-static int isValid_MAC_address(char *pMac)
+
+/** Published image of a configuration file, NULL if the file is not parsed */
+static struct qsap_cfg *qsap_cfg_lookup(s8 *pfile)
 {
-    int i, len;
+    struct qsap_cfg *pcfg;
+    int i;
 
-    len = strlen(pMac);
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        pcfg = __atomic_load_n(&cfg_cache[i], __ATOMIC_ACQUIRE);
+        if(pcfg && !strcmp(pcfg->path, pfile))
+            return pcfg;
+    }
 
-    if(len < MAC_ADDR_LEN)
-        return FALSE;
+    return NULL;
+}
 
-    for(i=0; i<MAC_ADDR_LEN; i++) {
-        switch(i) {
-            case 2: case 5: case 8: case 11: case 14:
-                if(pMac[i] != ':')
-                    return FALSE;
+/**
+ * @brief
+ *        Publish an image, in place of the image of the same file, else in a
+ *        free slot, else in place of the least recently used image. The image
+ *        replaced is retired, the readers using it can go on.
+ * @param pcfg [IN] image, complete before it is published
+ * @return void
+*/
+static void qsap_cfg_publish(struct qsap_cfg *pcfg)
+{
+    struct qsap_cfg *pold, *p;
+    int i, slot;
+
+    do {
+        slot = -1;
+        pold = NULL;
+
+        for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+            p = __atomic_load_n(&cfg_cache[i], __ATOMIC_ACQUIRE);
+            if(p && !strcmp(p->path, pcfg->path)) {
+                slot = i;
+                pold = p;
                 break;
-            default:
-                if(isxdigit(pMac[i]) == 0)
-                    return FALSE;
+            }
+            if((slot >= 0) && (NULL == pold))
+                continue;
+            if((NULL == p) || (slot < 0) ||
+               (__atomic_load_n(&p->stamp, __ATOMIC_RELAXED) < __atomic_load_n(&pold->stamp, __ATOMIC_RELAXED))) {
+                slot = i;
+                pold = p;
+            }
         }
+
+        /** Another thread published in the slot meanwhile, choose again */
+        p = pold;
+    } while(!__atomic_compare_exchange_n(&cfg_cache[slot], &p, pcfg, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    if(NULL != pold)
+        qsap_rcu_retire(&pold->rcu);
+}
+
+/** Staged image of a configuration file, NULL if the thread is not updating it.
+  * The images staged by an open transaction belong to the thread which opened it */
+static struct qsap_cfg *qsap_cfg_staged(s8 *pfile)
+{
+    int i;
+
+    if(!cfg_lock_depth || (cfg_lock_mode != QSAP_LOCK_WRITE) || qsap_tx_busy())
+        return NULL;
+
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        if(cfg_staged[i] && !strcmp(cfg_staged[i]->path, pfile))
+            return cfg_staged[i];
     }
 
-    return TRUE;
+    return NULL;
+}
+
+/** Remove an image from the staged images, it is freed unless it is published */
+static void qsap_cfg_unstage(struct qsap_cfg *pcfg, int publish)
+{
+    int i;
+
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        if(cfg_staged[i] == pcfg)
+            cfg_staged[i] = NULL;
+    }
+
+    if(publish)
+        qsap_cfg_publish(pcfg);
+    else
+        qsap_cfg_free(pcfg);
 }
 
 /**
  * @brief
- *        Add a given MAC address to the allow or deny MAC list file.
- *        A maximum of 15 MAC addresses are allowed in the list. If the input
- *        MAC addresses are more than the allowed number, then the allowed number
- *        of MAC addresses are updated to the MAC list file and the remaining
- *        MAC addresses are discarded
- *
- * @param pfile [IN] Path of the allow or deny MAC list file
- * @param pVal [IN] A string containing one or more MAC addresses. Multiple
- *                  MAC addresses are separated by a SPACE separator
- *                  Ex. "11:22:33:44:55:66 77:88:99:00:88:00"
- * @param presp [OUT] buffer to store the response
- * @param plen [IN-OUT] The length of the buffer 'presp' is provided as input.
- *                      The length of the response, stored in buffer 'presp' is
- *                      provided as output.
+ *        Drop the parsed images of a configuration file. Called whenever the
+ *        SDK rewrites the file, so that a reused inode can not be mistaken
+ *        for the old file.
+ * @param pfile [IN] configuration file path
  * @return void
 */
-static void qsap_add_mac_to_file(s8 *pfile, s8 *pVal, s8 *presp, u32 *plen)
+static void qsap_cfg_invalidate(s8 *pfile)
 {
-    s32 len;
-    s16 num_macs = 0;
-    s8 buf[32];
-    s8 macbuf[32];
-    FILE *fp;
-
-    /** Create the file if it does not exists and open it for reading */
-    fp = fopen(pfile, "a");
-    if(NULL != fp) {
-        fclose(fp);
-        fp = fopen(pfile, "r+");
-    }
+    struct qsap_cfg *pcfg;
+    int i;
 
-    if(NULL == fp) {
-        ALOGE("%s : unable to open the file \n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+    if(NULL == pfile)
         return;
-    }
 
-    /** count the MAC address in the MAC list file */
-    while(NULL != (fgets(buf, 32, fp))) {
-        num_macs++;
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        pcfg = __atomic_load_n(&cfg_cache[i], __ATOMIC_ACQUIRE);
+        if(pcfg && !strcmp(pcfg->path, pfile) &&
+           __atomic_compare_exchange_n(&cfg_cache[i], &pcfg, NULL, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            qsap_rcu_retire(&pcfg->rcu);
     }
 
-    /** Evaluate the allowed limit */
-    if(num_macs >= MAX_ALLOWED_MAC) {
-        ALOGE("%s : File is full\n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
-        fclose(fp);
-        return;
-    }
+    if(NULL != (pcfg = qsap_cfg_staged(pfile)))
+        qsap_cfg_unstage(pcfg, FALSE);
+}
 
-    /** Update all the input MAC addresses into the MAC list file */
-    len = strlen(pVal);
-    while(len > 0) {
-        int i = 0;
+/** Identify the comment, key and value of a line */
+static void qsap_cfg_split_line(struct qsap_cfg_line *pline)
+{
+    s8 *key;
+    s8 *lend = pline->text + pline->len;
+    s8 *eq;
 
-        /** Get a MAC address from the input string */
-        while((*pVal != ' ' ) && (*pVal != '\0')) {
-            macbuf[i] = *pVal;
-            i++;
-            pVal++;
+    pline->commented = FALSE;
+    pline->key = pline->val = NULL;
+    pline->klen = pline->vlen = 0;
 
-            if(i == MAC_ADDR_LEN)
-                break;
-        }
-        macbuf[i] = '\0';
-        pVal++;
+    if(pline->len && (*pline->text == '#')) {
+        pline->commented = TRUE;
+        pline->text++;
+        pline->len--;
+    }
+    key = pline->text;
 
-        /** Is valid MAC address input ? */
-        if(TRUE == isValid_MAC_address(macbuf)) {
+    if(NULL == (eq = memchr(key, '=', lend - key)))
+        return;
 
-            /** Append the MAC address to the file */
-            fprintf(fp, "%s\n", macbuf);
-            num_macs++;
+    /** Delete all \r \n combinations at the end of the value */
+    while((lend > eq + 1) && (lend[-1] == '\r'))
+        lend--;
 
-            /** Evaluate with the allowed limit */
-            if(num_macs == MAX_ALLOWED_MAC) {
-                ALOGE("MAC file is full now.... \n");
-                break;
-            }
+    pline->key = key;
+    pline->klen = eq - key;
+    pline->val = eq + 1;
+    pline->vlen = lend - (eq + 1);
+}
 
-        }
-        len -= strlen(macbuf);
-        if(*pVal != '\0')
-            len--;
-    }
+static int qsap_cfg_is_end_line(struct qsap_cfg_line *pline)
+{
+    return (pline->len >= 3) && !strncmp(pline->text, "END", 3);
+}
 
-    fclose(fp);
+static void qsap_cfg_index_line(s32 (*pidx)[2], struct Command *ptable, int num, struct qsap_cfg_line *pline, s32 line)
+{
+    int i;
 
-    *plen = qsap_scnprintf(presp, *plen, "%s", SUCCESS);
+    for(i=0; i<num; i++) {
+        if((pline->klen != strlen(ptable[i].name)) || memcmp(pline->key, ptable[i].name, pline->klen))
+            continue;
 
-    return;
+        if(pidx[i][GET_COMMENTED_VALUE] < 0)
+            pidx[i][GET_COMMENTED_VALUE] = line;
+
+        if(!pline->commented && (pidx[i][GET_ENABLED_ONLY] < 0))
+            pidx[i][GET_ENABLED_ONLY] = line;
+    }
 }
 
 /**
  * @brief
- *         Remove one or more MAC addresses from the allow or deny MAC list file.
- * @param pfile [IN] path of the allow or deny list file.
- * @param pVal [IN] a list of MAC addresses to be removed from the MAC list file.
- * @param presp [OUT] the buffer to store the response
- * @param plen [IN-OUT] The length of the 'presp' buffer is provided as input.
- *                      The lenght of the response, stored in 'presp', is
- *                      provided as output
- * @return void
+ *        Update the index of the parameters named 'key', after the lines
+ *        having that key were changed.
 */
-static void qsap_remove_from_file(s8 *pfile, s8 *pVal, s8 *presp, u32 *plen)
+static void qsap_cfg_reindex(struct qsap_cfg *pcfg, s8 *key, u32 klen)
 {
-    FILE *fp;
-    FILE *ftmp;
-    s8 buf[MAX_CONF_LINE_LEN];
-    int status;
+    u32 i;
 
-    /** Open the allow or deny MAC list file */
-    fp = fopen(pfile, "r+");
+    for(i=0; i<eCMD_LAST; i++) {
+        if((klen == strlen(cmd_list[i].name)) && !memcmp(key, cmd_list[i].name, klen))
+            pcfg->cmd_line[i][0] = pcfg->cmd_line[i][1] = -1;
+    }
 
-    if(NULL == fp) {
-        ALOGE("%s : unable to open the file \n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-        return;
+    for(i=0; i<eSTR_LAST; i++) {
+        if((klen == strlen(qsap_str[i].name)) && !memcmp(key, qsap_str[i].name, klen))
+            pcfg->str_line[i][0] = pcfg->str_line[i][1] = -1;
     }
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pfile);
+    for(i=0; i<pcfg->nlines; i++) {
+        struct qsap_cfg_line *pline = &pcfg->lines[i];
 
-    /** Open a temporary file */
-    ftmp = fopen(buf, "w");
+        if((pline->klen != klen) || memcmp(pline->key, key, klen))
+            continue;
 
-    if(ftmp == NULL) {
-        ALOGE("%s : unable to open the file \n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-        fclose(fp);
-        return;
+        qsap_cfg_index_line(pcfg->cmd_line, cmd_list, eCMD_LAST, pline, i);
+        qsap_cfg_index_line(pcfg->str_line, qsap_str, eSTR_LAST, pline, i);
     }
+}
 
-    /** Read all the MAC addresses from the file */
-    while(NULL != fgets(buf, MAX_CONF_LINE_LEN, fp)) {
-        s8 *plist;
-        s32 slen;
-        int write_back = 1;
+/**
+ * @brief
+ *        Split the file image into lines and index the known parameters.
+ * @param pcfg [IN-OUT] configuration image, with 'data' filled in
+ * @param len [IN] length of the file image
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_cfg_parse(struct qsap_cfg *pcfg, u32 len)
+{
+    s8  *p = pcfg->data;
+    s8  *end = pcfg->data + len;
+    u32  n = 0;
 
-        plist = pVal;
-        slen = strlen(pVal);
+    while(p < end) {
+        s8 *eol = memchr(p, '\n', end - p);
+        n++;
+        p = eol ? eol + 1 : end;
+    }
 
-        /** Compare each MAC address in the file with all the
-          * input MAC addresses */
-        write_back = 1;
-        while(slen > 0) {
+    pcfg->lines = calloc(n ? n : 1, sizeof(struct qsap_cfg_line));
+    if(NULL == pcfg->lines)
+        return eERR_UNKNOWN;
 
-            if(0 == strncmp(buf, plist, MAC_ADDR_LEN)) {
-                write_back = 0;
-                break;
-            }
+    memset(pcfg->cmd_line, 0xff, sizeof(pcfg->cmd_line));
+    memset(pcfg->str_line, 0xff, sizeof(pcfg->str_line));
+    pcfg->end_line = -1;
+    pcfg->noeol = (len > 0) && (end[-1] != '\n');
 
-            while((*plist != ' ') && (*plist != '\0')) {
-                plist++;
-                slen--;
-            }
+    for(p = pcfg->data, n = 0; p < end; n++) {
+        struct qsap_cfg_line *pline = &pcfg->lines[n];
+        s8 *eol = memchr(p, '\n', end - p);
 
-            while(((*plist == ' ') || (*plist == '\t')) && (*plist != '\0')) {
-                plist++; slen--;
-            }
-        }
+        pline->text = p;
+        pline->len = (eol ? eol : end) - p;
+        p = eol ? eol + 1 : end;
 
-        /** Update the file */
-        if(write_back) {
-            fprintf(ftmp, "%s", buf);
-        }
-    }
+        qsap_cfg_split_line(pline);
 
-    fclose(fp);
-    fclose(ftmp);
+        if((pcfg->end_line < 0) && qsap_cfg_is_end_line(pline))
+            pcfg->end_line = n;
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pfile);
+        if(pline->klen == 0)
+            continue;
 
-    /** Restore the configuration file */
-    status = rename(buf, pfile);
+        qsap_cfg_index_line(pcfg->cmd_line, cmd_list, eCMD_LAST, pline, n);
+        qsap_cfg_index_line(pcfg->str_line, qsap_str, eSTR_LAST, pline, n);
+    }
+    pcfg->nlines = n;
 
-    qsap_scnprintf(presp, *plen, "%s", (status == eERR_UNKNOWN) ? ERR_FEATURE_NOT_ENABLED : SUCCESS);
+    return eSUCCESS;
+}
 
-    unlink(buf);
+/** Write a line of the parsed configuration, followed by the new line
+  * character if 'eol' is set */
+static void qsap_cfg_put_line(FILE *fp, struct qsap_cfg_line *pline, u8 eol)
+{
+    if(pline->commented)
+        fputc('#', fp);
 
-    return;
+    fwrite(pline->text, 1, pline->len, fp);
+
+    if(eol)
+        fputc('\n', fp);
 }
 
+/** New content of a file, written to an anonymous temporary file in the same
+  * directory and published atomically over the old file. Readers see either
+  * the old or the new file, and a writer which dies leaves nothing behind.
+  */
+struct qsap_file_update {
+    FILE *fp;
+    /** Name of the temporary file, empty while the file is anonymous */
+    s8    tmp[MAX_FILE_PATH_LEN + 32];
+};
+
 /**
  * @brief
- *         Identify the MAC list file and the type of updation on the file.
- *         The MAC list file can be : Allow file or Deny file.
- *         The type of operation is : Add to file or Delete from file
- *
- * @param file [IN] path of the allow or deny MAC list file.
- * @param cNum [IN] command number to 'type of file' and the 'type of updation'
- *                  to be done.
- * @param pVal [IN] A list of one or more MAC addresses. Multiple MAC addresses
- *                  are separated by a SPACE character
- * @param presp [OUT] Buffer to store the command response
- * @param plen [IN-OUT] The length of the 'presp' buffer is provided as input
- *                      The length of the response, stored in the 'presp' is provided
- *                      as the output
- * @return void
+ *        Create the temporary file for the new content of a file. The file is
+ *        given the mode 0660 before it is published.
+ * @param pupd [OUT] update context
+ * @param pfile [IN] path of the file to be replaced
+ * @return On success, the stream to write the new content
+ *         On failure, NULL
 */
-static void qsap_update_mac_list(s8 *pfile, esap_cmd_t cNum, s8 *pVal, s8 *presp, u32 *plen)
+static FILE *qsap_file_update_open(struct qsap_file_update *pupd, const s8 *pfile)
 {
-    ALOGD("%s : Updating file %s \n", __func__, pfile);
+    s8 dir[MAX_FILE_PATH_LEN];
+    const s8 *pslash = strrchr(pfile, '/');
+    int fd = -1;
 
-    switch(cNum) {
-        case eCMD_ADD_TO_ALLOW:
-        case eCMD_ADD_TO_DENY:
-                qsap_add_mac_to_file(pfile, pVal, presp, plen);
-                break;
+    memset(pupd, 0, sizeof(*pupd));
 
-        case eCMD_REMOVE_FROM_ALLOW:
-        case eCMD_REMOVE_FROM_DENY:
-                qsap_remove_from_file(pfile, pVal, presp, plen);
-                break;
+    if(NULL == pslash)
+        strlcpy(dir, ".", sizeof(dir));
+    else if(pslash == pfile)
+        strlcpy(dir, "/", sizeof(dir));
+    else
+        qsap_scnprintf(dir, sizeof(dir), "%.*s", (int)(pslash - pfile), pfile);
 
-        default:
-                *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
-                return;
+#ifdef O_TMPFILE
+    fd = TEMP_FAILURE_RETRY(open(dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0660));
+#endif
+    if(fd < 0) {
+        /** The file system does not support O_TMPFILE, use a named file */
+        qsap_scnprintf(pupd->tmp, sizeof(pupd->tmp), "%s.XXXXXX", pfile);
+        fd = mkostemp(pupd->tmp, O_CLOEXEC);
+        if(fd < 0) {
+            ALOGE("%s : unable to create a temporary file for %s: %s\n", __func__, pfile, strerror(errno));
+            return NULL;
+        }
     }
 
-    return;
+    if(fchmod(fd, 0660) < 0) {
+        ALOGE("Error changing permissions of %s to 0660: %s", pfile, strerror(errno));
+    }
+
+    pupd->fp = fdopen(fd, "w");
+    if(NULL == pupd->fp) {
+        close(fd);
+        if(pupd->tmp[0])
+            unlink(pupd->tmp);
+        return NULL;
+    }
+
+    return pupd->fp;
+}
+
+/** Drop the new content of the file, the old file is kept */
+static void qsap_file_update_abort(struct qsap_file_update *pupd)
+{
+    if(pupd->fp)
+        fclose(pupd->fp);
+    if(pupd->tmp[0])
+        unlink(pupd->tmp);
+    pupd->fp = NULL;
+    pupd->tmp[0] = '\0';
 }
 
 /**
  * @brief
- * @param fconfig [INPUT] configuration file name
- * @param cNum [INPUT] command number. The valid command numbers supported by
- *                     this function are :
- *                     eCMD_ALLOW_LIST - Get the MAC address list from the allow list
- *                     eCMD_DENY_LIST - Get the MAC address list from the deny list
- * @param presp [OUTPUT] presp The command output format :
- *                    On success,
- *                            success <cmd>=<value>
- *                    On failure,
- *                            failure <error message>
- * @param plen [IN-OUT] plen
- *                      [IN] The length of the buffer, presp
- *                      [OUT] The length of the response in the buffer, presp
- * @return void
-**/
-static void qsap_get_mac_list(s8 *fconfile, esap_cmd_t cNum, s8 *presp, u32 *plen)
+ *        Replace the file with the new content written to the update stream.
+ *        The stream is closed in all the cases.
+ * @param pupd [IN-OUT] update context
+ * @param pfile [IN] path of the file to be replaced
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_file_update_commit(struct qsap_file_update *pupd, const s8 *pfile)
 {
-    s8 buf[MAX_CONF_LINE_LEN];
-    FILE *fp;
-    u32 len_remain;
-    s8 *pfile, *pOut;
-    esap_str_t sNum;
-    int cnt = 0;
+    static u32 seq;
+    s8 proc[32];
+    int fd = fileno(pupd->fp);
 
-    /** Identify the allow or deny file */
-    if(eCMD_ALLOW_LIST == cNum) {
-        sNum = STR_ACCEPT_MAC_FILE;
-    }
-    else if(eCMD_DENY_LIST == cNum) {
-        sNum = STR_DENY_MAC_FILE;
-    }
-    else {
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
-        return;
+    if(fflush(pupd->fp) || ferror(pupd->fp)) {
+        ALOGE("%s : unable to write %s \n", __func__, pfile);
+        goto error;
     }
 
-    /** Get the MAC allow or MAC deny file path */
-    len_remain = MAX_CONF_LINE_LEN;
-    if(NULL == (pfile = qsap_get_allow_deny_file_name(fconfile, &qsap_str[sNum], buf, &len_remain))) {
-        ALOGE("%s:Unknown error\n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-        return;
+    /** Give the anonymous file a unique name, which is then moved over the old file */
+    while(!pupd->tmp[0]) {
+        qsap_scnprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+        qsap_scnprintf(pupd->tmp, sizeof(pupd->tmp), "%s.%d.%u~", pfile, getpid(),
+                       __sync_fetch_and_add(&seq, 1));
+
+        if(0 == linkat(AT_FDCWD, proc, AT_FDCWD, pupd->tmp, AT_SYMLINK_FOLLOW))
+            break;
+
+        pupd->tmp[0] = '\0';
+        if(errno != EEXIST) {
+            ALOGE("%s : unable to link %s: %s\n", __func__, pfile, strerror(errno));
+            goto error;
+        }
     }
 
-    /** Open allow / deny file, and read the MAC addresses */
-    fp = fopen(pfile, "r");
-    if(NULL == fp) {
-        ALOGE("%s: file open error\n",__func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-        return;
+    if(rename(pupd->tmp, pfile) < 0) {
+        ALOGE("unable to rename the file %s: %s\n", pfile, strerror(errno));
+        goto error;
     }
 
-    *plen -= qsap_scnprintf(presp, *plen, "%s %s=", SUCCESS, cmd_list[cNum].name);
+    fclose(pupd->fp);
+    pupd->fp = NULL;
+    pupd->tmp[0] = '\0';
 
-    pOut = presp + strlen(presp);
+    return eSUCCESS;
 
-    /** Read the MAC address from the MAC allow or deny file */
-    while(NULL != (fgets(buf, MAX_CONF_LINE_LEN, fp))) {
-        u32 len;
+error:
+    qsap_file_update_abort(pupd);
+    return eERR_UNKNOWN;
+}
 
-        /** Avoid the commented lines */
-        if(buf[0] == '#')
-            continue;
+/**
+ * @brief
+ *        Start a request pass. Until the end of the pass, each configuration
+ *        file is checked for changes only once.
+*/
+static void qsap_cfg_pass_begin(void)
+{
+    /** 0 means 'no pass' */
+    do {
+        cfg_pass = __atomic_add_fetch(&cfg_pass_seq, 1, __ATOMIC_RELAXED);
+    } while(0 == cfg_pass);
+}
 
-        if(FALSE == isValid_MAC_address(buf))
-            continue;
+/**
+ * @brief
+ *        End the request pass.
+*/
+static void qsap_cfg_pass_end(void)
+{
+    cfg_pass = 0;
+}
 
-        buf[strlen(buf)-1] = '\0';
+/**
+ * @brief
+ *        Read and parse a configuration file into a new image.
+ * @param pfile [IN] configuration file path
+ * @return On success, the image, not published yet
+ *         On failure, NULL
+*/
+static struct qsap_cfg *qsap_cfg_load(s8 *pfile)
+{
+    struct qsap_cfg *pcfg;
+    struct stat st;
+    void *pmap;
+    int fd;
 
-        if(*plen < strlen(buf)) {
-            *pOut = '\0';
-            break;
-        }
+    fd = open(pfile, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return NULL;
 
-        len = qsap_scnprintf(pOut, *plen, "%s ", buf);
-        cnt++;
+    pcfg = calloc(1, sizeof(*pcfg));
+    if(NULL == pcfg) {
+        close(fd);
+        return NULL;
+    }
+    pcfg->rcu.release = qsap_cfg_release;
 
-        if (cnt >= MAX_ALLOWED_MAC) {
-            break;
-        }
+    if(fstat(fd, &st) < 0)
+        goto error;
 
-        pOut += len;
-        *plen -= len;
+    if(st.st_size > 0) {
+        pcfg->map = calloc(1, sizeof(*pcfg->map));
+        if(NULL == pcfg->map)
+            goto error;
+
+        pmap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(MAP_FAILED == pmap) {
+            free(pcfg->map);
+            pcfg->map = NULL;
+            goto error;
+        }
+        pcfg->map->data = pcfg->data = pmap;
+        pcfg->map->len = st.st_size;
+        pcfg->map->ref = 1;
     }
+    else {
+        pcfg->data = cfg_empty;
+    }
+    close(fd);
+    fd = -1;
 
-    *plen = strlen(presp);
+    if(eSUCCESS != qsap_cfg_parse(pcfg, st.st_size))
+        goto error;
 
-    fclose(fp);
+    strlcpy(pcfg->path, pfile, sizeof(pcfg->path));
+    pcfg->dev = st.st_dev;
+    pcfg->ino = st.st_ino;
+    pcfg->size = st.st_size;
+    pcfg->mtime = st.st_mtim;
 
-    return;
+    return pcfg;
+
+error:
+    ALOGE("%s : unable to read %s \n", __func__, pfile);
+    if(fd >= 0)
+        close(fd);
+    qsap_cfg_free(pcfg);
+    return NULL;
 }
 
-static int qsap_read_mac_address(s8 *presp, u32 *plen)
+/**
+ * @brief
+ *        Get the parsed image of a configuration file. The file is read and
+ *        parsed only if it was not seen before, or if it changed since it was
+ *        parsed last. A reader may parse the file as well as an update: the
+ *        new image replaces the old one, which stays valid for the readers
+ *        using it.
+ * @param pfile [IN] configuration file path
+ * @return On success, pointer to the parsed configuration. The staged image
+ *         for the thread updating the file.
+ *         On failure, NULL
+*/
+static struct qsap_cfg *qsap_cfg_get(s8 *pfile)
 {
-    char *ptr;
-    char  mac[MAC_ADDR_LEN];
-    u32   len, i;
-    int   nRet = eERR_INVALID_MAC_ADDR;
+    struct qsap_cfg *pcfg;
+    struct stat st;
 
-    len = *plen;
+    if((NULL == pfile) || (strlen(pfile) >= MAX_FILE_PATH_LEN))
+        return NULL;
 
-    if(eSUCCESS != qsap_read_cfg(fIni, &qsap_str[STR_MAC_IN_INI], presp, plen, cmd_list[eCMD_MAC_ADDR].name, GET_ENABLED_ONLY)) {
-        ALOGE("%s :MAC addr read failure \n",__func__);
-        goto end;
+    /** The staged changes are not in the file yet */
+    pcfg = qsap_cfg_staged(pfile);
+    if(NULL != pcfg) {
+        qsap_cfg_touch(pcfg);
+        return pcfg;
     }
 
-    ptr = strchr(presp, '=');
-    if(NULL == ptr)
-        goto end;
+    /** Look for the file among the parsed ones */
+    pcfg = qsap_cfg_lookup(pfile);
 
-    strlcpy(mac, ptr+1, MAC_ADDR_LEN);
-    *plen = qsap_scnprintf(presp, len, "%s %s=", SUCCESS, cmd_list[eCMD_MAC_ADDR].name);
-    ptr = presp + strlen(presp);
-    len -= strlen(presp); /* decrease the total available buf length */
+    /** Already checked in this request pass */
+    if(pcfg && cfg_pass && (__atomic_load_n(&pcfg->pass, __ATOMIC_RELAXED) == cfg_pass)) {
+        qsap_cfg_touch(pcfg);
+        return pcfg;
+    }
 
-    for(i=0; i<MAC_ADDR_LEN-5; i+=2) {
-        u32 tlen;
+    if(stat(pfile, &st) < 0)
+        return NULL;
 
-        tlen = qsap_scnprintf(ptr, len, "%c%c:", mac[i], mac[i+1]);
-        *plen += tlen;
-        ptr += tlen;
-        len -= tlen; /* decrease the available len of ptr */
+    if(NULL != pcfg) {
+        if((pcfg->dev == st.st_dev) && (pcfg->ino == st.st_ino) &&
+           (pcfg->size == st.st_size) &&
+           (pcfg->mtime.tv_sec == st.st_mtim.tv_sec) &&
+           (pcfg->mtime.tv_nsec == st.st_mtim.tv_nsec)) {
+            qsap_cfg_touch(pcfg);
+            return pcfg;
+        }
+        /** The file changed, parse it again */
     }
-    presp[*plen-1] = '\0';
-    (*plen)--;
 
-    ptr = strchr(presp, '=');
-    if(NULL == ptr)
-        goto end;
+    pcfg = qsap_cfg_load(pfile);
+    if(NULL == pcfg)
+        return NULL;
 
-    ptr++;
+    qsap_cfg_touch(pcfg);
+    qsap_cfg_publish(pcfg);
 
-    ALOGD("MAC :%s \n", ptr);
-    if(TRUE == isValid_MAC_address(ptr)) {
-        nRet = eSUCCESS;
-    }
-    else {
-        ALOGE("Invalid MAC in conf file \n");
-    }
-end:
-    return nRet;
+    return pcfg;
 }
 
-s8 *qsap_get_config_value(s8 *pfile, struct Command  *pcmd, s8 *pbuf, u32 *plen)
+/**
+ * @brief
+ *        Get the image of a configuration file to be updated. On the first
+ *        update, the published image is copied into the staged images. The
+ *        copy shares the mapped file, only the lines and the lines updated in
+ *        memory are copied.
+ * @param pfile [IN] configuration file path
+ * @return On success, pointer to the staged image
+ *         On failure, NULL
+*/
+static struct qsap_cfg *qsap_cfg_get_update(s8 *pfile)
 {
-    s8 *ptr = NULL;
-
-    if(eSUCCESS == qsap_read_cfg(pfile, pcmd, pbuf, (u32 *)plen, NULL, GET_ENABLED_ONLY)) {
-        ptr = strchr(pbuf, '=');
-        if(NULL != ptr){
-            ptr++;
-        }
-        else {
-            ALOGE("Invalid entry, %s\n", pcmd->name);
-        }
-    }
+    struct qsap_cfg *pcfg, *pcopy;
+    u32 i, size;
+    int slot;
 
-    return ptr;
-}
+    if(NULL == (pcfg = qsap_cfg_get(pfile)))
+        return NULL;
 
-static void qsap_read_wps_state(s8 *presp, u32 *plen)
-{
-    u32  tlen = *plen;
-    s32  status;
-    s8 *pstate;
+    if(pcfg == qsap_cfg_staged(pfile))
+        return pcfg;
 
-    if(NULL == (pstate = qsap_get_config_value(pconffile, &cmd_list[eCMD_WPS_STATE], presp, &tlen))) {
-        /** unable to read the wps configuration, WPS is disabled !*/
-        ALOGD("%s :wps_state not in cfg file \n", __func__);
-        status = DISABLE;
-    }
-    else {
-        status = (atoi(pstate) == WPS_STATE_ENABLE) ? ENABLE : DISABLE;
+    if(qsap_tx_busy()) {
+        ALOGE("%s : %s is updated by a transaction \n", __func__, pfile);
+        return NULL;
     }
 
-    *plen = qsap_scnprintf(presp, *plen, "success %s=%d", cmd_list[eCMD_WPS_STATE].name, status);
+    for(slot=0; (slot<QSAP_CFG_CACHE_MAX) && cfg_staged[slot]; slot++)
+        ;
+    if(slot == QSAP_CFG_CACHE_MAX) {
+        ALOGE("%s : no room to update %s \n", __func__, pfile);
+        return NULL;
+    }
 
-    return;
-}
+    pcopy = malloc(sizeof(*pcopy));
+    if(NULL == pcopy)
+        return NULL;
 
-/**
- *    Get the channel being used in the soft AP.
- */
-int qsap_get_operating_channel(s32 *pchan)
-{
-    int sock;
-    struct iwreq wrq;
-    s8 interface[MAX_CONF_LINE_LEN];
-    u32 len = MAX_CONF_LINE_LEN;
-    s8 *pif;
-    int ret;
+    memcpy(pcopy, pcfg, sizeof(*pcopy));
+    pcopy->rcu.next = NULL;
+    pcopy->dirty = FALSE;
+    pcopy->lines = NULL;
+    if(pcopy->map)
+        __atomic_add_fetch(&pcopy->map->ref, 1, __ATOMIC_RELAXED);
 
-    if(ENABLE != is_softap_enabled()) {
+    pcopy->lines = malloc((pcfg->nlines ? pcfg->nlines : 1) * sizeof(struct qsap_cfg_line));
+    if(NULL == pcopy->lines)
         goto error;
-    }
 
-    if(NULL == (pif = qsap_get_config_value(pconffile, &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGE("%s :interface error \n", __func__);
-        goto error;
-    }
+    memcpy(pcopy->lines, pcfg->lines, pcfg->nlines * sizeof(struct qsap_cfg_line));
+    for(i=0; i<pcopy->nlines; i++)
+        pcopy->lines[i].alloc = NULL;
 
-    interface[len] = '\0';
-
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if(sock < 0) {
-        ALOGE("%s :socket error \n", __func__);
-        goto error;
-    }
+    for(i=0; i<pcopy->nlines; i++) {
+        struct qsap_cfg_line *pline = &pcopy->lines[i];
+        s8 *pold = pcfg->lines[i].alloc;
 
-    *pchan = 0;
+        if(NULL == pold)
+            continue;
 
-    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
-    wrq.u.data.length = sizeof(s32);
-    wrq.u.data.pointer = pchan;
-    wrq.u.data.flags = 0;
+        /** The text of a commented line starts after the '#' of the buffer */
+        size = (pline->text - pold) + pline->len + 1;
+        pline->alloc = malloc(size);
+        if(NULL == pline->alloc)
+            goto error;
 
-    ret = ioctl(sock, QCSAP_IOCTL_GET_CHANNEL, &wrq);
-    if(ret < 0) {
-        ALOGE("%s: ioctl failure \n",__func__);
-        close(sock);
-        goto error;
+        memcpy(pline->alloc, pold, size);
+        pline->text = pline->alloc + (pline->text - pold);
+        if(pline->key) {
+            pline->key = pline->alloc + (pline->key - pold);
+            pline->val = pline->alloc + (pline->val - pold);
+        }
     }
 
-    ALOGE("Recv len :%d \n", wrq.u.data.length);
-    *pchan = *(int *)(&wrq.u.name[0]);
-    ALOGE("Operating channel :%d \n", *pchan);
-    close(sock);
-    return eSUCCESS;
+    cfg_staged[slot] = pcopy;
+
+    return pcopy;
 
 error:
-    *pchan = 0;
-    ALOGE("%s: Failed to read channel \n", __func__);
-    return eERR_CHAN_READ;
+    ALOGE("%s : unable to update %s \n", __func__, pfile);
+    qsap_cfg_free(pcopy);
+    return NULL;
 }
 
 /**
- *    Get the sap auto channel selection for soft AP.
- */
-int qsap_get_sap_auto_channel_selection(s32 *pautochan)
+ * @brief
+ *        Find the line of a configuration parameter in the parsed configuration.
+ * @param pcfg [IN] parsed configuration
+ * @param pcmd [IN] pointer to the comand structure
+ * @param ignore_comment [IN] if set, the commented line is also considered
+ * @return On success, pointer to the line
+ *         On failure, NULL
+*/
+static struct qsap_cfg_line *qsap_cfg_find(struct qsap_cfg *pcfg, struct Command *pcmd, s32 ignore_comment)
 {
-    int sock;
-    struct iwreq wrq;
-    s8 interface[MAX_CONF_LINE_LEN];
-    u32 len = MAX_CONF_LINE_LEN;
-    s8 *pif;
-    int ret;
-    sap_auto_channel_info sap_autochan_info;
+    s32 line = -1;
+    u32 i, len;
 
-    if(ENABLE != is_softap_enabled()) {
-        ALOGE("%s :is_softap_enabled() goto error \n", __func__);
-        goto error;
-    }
+    ignore_comment = ignore_comment ? GET_COMMENTED_VALUE : GET_ENABLED_ONLY;
 
-    if(NULL == (pif = qsap_get_config_value(pconffile,
-                                 &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGD("%s :interface error \n", __func__);
-        goto error;
+    if((pcmd >= cmd_list) && (pcmd < &cmd_list[eCMD_LAST])) {
+        line = pcfg->cmd_line[pcmd - cmd_list][ignore_comment];
     }
+    else if((pcmd >= qsap_str) && (pcmd < &qsap_str[eSTR_LAST])) {
+        line = pcfg->str_line[pcmd - qsap_str][ignore_comment];
+    }
+    else {
+        len = strlen(pcmd->name);
+        for(i=0; i<pcfg->nlines; i++) {
+            struct qsap_cfg_line *pline = &pcfg->lines[i];
 
-    interface[len] = '\0';
+            if(pline->commented && !ignore_comment)
+                continue;
 
-     sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if(sock < 0) {
-        ALOGD("%s :socket error \n", __func__);
-        goto error;
+            if((pline->klen == len) && !memcmp(pline->key, pcmd->name, len)) {
+                line = i;
+                break;
+            }
+        }
     }
 
-    *pautochan = 0;
+    return (line < 0) ? NULL : &pcfg->lines[line];
+}
 
-    memset(&sap_autochan_info, 0, sizeof(sap_autochan_info));
-    memset(&wrq, 0, sizeof(wrq));
+#ifdef QSAP_CONFIG_SNAPSHOT
+/** Compiled snapshot of a hostapd configuration file, stored next to it as
+  * "<file>.cache". It is generated whenever the SDK writes the file, and holds
+  * the value of every parameter of cmd_list[] and qsap_str[], so that a process
+  * reading a few parameters does not have to parse the file.
+  * The snapshot is used only while the text file has the same device, inode,
+  * size and nanosecond mtime as when the snapshot was built. The SDK replaces
+  * the file by renaming a new one over it, so each of its updates changes the
+  * inode, and another writer changes the mtime.
+  *
+  * Layout : struct qsap_snap_hdr
+  *          struct qsap_snap_ent [ncmd + nstr][2], indexed by the command
+  *                               number and [GET_ENABLED_ONLY]/[GET_COMMENTED_VALUE]
+  *          values
+  */
+#define QSAP_SNAP_SUFFIX    ".cache"
+#define QSAP_SNAP_MAGIC     (0x43505351) /** "QSPC" */
+#define QSAP_SNAP_VERSION   (2)
+#define QSAP_SNAP_ABSENT    (0xffffffff)
+
+struct qsap_snap_hdr {
+    u32 magic;
+    u32 version;
+    u32 ncmd;
+    u32 nstr;
+    u32 layout;
+    u32 vlen;
+    unsigned long long dev;
+    unsigned long long ino;
+    long long size;
+    long long mtime_sec;
+    long long mtime_nsec;
+};
 
-    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
-    wrq.u.data.length = sizeof(s32);
-    sap_autochan_info.subioctl = QCSAP_PARAM_GET_AUTO_CHANNEL;
-    wrq.u.data.pointer = pautochan;
-    memcpy(wrq.u.name, (char *)(&sap_autochan_info), sizeof(sap_autochan_info));
-    wrq.u.data.flags = 0;
+struct qsap_snap_ent {
+    u32 off;
+    u32 len;
+};
 
-    ret = ioctl(sock, QCSAP_IOCTL_GETPARAM, &wrq);
-    if(ret < 0) {
-        ALOGE("%s: ioctl failure \n",__func__);
-        close(sock);
-        goto error;
-    }
+/** A snapshot mapped in memory, valid for the text file identity it holds.
+  * Like a parsed image, a published snapshot is never modified, and is
+  * retired when it is replaced or found stale */
+struct qsap_snap {
+    /** Must be the first member, see qsap_snap_release() */
+    struct qsap_rcu_head rcu;
+    s8     path[MAX_FILE_PATH_LEN];
+    u8    *data;
+    size_t len;
+    /** Request pass in which the snapshot was checked last */
+    u32    pass;
+};
 
-    ALOGD("Recv len :%d \n", wrq.u.data.length);
-    *pautochan = *(int *)(&wrq.u.name[0]);
-    ALOGD("Sap auto channel selection pautochan=%d \n", *pautochan);
-    close(sock);
-    return eSUCCESS;
+/** Published snapshots, replaced atomically */
+static struct qsap_snap *snap_cache[QSAP_CFG_CACHE_MAX];
 
-error:
-    *pautochan = 0;
-    ALOGE("%s: Failed to read sap auto channel selection\n", __func__);
-    return eERR_GET_AUTO_CHAN;
+/** FNV-1a hash */
+static u32 qsap_snap_hash(u32 hash, const s8 *p, u32 len)
+{
+    while(len--) {
+        hash ^= (u8)*p++;
+        hash *= 16777619;
+    }
+    return hash;
 }
 
-
-static int iftypeCallback(struct nl_msg* msg, void* arg)
+/** Hash of the parameter names, a snapshot built with other tables is not used */
+static u32 qsap_snap_layout(void)
 {
-    struct nlmsghdr* ret_hdr = nlmsg_hdr(msg);
-    struct nlattr *tb_msg[NL80211_ATTR_MAX + 1];
-    int* type = arg;
+    u32 hash = 2166136261u;
+    int i;
 
-    struct genlmsghdr *gnlh = (struct genlmsghdr*) nlmsg_data(ret_hdr);
+    for(i=0; i<eCMD_LAST; i++)
+        hash = qsap_snap_hash(hash, cmd_list[i].name, strlen(cmd_list[i].name) + 1);
+    for(i=0; i<eSTR_LAST; i++)
+        hash = qsap_snap_hash(hash, qsap_str[i].name, strlen(qsap_str[i].name) + 1);
 
-    nla_parse(tb_msg, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
-              genlmsg_attrlen(gnlh, 0), NULL);
+    return hash;
+}
 
-    if (tb_msg[NL80211_ATTR_IFTYPE]) {
-        *type = nla_get_u32(tb_msg[NL80211_ATTR_IFTYPE]);
+static void qsap_snap_free(struct qsap_snap *psnap)
+{
+    munmap(psnap->data, psnap->len);
+    free(psnap);
+}
+
+static void qsap_snap_release(struct qsap_rcu_head *phead)
+{
+    qsap_snap_free((struct qsap_snap *)phead);
+}
+
+/** Retire the published snapshot of a file */
+static void qsap_snap_drop(struct qsap_snap *psnap)
+{
+    struct qsap_snap *p;
+    int i;
 
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        p = psnap;
+        if(__atomic_compare_exchange_n(&snap_cache[i], &p, NULL, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            qsap_rcu_retire(&psnap->rcu);
+            return;
+        }
     }
-    return NL_SKIP;
 }
 
-/**
- *    Get the mode of operation.
- */
-int qsap_get_mode(s32 *pmode)
+/** Published snapshot of a file, NULL if the snapshot is not mapped */
+static struct qsap_snap *qsap_snap_lookup(const s8 *pfile)
 {
-    int ret = eERR_UNKNOWN;
-    struct nl_sock* sk = NULL;
-    int nl80211_id = -1;
-    int if_type = -1;
-    s8 interface[MAX_CONF_LINE_LEN];
-    u32 len = MAX_CONF_LINE_LEN;
-    s8 *pif;
-    struct nl_msg* msg = NULL;
+    struct qsap_snap *psnap;
+    int i;
 
-    //get interface name
-    if(NULL == (pif = qsap_get_config_value(pconffile,
-                                 &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGD("%s :interface error \n", __func__);
-        goto nla_put_failure;
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        psnap = __atomic_load_n(&snap_cache[i], __ATOMIC_ACQUIRE);
+        if(psnap && !strcmp(psnap->path, pfile))
+            return psnap;
     }
 
-    interface[len] = '\0';
+    return NULL;
+}
 
-    //allocate socket
-    sk = nl_socket_alloc();
+/** Publish a snapshot in a free slot, else in place of the first one */
+static void qsap_snap_publish(struct qsap_snap *psnap)
+{
+    struct qsap_snap *pold;
+    int i;
 
-    //return if socket allocation fails
-    if(sk == NULL){
-       ALOGE( "socket allocation failure");
-       return ret;
-    }
+    do {
+        for(i=0; (i<QSAP_CFG_CACHE_MAX) && __atomic_load_n(&snap_cache[i], __ATOMIC_ACQUIRE); i++)
+            ;
+        if(i == QSAP_CFG_CACHE_MAX)
+            i = 0;
+        pold = __atomic_load_n(&snap_cache[i], __ATOMIC_ACQUIRE);
+    } while(!__atomic_compare_exchange_n(&snap_cache[i], &pold, psnap, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
 
-    //connect to generic netlink
-    if (genl_connect(sk)) {
-        ALOGE( "Netlink socket Connection failure");
-        ret = eERR_UNKNOWN;
-        goto nla_put_failure;
+    if(NULL != pold)
+        qsap_rcu_retire(&pold->rcu);
+}
+
+static void qsap_snap_put(FILE *fp, s32 (*pidx)[2], u32 num, struct qsap_cfg *pcfg, u32 *poff)
+{
+    struct qsap_snap_ent ent;
+    u32 i, j;
+
+    for(i=0; i<num; i++) {
+        for(j=0; j<2; j++) {
+            ent.off = QSAP_SNAP_ABSENT;
+            ent.len = 0;
+            if(pidx[i][j] >= 0) {
+                ent.off = *poff;
+                ent.len = pcfg->lines[pidx[i][j]].vlen;
+                *poff += ent.len;
+            }
+            fwrite(&ent, sizeof(ent), 1, fp);
+        }
     }
+}
 
-    //find the nl80211 driver ID
-    nl80211_id = genl_ctrl_resolve(sk, "nl80211");
+static void qsap_snap_put_values(FILE *fp, s32 (*pidx)[2], u32 num, struct qsap_cfg *pcfg)
+{
+    u32 i, j;
 
-    //attach a callback
-    nl_socket_modify_cb(sk, NL_CB_VALID, NL_CB_CUSTOM,
-            iftypeCallback, &if_type);
+    for(i=0; i<num; i++) {
+        for(j=0; j<2; j++) {
+            if(pidx[i][j] >= 0)
+                fwrite(pcfg->lines[pidx[i][j]].val, 1, pcfg->lines[pidx[i][j]].vlen, fp);
+        }
+    }
+}
 
-    //allocate a message
-    msg = nlmsg_alloc();
+/**
+ * @brief
+ *        Generate the snapshot of a configuration file, from its clean parsed
+ *        image. Failures are not fatal, the readers then use the text file.
+ * @param pcfg [IN] parsed configuration, matching the file
+ * @return void
+*/
+static void qsap_snap_save(struct qsap_cfg *pcfg)
+{
+    struct qsap_file_update upd;
+    struct qsap_snap_hdr hdr;
+    struct qsap_snap *psnap;
+    s8 path[MAX_FILE_PATH_LEN + sizeof(QSAP_SNAP_SUFFIX)];
+    FILE *fp;
+    u32 off = 0;
 
-    //return if message allocation fails
-    if(msg == NULL){
-       ALOGE( "message allocation failure");
-       goto nla_put_failure;
-    }
+    if((NULL == pcfg) || pcfg->dirty)
+        return;
 
-    // setup the message
-    genlmsg_put(msg, 0, 0, nl80211_id, 0, 0, NL80211_CMD_GET_INTERFACE, 0);
+    qsap_scnprintf(path, sizeof(path), "%s%s", pcfg->path, QSAP_SNAP_SUFFIX);
 
-    //add message attributes
-    NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, if_nametoindex(pif));
+    /** Drop the mapping of the previous snapshot */
+    while(NULL != (psnap = qsap_snap_lookup(pcfg->path)))
+        qsap_snap_drop(psnap);
 
-    // Send the message
-    ret = nl_send_auto_complete(sk, msg);
-    if (ret < 0 ) {
-        ALOGE( "nl_send_auto_complete failure");
-        ret = eERR_UNKNOWN;
-        goto nla_put_failure;
-    }
+    if(NULL == (fp = qsap_file_update_open(&upd, path)))
+        return;
 
-    //block for message to return
-    nl_recvmsgs_default(sk);
-    *pmode = if_type;
-    ALOGI("%s: (%s) NL80211 Get Mode = %d \n",__func__, pif, (int)*pmode);
-    ret = eSUCCESS;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = QSAP_SNAP_MAGIC;
+    hdr.version = QSAP_SNAP_VERSION;
+    hdr.ncmd = eCMD_LAST;
+    hdr.nstr = eSTR_LAST;
+    hdr.layout = qsap_snap_layout();
+    hdr.dev = pcfg->dev;
+    hdr.ino = pcfg->ino;
+    hdr.size = pcfg->size;
+    hdr.mtime_sec = pcfg->mtime.tv_sec;
+    hdr.mtime_nsec = pcfg->mtime.tv_nsec;
+
+    /** The header is written again, once the size of the values is known */
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    qsap_snap_put(fp, pcfg->cmd_line, eCMD_LAST, pcfg, &off);
+    qsap_snap_put(fp, pcfg->str_line, eSTR_LAST, pcfg, &off);
+    qsap_snap_put_values(fp, pcfg->cmd_line, eCMD_LAST, pcfg);
+    qsap_snap_put_values(fp, pcfg->str_line, eSTR_LAST, pcfg);
+
+    hdr.vlen = off;
+    if(fseek(fp, 0, SEEK_SET) || (1 != fwrite(&hdr, sizeof(hdr), 1, fp))) {
+        qsap_file_update_abort(&upd);
+        return;
+    }
 
-nla_put_failure:
-    if (sk)
-        nl_socket_free(sk);
-    if (msg)
-        nlmsg_free(msg);
-    return ret;
+    qsap_file_update_commit(&upd, path);
 }
 
 /**
- *    Set the channel Range for soft AP.
- */
-int qsap_set_channel_range(s8 *buf)
+ * @brief
+ *        Get the snapshot of a configuration file, if it is valid for the
+ *        current text file. A snapshot mapped by a reader is published for the
+ *        other requests as well.
+ * @param pfile [IN] configuration file path
+ * @return On success, pointer to the snapshot
+ *         If there is no valid snapshot, NULL
+*/
+static struct qsap_snap *qsap_snap_get(s8 *pfile)
 {
-    int sock;
-    struct iwreq wrq;
-    s8 interface[MAX_CONF_LINE_LEN];
-    u32 len = MAX_CONF_LINE_LEN;
-    s8 *pif;
-    s8 *temp;
-    int ret;
-    sap_channel_info sap_chan_range;
-    sta_channel_info sta_chan_range;
+    struct qsap_snap *psnap;
+    struct qsap_snap_hdr *phdr;
+    struct stat st, sst;
+    s8 path[MAX_FILE_PATH_LEN + sizeof(QSAP_SNAP_SUFFIX)];
+    size_t need;
+    void *pmap;
+    int fd, mapped = FALSE;
 
-    ALOGE("buf :%s\n", buf);
+    if((NULL == pfile) || (strlen(pfile) >= MAX_FILE_PATH_LEN))
+        return NULL;
 
-    temp = buf;
-    temp = strchr(buf, '=');
-    if (NULL == temp) {
-        goto error;
-    }
-    temp++;
+    psnap = qsap_snap_lookup(pfile);
 
-    if (NULL == (pif = qsap_get_config_value(pconffile,
-                    &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGE("%s :interface error\n", __func__);
-        goto error;
-    }
+    /** Already checked in this request pass */
+    if(psnap && cfg_pass && (__atomic_load_n(&psnap->pass, __ATOMIC_RELAXED) == cfg_pass))
+        return psnap;
 
-    interface[len] = '\0';
+    if(stat(pfile, &st) < 0)
+        return NULL;
 
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0) {
-        ALOGE("%s :socket error\n", __func__);
-        goto error;
-    }
+    if(NULL == psnap) {
+        qsap_scnprintf(path, sizeof(path), "%s%s", pfile, QSAP_SNAP_SUFFIX);
 
-    memset(&sap_chan_range, 0, sizeof(sap_chan_range));
-    memset(&sta_chan_range, 0, sizeof(sta_chan_range));
-    memset(&wrq, 0, sizeof(wrq));
+        fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+        if(fd < 0)
+            return NULL;
 
-    if (ENABLE != is_softap_enabled()) {
-        strlcpy(wrq.ifr_name, "wlan0", sizeof(wrq.ifr_name));
-        sta_chan_range.subioctl = WE_SET_SAP_CHANNELS;
-        ret = sscanf(temp, "%d %d %d", &(sta_chan_range.stastartchan),
-                &(sta_chan_range.staendchan), &(sta_chan_range.staband));
-        if (3 != ret) {
-            ALOGE("%s : sscanf is not successful\n", __func__);
-            close(sock);
-            goto error;
+        if((fstat(fd, &sst) < 0) || (sst.st_size < (off_t)sizeof(*phdr))) {
+            close(fd);
+            return NULL;
         }
-        memcpy(wrq.u.name, (char *)(&sta_chan_range), sizeof(sta_chan_range));
 
-        ALOGE("%s :Softap is off,Send SET_CHANNEL_RANGE over sta interface\n",
-                __func__);
-        ret = ioctl(sock, WLAN_PRIV_SET_THREE_INT_GET_NONE, &wrq);
-    } else {
-          strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
-          ret = sscanf(temp, "%d %d %d", &(sap_chan_range.startchan),
-                  &(sap_chan_range.endchan), &(sap_chan_range.band));
-          if (3 != ret) {
-              ALOGE("%s : sscanf is not successful\n", __func__);
-              close(sock);
-              goto error;
-          }
-          memcpy(wrq.u.name, (char *)(&sap_chan_range), sizeof(sap_chan_range));
+        pmap = mmap(NULL, sst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(MAP_FAILED == pmap)
+            return NULL;
 
-          ALOGE("%s :SAP is on,Send SET_CHANNEL_RANGE over softap interface\n",
-                    __func__);
-          ret = ioctl(sock, QCSAP_IOCTL_SET_CHANNEL_RANGE, &wrq);
-    }
+        psnap = calloc(1, sizeof(*psnap));
+        if(NULL == psnap) {
+            munmap(pmap, sst.st_size);
+            return NULL;
+        }
+        psnap->rcu.release = qsap_snap_release;
+        strlcpy(psnap->path, pfile, sizeof(psnap->path));
+        psnap->data = pmap;
+        psnap->len = sst.st_size;
+        mapped = TRUE;
+    }
+
+    phdr = (struct qsap_snap_hdr *)psnap->data;
+    need = sizeof(*phdr) + (size_t)(eCMD_LAST + eSTR_LAST) * 2 * sizeof(struct qsap_snap_ent) + phdr->vlen;
+
+    if((phdr->magic != QSAP_SNAP_MAGIC) || (phdr->version != QSAP_SNAP_VERSION) ||
+       (phdr->ncmd != eCMD_LAST) || (phdr->nstr != eSTR_LAST) || (psnap->len < need) ||
+       (phdr->layout != qsap_snap_layout()))
+        goto stale;
+
+    if((phdr->dev != (unsigned long long)st.st_dev) || (phdr->ino != (unsigned long long)st.st_ino) ||
+       (phdr->size != (long long)st.st_size) || (phdr->mtime_sec != (long long)st.st_mtim.tv_sec) ||
+       (phdr->mtime_nsec != (long long)st.st_mtim.tv_nsec))
+        goto stale;
+
+    __atomic_store_n(&psnap->pass, cfg_pass, __ATOMIC_RELAXED);
+    if(mapped)
+        qsap_snap_publish(psnap);
+    return psnap;
+
+stale:
+    if(mapped)
+        qsap_snap_free(psnap);
+    else
+        qsap_snap_drop(psnap);
+    return NULL;
+}
 
-    if (ret < 0) {
-        ALOGE("%s: ioctl failure\n", __func__);
-        close(sock);
-        goto error;
-    }
+/**
+ * @brief
+ *        Look up the value of a parameter in the snapshot of the file.
+ * @return eSUCCESS if the parameter is found
+ *         eERR_CONFIG_PARAM_MISSING if the parameter is absent from the file
+ *         eERR_UNKNOWN if the snapshot can not be used
+*/
+static s32 qsap_snap_get_value(s8 *pfile, struct Command *pcmd, s32 ignore_comment, const s8 **pval, u32 *pvlen)
+{
+    struct qsap_snap *psnap;
+    struct qsap_snap_ent *pent;
+    u8 *pvalues;
+    u32 n;
+
+    if((pcmd >= cmd_list) && (pcmd < &cmd_list[eCMD_LAST]))
+        n = pcmd - cmd_list;
+    else if((pcmd >= qsap_str) && (pcmd < &qsap_str[eSTR_LAST]))
+        n = eCMD_LAST + (pcmd - qsap_str);
+    else
+        return eERR_UNKNOWN;
 
-    ALOGE("Recv len :%d\n", wrq.u.data.length);
+    if(NULL == (psnap = qsap_snap_get(pfile)))
+        return eERR_UNKNOWN;
 
-    close(sock);
-    return eSUCCESS;
+    pent = (struct qsap_snap_ent *)(psnap->data + sizeof(struct qsap_snap_hdr));
+    pvalues = (u8 *)&pent[(eCMD_LAST + eSTR_LAST) * 2];
+    pent = &pent[n * 2 + (ignore_comment ? GET_COMMENTED_VALUE : GET_ENABLED_ONLY)];
 
-error:
-    ALOGE("%s: Failed to set channel range\n", __func__);
-    return eERR_SET_CHAN_RANGE;
-}
+    if(pent->off == QSAP_SNAP_ABSENT)
+        return eERR_CONFIG_PARAM_MISSING;
 
-int qsap_read_channel(UNUSED s8 *pfile, struct Command *pcmd, s8 *presp, u32 *plen, UNUSED s8 *pvar)
-{
-    s32  chan;
-    u32  len = *plen;
+    if(((unsigned long long)pent->off + pent->len) > ((struct qsap_snap_hdr *)psnap->data)->vlen)
+        return eERR_UNKNOWN;
 
-   if(eSUCCESS == qsap_get_operating_channel(&chan)) {
-            *plen = qsap_scnprintf(presp, len, "%s %s=%lu", SUCCESS, pcmd->name, chan);
-             ALOGD("presp :%s\n", presp);
-   } else {
-          *plen = qsap_scnprintf(presp, len, "%s", ERR_UNKNOWN);
-   }
+    *pval = (const s8 *)pvalues + pent->off;
+    *pvlen = pent->len;
 
     return eSUCCESS;
 }
+#else
+static void qsap_snap_save(UNUSED struct qsap_cfg *pcfg)
+{
+}
+#endif /* QSAP_CONFIG_SNAPSHOT */
 
-int qsap_read_auto_channel(UNUSED struct Command *pcmd, s8 *presp, u32 *plen)
+/**
+ * @brief
+ *        Look up the value of a configuration parameter, without copying it.
+ *        If the parameter is absent, its default value is returned, if any.
+ * @param pfile [IN] configuration file path
+ * @param pcmd [IN] pointer to the comand structure
+ * @param ignore_comment [IN] if set, the commented value is also considered
+ * @param pval [OUT] the value, not null terminated. Valid until the file is
+ *                   parsed again, or the parameter is updated
+ * @param pvlen [OUT] length of the value
+ * @return On success, eSUCCESS
+ *         If the file can not be read, eERR_FILE_OPEN
+ *         If the parameter is absent, eERR_CONFIG_PARAM_MISSING
+*/
+static s32 qsap_cfg_get_value(s8 *pfile, struct Command *pcmd, s32 ignore_comment, const s8 **pval, u32 *pvlen)
 {
-    s32  pautochan;
-    u32  len = *plen;
+    struct qsap_cfg *pcfg;
+    struct qsap_cfg_line *pline;
 
-    ALOGE("%s :\n", __func__);
+#ifdef QSAP_CONFIG_SNAPSHOT
+    s32 status = eERR_UNKNOWN;
 
-    if (eSUCCESS == qsap_get_sap_auto_channel_selection(&pautochan)) {
-          *plen = qsap_scnprintf(presp, len, "%s autochannel=%lu", SUCCESS, pautochan);
-          ALOGE("presp :%s\n", presp);
-    } else {
-          *plen = qsap_scnprintf(presp, len, "%s", ERR_UNKNOWN);
+    /** A file which is not parsed yet is served from its snapshot */
+    if(pfile && (NULL == qsap_cfg_staged(pfile)) && (NULL == qsap_cfg_lookup(pfile)))
+        status = qsap_snap_get_value(pfile, pcmd, ignore_comment, pval, pvlen);
+
+    if(eSUCCESS == status)
+        return eSUCCESS;
+
+    if(eERR_UNKNOWN == status)
+#endif
+    {
+        /** Get the parsed configuration file */
+        pcfg = qsap_cfg_get(pfile);
+        if(NULL == pcfg)
+            return eERR_FILE_OPEN;
+
+        /** Identify the configuration parameter in the configuration file */
+        pline = qsap_cfg_find(pcfg, pcmd, ignore_comment);
+        if(NULL != pline) {
+            *pval = pline->val;
+            *pvlen = pline->vlen;
+            return eSUCCESS;
+        }
     }
 
-    return eSUCCESS;
+    /** Value not found in the configuration file */
+    /** Use the default value, if we are reading from ini file */
+    if(pcmd->default_value) {
+        *pval = pcmd->default_value;
+        *pvlen = strlen(pcmd->default_value);
+        return eSUCCESS;
+    }
+
+    return eERR_CONFIG_PARAM_MISSING;
 }
 
-static int qsap_mac_to_macstr(s8 *pmac, u32 slen, s8 *pmstr, u32 *plen)
+/**
+ * @brief
+ *        Replace the text of a line of the parsed configuration.
+ * @param pcfg [IN-OUT] parsed configuration
+ * @param n [IN] line number
+ * @param ptext [IN] new text of the line, without the new line character
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_cfg_set_line(struct qsap_cfg *pcfg, u32 n, const s8 *ptext, u32 len)
 {
-    int len;
-    int totlen = 0;
+    struct qsap_cfg_line *pline = &pcfg->lines[n];
+    s8 *buf;
 
-    while((slen > 0) && (*plen > 0)) {
-        len = qsap_scnprintf(pmstr, *plen, "%.2X:%.2X:%.2X:%.2X:%.2X:%.2X ", (int)pmac[0], (int)pmac[1], (int)pmac[2],
-                            (int)pmac[3], (int)pmac[4], (int)pmac[5]);
-        pmac += 6;
-        slen -= 6;
-        *plen -= len;
-        pmstr += len;
-        totlen += len;
-    }
+    buf = malloc(len + 1);
+    if(NULL == buf)
+        return eERR_UNKNOWN;
 
-    if(totlen > 0) {
-        pmstr--;
-        totlen--;
-    }
-    *pmstr = '\0';
-    *plen = totlen;
+    memcpy(buf, ptext, len);
+    buf[len] = '\0';
 
-    return 0;
+    free(pline->alloc);
+    pline->alloc = pline->text = buf;
+    pline->len = len;
+    qsap_cfg_split_line(pline);
+
+    if(pline->klen)
+        qsap_cfg_reindex(pcfg, pline->key, pline->klen);
+
+    return eSUCCESS;
 }
 
-#define MAX_STA_ALLOWED  8
-void qsap_get_associated_sta_mac(s8 *presp, u32 *plen)
+/**
+ * @brief
+ *        Insert a new line in the parsed configuration, before the line 'pos'.
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_cfg_insert_line(struct qsap_cfg *pcfg, u32 pos, const s8 *ptext, u32 len)
 {
-    int sock, ret;
-    struct iwreq wrq;
-    s8 interface[MAX_CONF_LINE_LEN];
-    u32 len = MAX_CONF_LINE_LEN;
-    s8 *pif;
-    s8 *pbuf, *pout;
-    u32 buflen;
-    u32 recvLen;
-    u32 tlen;
+    struct qsap_cfg_line *plines;
+    u32 i;
 
-    if(ENABLE != is_softap_enabled()) {
-        goto error;
-    }
+    plines = realloc(pcfg->lines, (pcfg->nlines + 1) * sizeof(struct qsap_cfg_line));
+    if(NULL == plines)
+        return eERR_UNKNOWN;
 
-    if(NULL == (pif = qsap_get_config_value(pconffile, &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGE("%s :interface error \n", __func__);
-        goto error;
-    }
-    interface[len] = '\0';
+    pcfg->lines = plines;
+    memmove(&plines[pos+1], &plines[pos], (pcfg->nlines - pos) * sizeof(struct qsap_cfg_line));
+    memset(&plines[pos], 0, sizeof(struct qsap_cfg_line));
+    if(pos == pcfg->nlines)
+        pcfg->noeol = FALSE;
+    pcfg->nlines++;
 
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if(sock < 0) {
-        ALOGE("%s :socket failure \n", __func__);
-        goto error;
+    /** The lines below the new line moved down */
+    for(i=0; i<eCMD_LAST; i++) {
+        if(pcfg->cmd_line[i][0] >= (s32)pos) pcfg->cmd_line[i][0]++;
+        if(pcfg->cmd_line[i][1] >= (s32)pos) pcfg->cmd_line[i][1]++;
     }
-
-    /* response has length field + 6 bytes per STA */
-    buflen = sizeof(u32) + (MAX_STA_ALLOWED * 6);
-    pbuf = (s8 *)malloc(buflen);
-    if(NULL == pbuf) {
-        ALOGE("%s :No memory \n", __func__);
-        close(sock);
-        goto error;
+    for(i=0; i<eSTR_LAST; i++) {
+        if(pcfg->str_line[i][0] >= (s32)pos) pcfg->str_line[i][0]++;
+        if(pcfg->str_line[i][1] >= (s32)pos) pcfg->str_line[i][1]++;
     }
+    if(pcfg->end_line >= (s32)pos)
+        pcfg->end_line++;
 
+    if(eSUCCESS != qsap_cfg_set_line(pcfg, pos, ptext, len)) {
+        /** Keep an empty line, the image stays consistent */
+        plines[pos].text = "";
+        return eERR_UNKNOWN;
+    }
 
-#define SIZE_OF_MAC_INT   (6)
-    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
-    wrq.u.data.length = buflen;
-    wrq.u.data.pointer = (void *)pbuf;
-    wrq.u.data.flags = 0;
+    return eSUCCESS;
+}
 
-    ret = ioctl(sock, QCSAP_IOCTL_ASSOC_STA_MACADDR, &wrq);
-    if(ret < 0) {
-        ALOGE("%s :ioctl failure \n", __func__);
-        free(pbuf);
-        close(sock);
-        goto error;
-    }
+/**
+ * @brief
+ *        Update a configuration parameter in the parsed configuration, the
+ *        same way qsap_write_cfg() updates the file: the first line of the
+ *        parameter, commented or not, is replaced by 'name=value'. If the
+ *        parameter is absent, it is added at the end of the file, or just
+ *        before the "END" line of the ini file.
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_cfg_write(struct qsap_cfg *pcfg, struct Command *pcmd, s8 *pVal, s32 inifile)
+{
+    struct qsap_cfg_line *pline;
+    s8 *buf;
+    int len;
+    u32 limit;
+    s32 ret;
 
-    recvLen = *(u32 *)(wrq.u.data.pointer);
-    recvLen -= sizeof(u32);
+    len = asprintf(&buf, "%s=%s", pcmd->name, pVal);
+    if(len < 0)
+        return eERR_UNKNOWN;
 
-    len = qsap_scnprintf(presp, *plen, "%s %s=", SUCCESS, cmd_list[eCMD_ASSOC_STA_MACS].name);
-    pout = presp + len;
-    tlen = *plen - len;
+    limit = pcfg->nlines;
+    if(inifile && (pcfg->end_line >= 0))
+        limit = pcfg->end_line;
 
-    qsap_mac_to_macstr(pbuf+sizeof(u32), recvLen, pout, &tlen);
+    pline = qsap_cfg_find(pcfg, pcmd, GET_COMMENTED_VALUE);
 
-    *plen = len + tlen;
+    if((NULL != pline) && ((u32)(pline - pcfg->lines) < limit)) {
+        ret = qsap_cfg_set_line(pcfg, pline - pcfg->lines, buf, len);
+    }
+    else {
+        ALOGD("Adding a new line in %s file: [%s] \n", inifile ? "inifile" : "hostapd.conf", buf);
+        ret = qsap_cfg_insert_line(pcfg, limit, buf, len);
 
-    free(pbuf);
-    close(sock);
+        if((eSUCCESS == ret) && inifile && (pcfg->end_line < 0)) {
+            ret = qsap_cfg_insert_line(pcfg, limit + 1, "END", 3);
+            pcfg->end_line = limit + 1;
+        }
+    }
 
-    return;
-error:
-    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+    free(buf);
+    pcfg->dirty = TRUE;
 
-    return;
+    return ret;
 }
 
-static void qsap_read_wep_key(s8 *pfile, struct Command *pcmd, s8 *presp, u32 *plen, s8 *var)
+/**
+ * @brief
+ *        Enable or disable all the lines of a configuration parameter in the
+ *        parsed configuration. Only the comment flag of the lines changes.
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_cfg_change(struct qsap_cfg *pcfg, struct Command *pcmd, u32 status)
 {
-    s8 *pwep;
-    s8 *pkey;
+    u8 commented = (status == DISABLE);
+    u32 i, len;
+    int changed = FALSE;
 
-    if(eSUCCESS != qsap_read_cfg(pfile, pcmd, presp, plen, var, GET_COMMENTED_VALUE))
-        return;
+    len = strlen(pcmd->name);
 
-    pwep = strchr(presp, '=');
-    if(NULL == pwep)
-        return;
-    pwep++;
+    for(i=0; i<pcfg->nlines; i++) {
+        struct qsap_cfg_line *pline = &pcfg->lines[i];
 
-    if(pwep[0] == '"') {
-        pkey = pwep;
-        pwep++;
+        if((pline->klen != len) || memcmp(pline->key, pcmd->name, len))
+            continue;
 
-        while(*pwep != '\0') {
-            *pkey = *pwep;
-             pkey++;
-             pwep++;
+        if(pline->commented != commented) {
+            pline->commented = commented;
+            changed = TRUE;
         }
-        pkey--;
-        *pkey = '\0';
-        *plen -= 2;
     }
 
-    return;
+    if(changed) {
+        qsap_cfg_reindex(pcfg, pcmd->name, len);
+        pcfg->dirty = TRUE;
+    }
+
+    return eSUCCESS;
 }
 
-void qsap_read_ap_stats(s8 *presp, u32 *plen)
+/**
+ * @brief
+ *        Write a staged image back to its file, and publish it in place of
+ *        the image of the previous file.
+ * @param pcfg [IN-OUT] staged image
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_cfg_flush(struct qsap_cfg *pcfg)
 {
-    int sock, ret;
-    struct iwreq wrq;
-    s8 interface[MAX_CONF_LINE_LEN];
-    u32 len = MAX_CONF_LINE_LEN;
-    s8 *pif;
-    s8 *pbuf;
+    struct qsap_file_update upd;
+    FILE *ftmp;
+    struct stat st;
+    u32 i;
+    int known;
 
-    if(ENABLE != is_softap_enabled()) {
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_SOFTAP_NOT_STARTED);
-        return;
+    /** Open a temporary file */
+    ftmp = qsap_file_update_open(&upd, pcfg->path);
+    if(NULL == ftmp) {
+        ALOGE("%s : unable to open tmp file \n", __func__);
+        return eERR_UNKNOWN;
     }
 
-    if(NULL == (pif = qsap_get_config_value(pconffile, &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGE("%s :interface error \n", __func__);
-        goto error;
-    }
-    interface[len] = '\0';
+    for(i=0; i<pcfg->nlines; i++) {
+        struct qsap_cfg_line *pline = &pcfg->lines[i];
 
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if(sock < 0) {
-        ALOGE("%s :socket failure \n", __func__);
-        goto error;
+        qsap_cfg_put_line(ftmp, pline, ((i + 1) < pcfg->nlines) || !pcfg->noeol);
     }
 
-    pbuf = (s8 *)malloc(MAX_RESP_LEN);
-    if(NULL == pbuf) {
-        ALOGE("%s :No memory \n", __func__);
-        close(sock);
-        goto error;
-    }
+    /** The published file keeps the inode, size and mtime of the temporary file */
+    known = !fflush(ftmp) && (fstat(fileno(ftmp), &st) == 0);
 
-    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
-    wrq.u.data.length = MAX_RESP_LEN;
-    wrq.u.data.pointer = (void *)pbuf;
-    wrq.u.data.flags = 0;
+    /** Restore the updated configuration file */
+    if(eSUCCESS != qsap_file_update_commit(&upd, pcfg->path))
+        return eERR_UNKNOWN;
 
-    ret = ioctl(sock, QCSAP_IOCTL_AP_STATS, &wrq);
-    if(ret < 0) {
-        ALOGE("%s :ioctl failure \n", __func__);
-        free(pbuf);
-        close(sock);
-        goto error;
+    /** The image now matches the file */
+    pcfg->dirty = FALSE;
+    if(!known) {
+        qsap_cfg_unstage(pcfg, FALSE);
+        return eSUCCESS;
     }
 
-    *plen = qsap_scnprintf(presp, *plen, "%s %s=%s", SUCCESS, cmd_list[eCMD_AP_STATISTICS].name, pbuf);
+    pcfg->dev = st.st_dev;
+    pcfg->ino = st.st_ino;
+    pcfg->size = st.st_size;
+    pcfg->mtime = st.st_mtim;
 
-    free(pbuf);
-    close(sock);
-    return;
+    /** The driver ini file has no snapshot */
+    if(strcmp(pcfg->path, fIni))
+        qsap_snap_save(pcfg);
 
-error:
-    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+    /** The readers see the update from now on */
+    qsap_cfg_unstage(pcfg, TRUE);
 
-    return;
+    return eSUCCESS;
 }
 
-void qsap_read_autoshutoff(s8 *presp, u32 *plen)
+/**
+ * @brief
+ *        Write the updated configuration to its file, unless the update is
+ *        part of a transaction. On failure, the staged image is dropped.
+ * @param pcfg [IN-OUT] staged image
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_cfg_apply(struct qsap_cfg *pcfg)
 {
-    u32 tlen, time = 0;
-    s8 *ptime;
-
-    tlen = *plen;
+    if(cfg_tx_owner)
+        return eSUCCESS;
 
-    if(NULL == (ptime = qsap_get_config_value(fIni, &qsap_str[STR_AP_AUTOSHUTOFF], presp, &tlen))) {
-        /** unable to read the AP shutoff time */
-        ALOGE("%s :Failed to read AP shutoff time\n", __func__);
+    if(!pcfg->dirty) {
+        qsap_cfg_unstage(pcfg, FALSE);
+        return eSUCCESS;
     }
-    else {
-        time = atoi(ptime);
-        time = time / 60; /** Convert seconds to minutes */
+
+    if(eSUCCESS != qsap_cfg_flush(pcfg)) {
+        qsap_cfg_unstage(pcfg, FALSE);
+        return eERR_UNKNOWN;
     }
 
-    *plen = qsap_scnprintf(presp, *plen, "success %s=%d", cmd_list[eCMD_AP_AUTOSHUTOFF].name, time);
+    return eSUCCESS;
+}
 
-    return;
+static void qsap_abort_transaction(void);
+
+/** Abort the transaction left open by an exiting thread, its updates would
+  * never be committed and the other threads could not update any more */
+static void qsap_tx_exit(UNUSED void *arg)
+{
+    qsap_lock(QSAP_LOCK_WRITE);
+    if(cfg_tx_owner) {
+        ALOGE("%s : transaction aborted on thread exit \n", __func__);
+        qsap_abort_transaction();
+    }
+    qsap_unlock(NULL);
 }
 
+static pthread_key_t tx_exit_key;
+static pthread_once_t tx_exit_once = PTHREAD_ONCE_INIT;
+
+static void qsap_tx_exit_init(void)
+{
+    if(pthread_key_create(&tx_exit_key, qsap_tx_exit))
+        ALOGE("%s : no thread key, a transaction is not aborted on thread exit \n", __func__);
+}
 
 /**
  * @brief
- *       Get the configuration information from the softAP configuration
- *       files
- * @param cNum [INPUT]
- * @param presp [OUTPUT] presp The command output format :
- *                    On success,
- *                            success <cmd>=<value>
- *                    On failure,
- *                            failure <error message>
- * @param plen [IN-OUT] plen
- *                      [IN] The length of the buffer, presp
- *                      [OUT] The length of the response in the buffer, presp
+ *        Start staging the configuration updates of the thread in memory. The
+ *        updates are written to the configuration files by
+ *        qsap_commit_transaction(). Called with the lock held, when no other
+ *        thread has a transaction open.
  * @return void
-**/
-static void qsap_get_from_config(esap_cmd_t cNum, s8 *presp, u32 *plen)
+*/
+static void qsap_begin_transaction(void)
 {
-    u32 len;
-    int status;
+    if(cfg_tx_owner)
+        return;
 
-    switch(cNum) {
+    pthread_once(&tx_exit_once, qsap_tx_exit_init);
+    pthread_setspecific(tx_exit_key, &cfg_tx_owner);
+
+    cfg_tx_owner = TRUE;
+    __atomic_store_n(&gTransaction, 1, __ATOMIC_RELAXED);
+}
+
+/** End the transaction of the thread, the staged images are already released */
+static void qsap_end_transaction(void)
+{
+    cfg_tx_owner = FALSE;
+    __atomic_store_n(&gTransaction, 0, __ATOMIC_RELAXED);
+    pthread_setspecific(tx_exit_key, NULL);
+}
+
+/** Check if a configuration file staged by the transaction was replaced since
+  * it was staged, by another process or by a fix of the file */
+static int qsap_cfg_changed(struct qsap_cfg *pcfg)
+{
+    struct stat st;
+
+    if(stat(pcfg->path, &st) < 0)
+        return TRUE;
+
+    return (pcfg->dev != st.st_dev) || (pcfg->ino != st.st_ino) ||
+           (pcfg->size != st.st_size) ||
+           (pcfg->mtime.tv_sec != st.st_mtim.tv_sec) ||
+           (pcfg->mtime.tv_nsec != st.st_mtim.tv_nsec);
+}
+
+/**
+ * @brief
+ *        Write all the staged configuration updates, with one rewrite of each
+ *        updated configuration file. If a file was replaced meanwhile, the
+ *        updates would overwrite its changes: the whole transaction is
+ *        discarded instead.
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_commit_transaction(void)
+{
+    s32 status = eSUCCESS;
+    int i;
+
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        if(cfg_staged[i] && cfg_staged[i]->dirty && qsap_cfg_changed(cfg_staged[i])) {
+            ALOGE("%s : %s changed during the transaction \n", __func__, cfg_staged[i]->path);
+            qsap_abort_transaction();
+            return eERR_UNKNOWN;
+        }
+    }
+
+    qsap_end_transaction();
+
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        struct qsap_cfg *pcfg = cfg_staged[i];
+
+        if(NULL == pcfg)
+            continue;
+
+        if(!pcfg->dirty) {
+            qsap_cfg_unstage(pcfg, FALSE);
+            continue;
+        }
+
+        if(eSUCCESS != qsap_cfg_flush(pcfg)) {
+            ALOGE("%s : failed to update %s \n", __func__, pcfg->path);
+            qsap_cfg_unstage(pcfg, FALSE);
+            status = eERR_UNKNOWN;
+        }
+    }
+
+    /** The running hostapd takes the committed values it can */
+    qsap_live_flush(eSUCCESS == status);
+
+    return status;
+}
+
+/**
+ * @brief
+ *        Discard all the staged configuration updates.
+ * @return void
+*/
+static void qsap_abort_transaction(void)
+{
+    int i;
+
+    if(!cfg_tx_owner)
+        return;
+
+    qsap_end_transaction();
+
+    for(i=0; i<QSAP_CFG_CACHE_MAX; i++) {
+        if(cfg_staged[i])
+            qsap_cfg_unstage(cfg_staged[i], FALSE);
+    }
+
+    qsap_live_flush(FALSE);
+}
+
+/**
+ * @brief
+ *        For a give configuration parameter, read the configuration value from the file.
+ *        The value is looked up in the parsed image of the file, which is built
+ *        on the first access and rebuilt only when the file changes. The value
+ *        is copied from the mapped file straight into 'presp'.
+ * @param pfile [IN] configuration file path
+ * @param pcmd [IN] pointer to the comand structure
+ * @param presp [OUT] buffer to store the configuration value
+ * @param plen [IN-OUT] The length of the buffer is provided as input.
+ *                      The length of the configuration parameter value, stored
+ *                      in the 'presp', is provided as the output
+ * @param ignore_comment [IN] if set, read the commented value also
+ * @return void
+*/
+static s32 qsap_read_cfg(s8 *pfile, struct Command * pcmd, s8 *presp, u32 *plen, s8 *var, s32 ignore_comment)
+{
+    const s8 *val;
+    u32 vlen;
+    s32 status;
+
+    status = qsap_cfg_get_value(pfile, pcmd, ignore_comment, &val, &vlen);
+
+    if(eERR_FILE_OPEN == status) {
+        ALOGE("%s : unable to open file \n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
+
+    if(eSUCCESS == status) {
+        *plen = qsap_scnprintf(presp, *plen, "%s %s=%.*s", SUCCESS, var ? var : pcmd->name, (int)vlen, val);
+        return eSUCCESS;
+    }
+
+    /** Configuration parameter is absent in the file */
+    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_FEATURE_NOT_ENABLED);
+
+    return eERR_CONFIG_PARAM_MISSING;
+}
+
+/**
+ * @brief
+ *        Find the line of a parameter which is enabled in the section of the
+ *        ini file before the "END" line.
+ * @return On success, pointer to the line
+ *         If the parameter is absent, commented or after "END", NULL
+*/
+static struct qsap_cfg_line *qsap_ini_find(struct qsap_cfg *pcfg, struct Command *pcmd)
+{
+    struct qsap_cfg_line *pline = qsap_cfg_find(pcfg, pcmd, GET_COMMENTED_VALUE);
+
+    if((NULL == pline) || pline->commented || (pcfg->end_line <= (pline - pcfg->lines)))
+        return NULL;
+
+    return pline;
+}
+
+/** Record that the value of a driver ini parameter changed */
+static void qsap_ini_mark_updated(struct Command *pcmd)
+{
+    if((pcmd >= qsap_str) && (pcmd < &qsap_str[eSTR_LAST]))
+        gIniUpdated |= 1u << (pcmd - qsap_str);
+}
+
+/**
+ * @brief
+ *        Write a parameter into the driver ini file, with a single rewrite of
+ *        the file. The file is replaced, not patched in place, so that the
+ *        readers of the mapped file never see a partial value. Writing the
+ *        current value does nothing.
+ * @param pfile [IN] ini file path
+ * @param pcmd [IN] ini parameter
+ * @param pVal [IN] the new value
+ * @param presp [OUT] buffer to store the response
+ * @param plen [IN-OUT] length of 'presp' as input, length of the response as output
+ * @return On success, eSUCCESS
+*/
+static s32 qsap_write_ini(s8 *pfile, struct Command *pcmd, s8 *pVal, s8 *presp, u32 *plen)
+{
+    struct qsap_cfg *pcfg = qsap_cfg_get(pfile);
+    struct qsap_cfg_line *pline;
+    u32 len = strlen(pVal);
+
+    if(NULL == pcfg) {
+        ALOGE("%s : unable to open file \n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
+
+    pline = qsap_ini_find(pcfg, pcmd);
+
+    if((NULL != pline) && (pline->vlen == len) && !memcmp(pline->val, pVal, len)) {
+        ALOGD("%s: %s is unchanged\n", __func__, pcmd->name);
+        *plen = qsap_scnprintf(presp, *plen, "%s", SUCCESS);
+        return eSUCCESS;
+    }
+
+    if(NULL == (pcfg = qsap_cfg_get_update(pfile))) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
+
+    if(eSUCCESS != qsap_cfg_write(pcfg, pcmd, pVal, INI_CONF_FILE)) {
+        if(!cfg_tx_owner)
+            qsap_cfg_unstage(pcfg, FALSE);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+        return eERR_UNKNOWN;
+    }
+    qsap_ini_mark_updated(pcmd);
+
+    /** In a transaction, the file is written on commit */
+    if(eSUCCESS != qsap_cfg_apply(pcfg)) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_FEATURE_NOT_ENABLED);
+        return eERR_FEATURE_NOT_ENABLED;
+    }
+
+    *plen = qsap_scnprintf(presp, *plen, "%s", SUCCESS);
+    return eSUCCESS;
+}
+
+/**
+ * @brief
+ *        Write the configuration parameter value into the configuration file.
+ *        The line of the parameter is updated in the parsed configuration,
+ *        which is then written to the file.
+ * @param pfile [IN] configuration file path.
+ * @param pcmd [IN] command name
+ * @param pVal [IN] configuration parameter to be written to the file.
+ * @param presp [OUT] buffer to store the configuration value.
+ * @param plen [IN-OUT] The length of the buffer is provided as input.
+ *                      The length of the configuration parameter value, stored
+ *                      in the 'presp', is provided as the output
+ * @return void
+*/
+static s32 qsap_write_cfg(s8 *pfile, struct Command * pcmd, s8 *pVal, s8 *presp, u32 *plen, s32 inifile)
+{
+    struct qsap_cfg *pcfg;
+
+    ALOGD("cmd=%s, Val:%s, INI:%d \n", pcmd->name, pVal, inifile);
+
+    if(inifile)
+        return qsap_write_ini(pfile, pcmd, pVal, presp, plen);
+
+    /** Get the parsed configuration file */
+    pcfg = qsap_cfg_get_update(pfile);
+    if(NULL == pcfg) {
+        ALOGE("%s : unable to open file \n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
+
+    /** Update the line of the parameter */
+    if(eSUCCESS != qsap_cfg_write(pcfg, pcmd, pVal, inifile)) {
+        if(!cfg_tx_owner)
+            qsap_cfg_unstage(pcfg, FALSE);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+        return eERR_UNKNOWN;
+    }
+
+    /** Write the file. In a transaction, the file is written on commit */
+    if(eSUCCESS != qsap_cfg_apply(pcfg)) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_FEATURE_NOT_ENABLED);
+        return eERR_FEATURE_NOT_ENABLED;
+    }
+
+    *plen = qsap_scnprintf(presp, *plen, "%s", SUCCESS);
+
+    return eSUCCESS;
+}
+
+/**
+ * @brief Read the security mode set in the configuration
+ * @param pfile [IN] configuration file path.
+ * @param presp [OUT] buffer to store the security mode.
+ * @param plen [IN-OUT] The length of the buffer is provided as input.
+ *                      The length of the security mode value, stored
+ *                      in the 'presp', is provided as the output
+ * @return void
+*/
+static sec_mode_t qsap_read_security_mode(s8 *pfile, s8 *presp, u32 *plen)
+{
+    sec_mode_t mode;
+    u32 temp = *plen;
+
+    /** Read the WEP default key */
+    qsap_read_cfg(pfile, &cmd_list[eCMD_DEFAULT_KEY], presp, plen, NULL, GET_ENABLED_ONLY);
+
+    if ( !strcmp(presp, ERR_FEATURE_NOT_ENABLED) ) {
+        *plen = temp;
+
+        /* WEP, is not enabled */
+
+        /** Read WPA security status */
+        qsap_read_cfg(pfile, &qsap_str[STR_WPA], presp, plen, NULL, GET_ENABLED_ONLY);
+        if ( !strcmp(presp, ERR_FEATURE_NOT_ENABLED) ) {
+            /** WPA is disabled, No security */
+            mode = SEC_MODE_NONE;
+        }
+        else {
+            /** WPA, WPA2 or WPA-WPA2 mixed security */
+            s8 * ptmp = presp;
+            while((*plen)-- && (*ptmp++ != '=') );
+            mode =     *plen ? (
+                    *ptmp == '1' ? SEC_MODE_WPA_PSK :
+                    *ptmp == '2' ? SEC_MODE_WPA2_PSK :
+                    *ptmp == '3' ? SEC_MODE_WPA_WPA2_PSK : SEC_MODE_INVALID ): SEC_MODE_INVALID;
+        }
+    }
+    else {
+        /** Verify if, WPA is disabled */
+        *plen = temp;
+        qsap_read_cfg(pfile, &qsap_str[STR_WPA], presp, plen, NULL, GET_ENABLED_ONLY);
+        if ( !strcmp(presp, ERR_FEATURE_NOT_ENABLED) ) {
+            /** WPA is disabled, hence WEP is enabled */
+            mode = SEC_MODE_WEP;
+        }
+        else {
+            *plen = qsap_scnprintf(presp, temp, "%s", ERR_UNKNOWN);
+            return SEC_MODE_INVALID;
+        }
+    }
+
+    if(mode != SEC_MODE_INVALID) {
+        *plen = qsap_scnprintf(presp, temp,"%s %s=%d", SUCCESS, cmd_list[eCMD_SEC_MODE].name, mode);
+    }
+    else {
+        *plen = qsap_scnprintf(presp, temp,"%s", ERR_NOT_SUPPORTED);
+    }
+
+    return mode;
+}
+
+/** Enable or disable request for a configuration parameter */
+struct qsap_cfg_toggle {
+    struct Command *pcmd;
+    u32 status;
+};
+
+/**
+ * @brief
+ *         Enable or disable a set of configuration parameters in the
+ *         parsed configuration, and write the file once.
+ * @param pfile [IN] configuration file name
+ * @param ptoggle [IN] the parameters, and the status to be set for each of them.
+ *                     The valid status values are 'ENABLE' or 'DISABLE'
+ * @param num [IN] number of entries in 'ptoggle'
+ * @return On success, return 0
+ *         On failure, return -1
+*/
+static s32 qsap_change_cfg_list(s8 *pfile, struct qsap_cfg_toggle *ptoggle, u32 num)
+{
+    struct qsap_cfg *pcfg;
+    u32 i;
+
+    /** Get the parsed configuration file */
+    pcfg = qsap_cfg_get_update(pfile);
+    if(NULL == pcfg) {
+        ALOGE("%s : unable to open file \n", __func__);
+        return eERR_UNKNOWN;
+    }
+
+    for(i=0; i<num; i++)
+        qsap_cfg_change(pcfg, ptoggle[i].pcmd, ptoggle[i].status);
+
+    /** Write the file once. In a transaction, the file is written on commit */
+    if(eSUCCESS != qsap_cfg_apply(pcfg)) {
+        ALOGE("%s : unable to update %s \n", __func__, pfile);
+        return eERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief
+ *         Enable or disable a configuration parameter in the configuration file.
+ * @param pfile [IN] configuration file name
+ * @param pcmd [IN] configuration command structure
+ * @param status [IN] status to be set. The valid values are 'ENABLE' or 'DISABLE'
+ * @return On success, return 0
+ *         On failure, return -1
+*/
+static s32 qsap_change_cfg(s8 *pfile, struct Command * pcmd, u32 status)
+{
+    struct qsap_cfg_toggle toggle = { pcmd, status };
+
+    return qsap_change_cfg_list(pfile, &toggle, 1);
+}
+
+/**
+ * @brief
+ *         Set the security mode in the configuration. The security mode
+ *         can be :
+ *                   1. No security
+ *                   2. WEP
+ *                   3. WPA
+ *                   4. WPA2
+ *                   5. WPA and WPA2 mixed mode
+ * @param pfile [IN] configuration file name
+ * @param sec_mode [IN] security mode to be set
+ * @param presp [OUTPUT] presp The command output format :
+ *                    On success,
+ *                            success <cmd>=<value>
+ *                    On failure,
+ *                            failure <error message>
+ * @param plen [IN-OUT] plen
+ *                      [IN] The length of the buffer, presp
+ *                      [OUT] The length of the response in the buffer, presp
+ * @return On success, eSUCCESS
+ *         or the error code of the failed update
+*/
+static s32 qsap_set_security_mode(s8 *pfile, u32 sec_mode, s8 *presp, u32 *plen)
+{
+    s16 wep, wpa;
+    s8 sec[MAX_INT_STR];
+    s32 rsn_status = DISABLE;
+    s32 ret = eERR_UNKNOWN;
+    struct qsap_cfg_toggle toggle[9];
+    u32 num = 0;
+
+    /** Is valid security mode ? */
+    if(sec_mode >= SEC_MODE_INVALID) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+        return eERR_UNKNOWN;
+    }
+
+    /** No security */
+    if(SEC_MODE_NONE == sec_mode) {
+        wep = DISABLE;
+        wpa = DISABLE;
+    }
+    /** WEP security */
+    else if(SEC_MODE_WEP == sec_mode) {
+        wep = ENABLE;
+        wpa = DISABLE;
+    }
+    else {
+        /** WPA, WPA2 and mixed-mode security */
+        u16 wpa_val = 0;
+        u32 tmp = *plen;
+
+        wep = DISABLE;
+        wpa = ENABLE;
+
+        if(sec_mode == SEC_MODE_WPA_PSK)
+            wpa_val = WPA_IN_CONF_FILE;
+
+        else if(sec_mode == SEC_MODE_WPA2_PSK) {
+            wpa_val = WPA2_IN_CONF_FILE;
+            rsn_status = ENABLE;
+        }
+
+        else if(sec_mode == SEC_MODE_WPA_WPA2_PSK) {
+            wpa_val = WPA_WPA2_IN_CONF_FILE;
+            rsn_status = ENABLE;
+        }
+
+        qsap_scnprintf(sec, sizeof(sec), "%u", wpa_val);
+        qsap_write_cfg(pfile, &qsap_str[STR_WPA], sec, presp, plen, HOSTAPD_CONF_QCOM_FILE);
+        *plen = tmp;
+    }
+
+    /** The configuration parameters for the security to be set are enabled
+      * and the configuration parameters for the other security types are
+      * disabled in the configuration file
+      */
+    toggle[num].pcmd = &cmd_list[eCMD_DEFAULT_KEY]; toggle[num++].status = wep;
+    toggle[num].pcmd = &cmd_list[eCMD_WEP_KEY0];    toggle[num++].status = wep;
+    toggle[num].pcmd = &cmd_list[eCMD_WEP_KEY1];    toggle[num++].status = wep;
+    toggle[num].pcmd = &cmd_list[eCMD_WEP_KEY2];    toggle[num++].status = wep;
+    toggle[num].pcmd = &cmd_list[eCMD_WEP_KEY3];    toggle[num++].status = wep;
+    toggle[num].pcmd = &cmd_list[eCMD_PASSPHRASE];  toggle[num++].status = wpa;
+
+    if((sec_mode != SEC_MODE_NONE) && (sec_mode != SEC_MODE_WEP)) {
+        u32 state = !rsn_status;
+
+        if(sec_mode == SEC_MODE_WPA_WPA2_PSK) state = ENABLE;
+
+        toggle[num].pcmd = &cmd_list[eCMD_WPA_PAIRWISE]; toggle[num++].status = state;
+    }
+
+    toggle[num].pcmd = &cmd_list[eCMD_RSN_PAIRWISE]; toggle[num++].status = rsn_status;
+    toggle[num].pcmd = &qsap_str[STR_WPA];           toggle[num++].status = wpa;
+
+    if(eERR_UNKNOWN == qsap_change_cfg_list(pfile, toggle, num)) {
+        ALOGE("%s: unable to update the security parameters\n", __func__);
+        goto end;
+    }
+
+    ret = eSUCCESS;
+
+end:
+    *plen = qsap_scnprintf(presp, *plen, "%s", (ret == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
+
+    return ret;
+}
+
+/**
+ * @brief
+ *         Get the file path having the allow or deny MAC address list
+ * @param pcfgfile [IN] configuration file name
+ * @param pcmd [IN] pcmd pointer to the command string
+ * @param pfile [OUT] buffer to store the return value, containing the file name
+ *                   or the error message.
+ * @param plen [IN-OUT] size of the buffer 'pfile', is provided as input and
+ *                      the length of the file name is returned as output
+ * @return
+ *           On success, a pointer to the file name in the buffer 'pfile'.
+ *           On failure, NULL is returned
+*/
+static s8 *qsap_get_allow_deny_file_name(s8 *pcfgfile, struct Command * pcmd, s8 *pfile, u32 *plen)
+{
+    if(eSUCCESS == qsap_read_cfg(pcfgfile, pcmd, pfile, plen, NULL, GET_ENABLED_ONLY)) {
+        return strchr(pfile, '=') + 1;
+    }
+
+    return NULL;
+}
+
+int qsap_hostd_exec(int argc, char ** argv)  {
+
+    char *pCmdBuf, *pResp;
+    u32 len = 0, rlen;
+    int i, ret;
+
+    if ( argc < 4 ) {
+        ALOGD("failure: invalid arguments");
+        return -1;
+    }
+
+    /** Each argument is preceded by a blank space */
+    for (i = 2; i < argc; i++)
+        len += strlen(argv[i]) + 1;
+
+    if (NULL == (pCmdBuf = malloc(len + 1))) {
+        ALOGE("%s: out of memory\n", __func__);
+        return -1;
+    }
+
+    len = 0;
+    for (i = 2; i < argc; i++) {
+        ret = sprintf(pCmdBuf + len, " %s", argv[i]);
+        ALOGD("argv[%d] (%s)",i, argv[i]);
+        len += ret;
+    }
+    pCmdBuf[len] = '\0';
+
+    ALOGD("QCCMD data (%s)", pCmdBuf);
+    if (eSUCCESS == qsap_hostd_exec_cmd_alloc(pCmdBuf, &pResp, &rlen))
+        free(pResp);
+
+    free(pCmdBuf);
+    return 0;
+}
+/** Function to identify a valid MAC address */
+static int isValid_MAC_address(char *pMac)
+{
+    int i, len;
+
+    len = strlen(pMac);
+
+    if(len < MAC_ADDR_LEN)
+        return FALSE;
+
+    for(i=0; i<MAC_ADDR_LEN; i++) {
+        switch(i) {
+            case 2: case 5: case 8: case 11: case 14:
+                if(pMac[i] != ':')
+                    return FALSE;
+                break;
+            default:
+                if(isxdigit(pMac[i]) == 0)
+                    return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief
+ *        Add a given MAC address to the allow or deny MAC list file.
+ *        A maximum of 15 MAC addresses are allowed in the list. If the input
+ *        MAC addresses are more than the allowed number, then the allowed number
+ *        of MAC addresses are updated to the MAC list file and the remaining
+ *        MAC addresses are discarded
+ *
+ * @param pfile [IN] Path of the allow or deny MAC list file
+ * @param pVal [IN] A string containing one or more MAC addresses. Multiple
+ *                  MAC addresses are separated by a SPACE separator
+ *                  Ex. "11:22:33:44:55:66 77:88:99:00:88:00"
+ * @param presp [OUT] buffer to store the response
+ * @param plen [IN-OUT] The length of the buffer 'presp' is provided as input.
+ *                      The length of the response, stored in buffer 'presp' is
+ *                      provided as output.
+ * @return On success, eSUCCESS
+ *         eERR_FILE_OPEN if the file can not be opened,
+ *         eERR_UNKNOWN if the list is full
+*/
+static s32 qsap_add_mac_to_file(s8 *pfile, s8 *pVal, s8 *presp, u32 *plen)
+{
+    struct qsap_file_update upd;
+    s32 len;
+    s16 num_macs = 0;
+    s8 buf[32];
+    s8 macbuf[32];
+    FILE *fp, *fcur;
+
+    /** The MAC list file is created if it does not exist */
+    fp = qsap_file_update_open(&upd, pfile);
+    if(NULL == fp) {
+        ALOGE("%s : unable to open the file \n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
+
+    /** Copy and count the MAC address in the MAC list file */
+    if(NULL != (fcur = fopen(pfile, "r"))) {
+        while(NULL != (fgets(buf, 32, fcur))) {
+            fputs(buf, fp);
+            num_macs++;
+        }
+        fclose(fcur);
+    }
+
+    /** Evaluate the allowed limit */
+    if(num_macs >= MAX_ALLOWED_MAC) {
+        ALOGE("%s : File is full\n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+        qsap_file_update_abort(&upd);
+        return eERR_UNKNOWN;
+    }
+
+    /** Update all the input MAC addresses into the MAC list file */
+    len = strlen(pVal);
+    while(len > 0) {
+        int i = 0;
+
+        /** Get a MAC address from the input string */
+        while((*pVal != ' ' ) && (*pVal != '\0')) {
+            macbuf[i] = *pVal;
+            i++;
+            pVal++;
+
+            if(i == MAC_ADDR_LEN)
+                break;
+        }
+        macbuf[i] = '\0';
+        pVal++;
+
+        /** Is valid MAC address input ? */
+        if(TRUE == isValid_MAC_address(macbuf)) {
+
+            /** Append the MAC address to the file */
+            fprintf(fp, "%s\n", macbuf);
+            num_macs++;
+
+            /** Evaluate with the allowed limit */
+            if(num_macs == MAX_ALLOWED_MAC) {
+                ALOGE("MAC file is full now.... \n");
+                break;
+            }
+
+        }
+        len -= strlen(macbuf);
+        if(*pVal != '\0')
+            len--;
+    }
+
+    if(eSUCCESS != qsap_file_update_commit(&upd, pfile)) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
+
+    *plen = qsap_scnprintf(presp, *plen, "%s", SUCCESS);
+
+    return eSUCCESS;
+}
+
+/**
+ * @brief
+ *         Remove one or more MAC addresses from the allow or deny MAC list file.
+ * @param pfile [IN] path of the allow or deny list file.
+ * @param pVal [IN] a list of MAC addresses to be removed from the MAC list file.
+ * @param presp [OUT] the buffer to store the response
+ * @param plen [IN-OUT] The length of the 'presp' buffer is provided as input.
+ *                      The lenght of the response, stored in 'presp', is
+ *                      provided as output
+ * @return On success, eSUCCESS
+ *         eERR_FILE_OPEN if the file can not be opened,
+ *         eERR_FEATURE_NOT_ENABLED if the MAC address is not in the list
+*/
+static s32 qsap_remove_from_file(s8 *pfile, s8 *pVal, s8 *presp, u32 *plen)
+{
+    struct qsap_file_update upd;
+    FILE *fp;
+    FILE *ftmp;
+    s8 buf[MAX_CONF_LINE_LEN];
+    int status;
+
+    /** Open the allow or deny MAC list file */
+    fp = fopen(pfile, "r");
+
+    if(NULL == fp) {
+        ALOGE("%s : unable to open the file \n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
+
+    /** Open a temporary file */
+    ftmp = qsap_file_update_open(&upd, pfile);
+
+    if(ftmp == NULL) {
+        ALOGE("%s : unable to open the file \n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        fclose(fp);
+        return eERR_FILE_OPEN;
+    }
+
+    /** Read all the MAC addresses from the file */
+    while(NULL != fgets(buf, MAX_CONF_LINE_LEN, fp)) {
+        s8 *plist;
+        s32 slen;
+        int write_back = 1;
+
+        plist = pVal;
+        slen = strlen(pVal);
+
+        /** Compare each MAC address in the file with all the
+          * input MAC addresses */
+        write_back = 1;
+        while(slen > 0) {
+
+            if(0 == strncmp(buf, plist, MAC_ADDR_LEN)) {
+                write_back = 0;
+                break;
+            }
+
+            while((*plist != ' ') && (*plist != '\0')) {
+                plist++;
+                slen--;
+            }
+
+            while(((*plist == ' ') || (*plist == '\t')) && (*plist != '\0')) {
+                plist++; slen--;
+            }
+        }
+
+        /** Update the file */
+        if(write_back) {
+            fprintf(ftmp, "%s", buf);
+        }
+    }
+
+    fclose(fp);
+
+    /** Restore the configuration file */
+    status = qsap_file_update_commit(&upd, pfile);
+
+    qsap_scnprintf(presp, *plen, "%s", (status == eERR_UNKNOWN) ? ERR_FEATURE_NOT_ENABLED : SUCCESS);
+
+    return (status == eERR_UNKNOWN) ? eERR_FEATURE_NOT_ENABLED : eSUCCESS;
+}
+
+/**
+ * @brief
+ *         Identify the MAC list file and the type of updation on the file.
+ *         The MAC list file can be : Allow file or Deny file.
+ *         The type of operation is : Add to file or Delete from file
+ *
+ * @param file [IN] path of the allow or deny MAC list file.
+ * @param cNum [IN] command number to 'type of file' and the 'type of updation'
+ *                  to be done.
+ * @param pVal [IN] A list of one or more MAC addresses. Multiple MAC addresses
+ *                  are separated by a SPACE character
+ * @param presp [OUT] Buffer to store the command response
+ * @param plen [IN-OUT] The length of the 'presp' buffer is provided as input
+ *                      The length of the response, stored in the 'presp' is provided
+ *                      as the output
+ * @return On success, eSUCCESS
+ *         or the error code of the failed update
+*/
+static s32 qsap_update_mac_list(s8 *pfile, esap_cmd_t cNum, s8 *pVal, s8 *presp, u32 *plen)
+{
+    ALOGD("%s : Updating file %s \n", __func__, pfile);
+
+    switch(cNum) {
+        case eCMD_ADD_TO_ALLOW:
+        case eCMD_ADD_TO_DENY:
+                return qsap_add_mac_to_file(pfile, pVal, presp, plen);
+
+        case eCMD_REMOVE_FROM_ALLOW:
+        case eCMD_REMOVE_FROM_DENY:
+                return qsap_remove_from_file(pfile, pVal, presp, plen);
+
+        default:
+                *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+                return eERR_UNKNOWN;
+    }
+}
+
+/**
+ * @brief
+ * @param fconfig [INPUT] configuration file name
+ * @param cNum [INPUT] command number. The valid command numbers supported by
+ *                     this function are :
+ *                     eCMD_ALLOW_LIST - Get the MAC address list from the allow list
+ *                     eCMD_DENY_LIST - Get the MAC address list from the deny list
+ * @param pr [OUTPUT] response. The command output format :
+ *                    On success,
+ *                            success <cmd>=<value>
+ *                    On failure,
+ *                            failure <error message>
+ * @return void
+**/
+static void qsap_get_mac_list(s8 *fconfile, esap_cmd_t cNum, struct qsap_resp *pr)
+{
+    s8 buf[MAX_CONF_LINE_LEN];
+    FILE *fp;
+    u32 len_remain;
+    s8 *pfile;
+    esap_str_t sNum;
+    int cnt = 0;
+
+    /** Identify the allow or deny file */
+    if(eCMD_ALLOW_LIST == cNum) {
+        sNum = STR_ACCEPT_MAC_FILE;
+    }
+    else if(eCMD_DENY_LIST == cNum) {
+        sNum = STR_DENY_MAC_FILE;
+    }
+    else {
+        qsap_resp_printf(pr, "%s", ERR_UNKNOWN);
+        return;
+    }
+
+    /** Get the MAC allow or MAC deny file path */
+    len_remain = MAX_CONF_LINE_LEN;
+    if(NULL == (pfile = qsap_get_allow_deny_file_name(fconfile, &qsap_str[sNum], buf, &len_remain))) {
+        ALOGE("%s:Unknown error\n", __func__);
+        qsap_resp_printf(pr, "%s", ERR_RES_UNAVAILABLE);
+        return;
+    }
+
+    /** Open allow / deny file, and read the MAC addresses */
+    fp = fopen(pfile, "r");
+    if(NULL == fp) {
+        ALOGE("%s: file open error\n",__func__);
+        qsap_resp_printf(pr, "%s", ERR_RES_UNAVAILABLE);
+        return;
+    }
+
+    qsap_resp_printf(pr, "%s %s=", SUCCESS, cmd_list[cNum].name);
+
+    /** Read the MAC address from the MAC allow or deny file. Each address
+      * is added as a whole, separated by a blank space, a fixed buffer keeps
+      * the addresses that fit.
+      */
+    while(NULL != (fgets(buf, MAX_CONF_LINE_LEN, fp))) {
+        /** Avoid the commented lines */
+        if(buf[0] == '#')
+            continue;
+
+        if(FALSE == isValid_MAC_address(buf))
+            continue;
+
+        buf[strlen(buf)-1] = '\0';
+
+        if(eSUCCESS != qsap_resp_printf(pr, "%s%s", cnt ? " " : "", buf))
+            break;
+
+        if (++cnt >= MAX_ALLOWED_MAC) {
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return;
+}
+
+static int qsap_read_mac_address(struct qsap_ctx *pctx, s8 *presp, u32 *plen)
+{
+    char *ptr;
+    char  mac[MAC_ADDR_LEN];
+    u32   len, i;
+    int   nRet = eERR_INVALID_MAC_ADDR;
+
+    len = *plen;
+
+    if(eSUCCESS != qsap_read_cfg(qsap_ctx_ini(pctx), &qsap_str[STR_MAC_IN_INI], presp, plen, cmd_list[eCMD_MAC_ADDR].name, GET_ENABLED_ONLY)) {
+        ALOGE("%s :MAC addr read failure \n",__func__);
+        goto end;
+    }
+
+    ptr = strchr(presp, '=');
+    if(NULL == ptr)
+        goto end;
+
+    strlcpy(mac, ptr+1, MAC_ADDR_LEN);
+    *plen = qsap_scnprintf(presp, len, "%s %s=", SUCCESS, cmd_list[eCMD_MAC_ADDR].name);
+    ptr = presp + strlen(presp);
+    len -= strlen(presp); /* decrease the total available buf length */
+
+    for(i=0; i<MAC_ADDR_LEN-5; i+=2) {
+        u32 tlen;
+
+        tlen = qsap_scnprintf(ptr, len, "%c%c:", mac[i], mac[i+1]);
+        *plen += tlen;
+        ptr += tlen;
+        len -= tlen; /* decrease the available len of ptr */
+    }
+    presp[*plen-1] = '\0';
+    (*plen)--;
+
+    ptr = strchr(presp, '=');
+    if(NULL == ptr)
+        goto end;
+
+    ptr++;
+
+    ALOGD("MAC :%s \n", ptr);
+    if(TRUE == isValid_MAC_address(ptr)) {
+        nRet = eSUCCESS;
+    }
+    else {
+        ALOGE("Invalid MAC in conf file \n");
+    }
+end:
+    return nRet;
+}
+
+s8 *qsap_get_config_value(s8 *pfile, struct Command  *pcmd, s8 *pbuf, u32 *plen)
+{
+    const s8 *val;
+    u32 vlen, size = *plen;
+    s8 *pret;
+    u8 mode = QSAP_LOCK_READ;
+
+    do {
+        pret = NULL;
+        qsap_lock(mode);
+        if(eSUCCESS == qsap_cfg_get_value(pfile, pcmd, GET_ENABLED_ONLY, &val, &vlen)) {
+            /** Copy only the value into the buffer */
+            *plen = qsap_scnprintf(pbuf, size, "%.*s", (int)vlen, val);
+            pret = pbuf;
+        }
+    } while(qsap_unlock(&mode));
+
+    return pret;
+}
+
+static void qsap_read_wps_state(struct qsap_ctx *pctx, s8 *presp, u32 *plen)
+{
+    u32  tlen = *plen;
+    s32  status;
+    s8 *pstate;
+
+    if(NULL == (pstate = qsap_get_config_value(pctx->conf, &cmd_list[eCMD_WPS_STATE], presp, &tlen))) {
+        /** unable to read the wps configuration, WPS is disabled !*/
+        ALOGD("%s :wps_state not in cfg file \n", __func__);
+        status = DISABLE;
+    }
+    else {
+        status = (atoi(pstate) == WPS_STATE_ENABLE) ? ENABLE : DISABLE;
+    }
+
+    *plen = qsap_scnprintf(presp, *plen, "success %s=%d", cmd_list[eCMD_WPS_STATE].name, status);
+
+    return;
+}
+
+/**
+ *    Get the channel being used in the soft AP.
+ */
+int qsap_get_operating_channel(struct qsap_ctx *pctx, s32 *pchan)
+{
+    int sock;
+    struct iwreq wrq;
+    s8 interface[MAX_CONF_LINE_LEN];
+    u32 len = MAX_CONF_LINE_LEN;
+    s8 *pif;
+    int ret;
+
+    if(ENABLE != is_softap_enabled_ctx(pctx)) {
+        goto error;
+    }
+
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGE("%s :interface error \n", __func__);
+        goto error;
+    }
+
+    interface[len] = '\0';
+
+    sock = qsap_ctx_get_sock(pctx);
+    if(sock < 0) {
+        ALOGE("%s :socket error \n", __func__);
+        goto error;
+    }
+
+    *pchan = 0;
+
+    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
+    wrq.u.data.length = sizeof(s32);
+    wrq.u.data.pointer = pchan;
+    wrq.u.data.flags = 0;
+
+    ret = ioctl(sock, QCSAP_IOCTL_GET_CHANNEL, &wrq);
+    if(ret < 0) {
+        ALOGE("%s: ioctl failure \n",__func__);
+        goto error;
+    }
+
+    ALOGE("Recv len :%d \n", wrq.u.data.length);
+    *pchan = *(int *)(&wrq.u.name[0]);
+    ALOGE("Operating channel :%d \n", *pchan);
+    return eSUCCESS;
+
+error:
+    *pchan = 0;
+    ALOGE("%s: Failed to read channel \n", __func__);
+    return eERR_CHAN_READ;
+}
+
+/**
+ *    Get the sap auto channel selection for soft AP.
+ */
+int qsap_get_sap_auto_channel_selection(struct qsap_ctx *pctx, s32 *pautochan)
+{
+    int sock;
+    struct iwreq wrq;
+    s8 interface[MAX_CONF_LINE_LEN];
+    u32 len = MAX_CONF_LINE_LEN;
+    s8 *pif;
+    int ret;
+    sap_auto_channel_info sap_autochan_info;
+
+    if(ENABLE != is_softap_enabled_ctx(pctx)) {
+        ALOGE("%s :is_softap_enabled() goto error \n", __func__);
+        goto error;
+    }
+
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGD("%s :interface error \n", __func__);
+        goto error;
+    }
+
+    interface[len] = '\0';
+
+     sock = qsap_ctx_get_sock(pctx);
+    if(sock < 0) {
+        ALOGD("%s :socket error \n", __func__);
+        goto error;
+    }
+
+    *pautochan = 0;
+
+    memset(&sap_autochan_info, 0, sizeof(sap_autochan_info));
+    memset(&wrq, 0, sizeof(wrq));
+
+    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
+    wrq.u.data.length = sizeof(s32);
+    sap_autochan_info.subioctl = QCSAP_PARAM_GET_AUTO_CHANNEL;
+    wrq.u.data.pointer = pautochan;
+    memcpy(wrq.u.name, (char *)(&sap_autochan_info), sizeof(sap_autochan_info));
+    wrq.u.data.flags = 0;
+
+    ret = ioctl(sock, QCSAP_IOCTL_GETPARAM, &wrq);
+    if(ret < 0) {
+        ALOGE("%s: ioctl failure \n",__func__);
+        goto error;
+    }
+
+    ALOGD("Recv len :%d \n", wrq.u.data.length);
+    *pautochan = *(int *)(&wrq.u.name[0]);
+    ALOGD("Sap auto channel selection pautochan=%d \n", *pautochan);
+    return eSUCCESS;
+
+error:
+    *pautochan = 0;
+    ALOGE("%s: Failed to read sap auto channel selection\n", __func__);
+    return eERR_GET_AUTO_CHAN;
+}
+
+
+static int iftypeCallback(struct nl_msg* msg, void* arg)
+{
+    struct nlmsghdr* ret_hdr = nlmsg_hdr(msg);
+    struct nlattr *tb_msg[NL80211_ATTR_MAX + 1];
+    int* type = arg;
+
+    struct genlmsghdr *gnlh = (struct genlmsghdr*) nlmsg_data(ret_hdr);
+
+    nla_parse(tb_msg, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+              genlmsg_attrlen(gnlh, 0), NULL);
+
+    if (tb_msg[NL80211_ATTR_IFTYPE]) {
+        *type = nla_get_u32(tb_msg[NL80211_ATTR_IFTYPE]);
+
+    }
+    return NL_SKIP;
+}
+
+/**
+ *    Get the mode of operation of the interface of a soft AP instance.
+ */
+int qsap_get_mode_ctx(struct qsap_ctx *pctx, s32 *pmode)
+{
+    int ret = eERR_UNKNOWN;
+    struct nl_sock* sk = NULL;
+    int nl80211_id = -1;
+    int if_type = -1;
+    s8 interface[MAX_CONF_LINE_LEN];
+    u32 len = MAX_CONF_LINE_LEN;
+    s8 *pif;
+    struct nl_msg* msg = NULL;
+
+    //get interface name
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGD("%s :interface error \n", __func__);
+        goto nla_put_failure;
+    }
+
+    interface[len] = '\0';
+
+    //allocate socket
+    sk = nl_socket_alloc();
+
+    //return if socket allocation fails
+    if(sk == NULL){
+       ALOGE( "socket allocation failure");
+       return ret;
+    }
+
+    //connect to generic netlink
+    if (genl_connect(sk)) {
+        ALOGE( "Netlink socket Connection failure");
+        ret = eERR_UNKNOWN;
+        goto nla_put_failure;
+    }
+
+    //find the nl80211 driver ID
+    nl80211_id = genl_ctrl_resolve(sk, "nl80211");
+
+    //attach a callback
+    nl_socket_modify_cb(sk, NL_CB_VALID, NL_CB_CUSTOM,
+            iftypeCallback, &if_type);
+
+    //allocate a message
+    msg = nlmsg_alloc();
+
+    //return if message allocation fails
+    if(msg == NULL){
+       ALOGE( "message allocation failure");
+       goto nla_put_failure;
+    }
+
+    // setup the message
+    genlmsg_put(msg, 0, 0, nl80211_id, 0, 0, NL80211_CMD_GET_INTERFACE, 0);
+
+    //add message attributes
+    NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, if_nametoindex(pif));
+
+    // Send the message
+    ret = nl_send_auto_complete(sk, msg);
+    if (ret < 0 ) {
+        ALOGE( "nl_send_auto_complete failure");
+        ret = eERR_UNKNOWN;
+        goto nla_put_failure;
+    }
+
+    //block for message to return
+    nl_recvmsgs_default(sk);
+    *pmode = if_type;
+    ALOGI("%s: (%s) NL80211 Get Mode = %d \n",__func__, pif, (int)*pmode);
+    ret = eSUCCESS;
+
+nla_put_failure:
+    if (sk)
+        nl_socket_free(sk);
+    if (msg)
+        nlmsg_free(msg);
+    return ret;
+}
+
+/** Get the mode of operation of the default instance */
+int qsap_get_mode(s32 *pmode)
+{
+    return qsap_get_mode_ctx(DEFAULT_CTX, pmode);
+}
+
+/**
+ *    Set the channel range of an instance from the value
+ *    "<start> <end> <band>", without the leading '='.
+ */
+static int qsap_set_channel_range_val(struct qsap_ctx *pctx, const s8 *temp)
+{
+    int sock;
+    struct iwreq wrq;
+    s8 interface[MAX_CONF_LINE_LEN];
+    u32 len = MAX_CONF_LINE_LEN;
+    s8 *pif;
+    int ret;
+    sap_channel_info sap_chan_range;
+    sta_channel_info sta_chan_range;
+
+    if (NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGE("%s :interface error\n", __func__);
+        goto error;
+    }
+
+    interface[len] = '\0';
+
+    sock = qsap_ctx_get_sock(pctx);
+    if (sock < 0) {
+        ALOGE("%s :socket error\n", __func__);
+        goto error;
+    }
+
+    memset(&sap_chan_range, 0, sizeof(sap_chan_range));
+    memset(&sta_chan_range, 0, sizeof(sta_chan_range));
+    memset(&wrq, 0, sizeof(wrq));
+
+    if (ENABLE != is_softap_enabled_ctx(pctx)) {
+        strlcpy(wrq.ifr_name, "wlan0", sizeof(wrq.ifr_name));
+        sta_chan_range.subioctl = WE_SET_SAP_CHANNELS;
+        ret = sscanf(temp, "%d %d %d", &(sta_chan_range.stastartchan),
+                &(sta_chan_range.staendchan), &(sta_chan_range.staband));
+        if (3 != ret) {
+            ALOGE("%s : sscanf is not successful\n", __func__);
+            goto error;
+        }
+        memcpy(wrq.u.name, (char *)(&sta_chan_range), sizeof(sta_chan_range));
+
+        ALOGE("%s :Softap is off,Send SET_CHANNEL_RANGE over sta interface\n",
+                __func__);
+        ret = ioctl(sock, WLAN_PRIV_SET_THREE_INT_GET_NONE, &wrq);
+    } else {
+          strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
+          ret = sscanf(temp, "%d %d %d", &(sap_chan_range.startchan),
+                  &(sap_chan_range.endchan), &(sap_chan_range.band));
+          if (3 != ret) {
+              ALOGE("%s : sscanf is not successful\n", __func__);
+              goto error;
+          }
+          memcpy(wrq.u.name, (char *)(&sap_chan_range), sizeof(sap_chan_range));
+
+          ALOGE("%s :SAP is on,Send SET_CHANNEL_RANGE over softap interface\n",
+                    __func__);
+          ret = ioctl(sock, QCSAP_IOCTL_SET_CHANNEL_RANGE, &wrq);
+    }
+
+    if (ret < 0) {
+        ALOGE("%s: ioctl failure\n", __func__);
+        goto error;
+    }
+
+    ALOGE("Recv len :%d\n", wrq.u.data.length);
+
+    return eSUCCESS;
+
+error:
+    ALOGE("%s: Failed to set channel range\n", __func__);
+    return eERR_SET_CHAN_RANGE;
+}
+
+/**
+ *    Set the channel Range for the soft AP of an instance.
+ */
+int qsap_set_channel_range_ctx(struct qsap_ctx *pctx, s8 *buf)
+{
+    s8 *temp;
+
+    ALOGE("buf :%s\n", buf);
+
+    temp = strchr(buf, '=');
+    if (NULL == temp) {
+        ALOGE("%s: Failed to set channel range\n", __func__);
+        return eERR_SET_CHAN_RANGE;
+    }
+
+    return qsap_set_channel_range_val(pctx, temp + 1);
+}
+
+/** Set the channel range of the default instance */
+int qsap_set_channel_range(s8 *buf)
+{
+    return qsap_set_channel_range_ctx(DEFAULT_CTX, buf);
+}
+
+int qsap_read_channel(struct qsap_ctx *pctx, struct Command *pcmd, s8 *presp, u32 *plen, UNUSED s8 *pvar)
+{
+    s32  chan;
+    u32  len = *plen;
+
+   if(eSUCCESS == qsap_get_operating_channel(pctx, &chan)) {
+            *plen = qsap_scnprintf(presp, len, "%s %s=%lu", SUCCESS, pcmd->name, chan);
+             ALOGD("presp :%s\n", presp);
+   } else {
+          *plen = qsap_scnprintf(presp, len, "%s", ERR_UNKNOWN);
+   }
+
+    return eSUCCESS;
+}
+
+int qsap_read_auto_channel(struct qsap_ctx *pctx, UNUSED struct Command *pcmd, s8 *presp, u32 *plen)
+{
+    s32  pautochan;
+    u32  len = *plen;
+
+    ALOGE("%s :\n", __func__);
+
+    if (eSUCCESS == qsap_get_sap_auto_channel_selection(pctx, &pautochan)) {
+          *plen = qsap_scnprintf(presp, len, "%s autochannel=%lu", SUCCESS, pautochan);
+          ALOGE("presp :%s\n", presp);
+    } else {
+          *plen = qsap_scnprintf(presp, len, "%s", ERR_UNKNOWN);
+    }
+
+    return eSUCCESS;
+}
+
+static void qsap_mac_to_macstr(s8 *pmac, u32 slen, struct qsap_resp *pr)
+{
+    const s8 *psep = "";
+
+    /** Each address is added as a whole, separated by a blank space */
+    while(slen >= 6) {
+        if(eSUCCESS != qsap_resp_printf(pr, "%s%.2X:%.2X:%.2X:%.2X:%.2X:%.2X", psep, (int)pmac[0], (int)pmac[1],
+                            (int)pmac[2], (int)pmac[3], (int)pmac[4], (int)pmac[5]))
+            break;
+        psep = " ";
+        pmac += 6;
+        slen -= 6;
+    }
+
+    return;
+}
+
+#define MAX_STA_ALLOWED  8
+/** Largest max_num_sta accepted by hostapd */
+#define MAX_STA_NUM      2007
+static void qsap_get_associated_sta_mac(struct qsap_ctx *pctx, struct qsap_resp *pr)
+{
+    int sock, ret;
+    struct iwreq wrq;
+    s8 interface[MAX_CONF_LINE_LEN];
+    u32 len = MAX_CONF_LINE_LEN;
+    s8 *pif;
+    s8 *pbuf;
+    const s8 *pval;
+    u32 buflen;
+    u32 recvLen;
+    s32 maxsta = MAX_STA_ALLOWED;
+
+    if(ENABLE != is_softap_enabled_ctx(pctx)) {
+        goto error;
+    }
+
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGE("%s :interface error \n", __func__);
+        goto error;
+    }
+    interface[len] = '\0';
+
+    /** Room for as many stations as the soft AP accepts */
+    if(eSUCCESS == qsap_cfg_get_value(pctx->conf, &cmd_list[eCMD_SET_MAX_CLIENTS], GET_ENABLED_ONLY, &pval, &len)) {
+        s32 value = atoi(pval);
+
+        if((value > maxsta) && (value <= MAX_STA_NUM))
+            maxsta = value;
+    }
+
+    sock = qsap_ctx_get_sock(pctx);
+    if(sock < 0) {
+        ALOGE("%s :socket failure \n", __func__);
+        goto error;
+    }
+
+    /* response has length field + 6 bytes per STA */
+    buflen = sizeof(u32) + (maxsta * 6);
+    pbuf = (s8 *)malloc(buflen);
+    if(NULL == pbuf) {
+        ALOGE("%s :No memory \n", __func__);
+        goto error;
+    }
+
+
+#define SIZE_OF_MAC_INT   (6)
+    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
+    wrq.u.data.length = buflen;
+    wrq.u.data.pointer = (void *)pbuf;
+    wrq.u.data.flags = 0;
+
+    ret = ioctl(sock, QCSAP_IOCTL_ASSOC_STA_MACADDR, &wrq);
+    if(ret < 0) {
+        ALOGE("%s :ioctl failure \n", __func__);
+        free(pbuf);
+        goto error;
+    }
+
+    recvLen = *(u32 *)(wrq.u.data.pointer);
+    recvLen -= sizeof(u32);
+    if(recvLen > buflen - sizeof(u32))
+        recvLen = buflen - sizeof(u32);
+
+    qsap_resp_printf(pr, "%s %s=", SUCCESS, cmd_list[eCMD_ASSOC_STA_MACS].name);
+
+    qsap_mac_to_macstr(pbuf+sizeof(u32), recvLen, pr);
+
+    free(pbuf);
+
+    return;
+error:
+    qsap_resp_printf(pr, "%s", ERR_UNKNOWN);
+
+    return;
+}
+
+static void qsap_read_wep_key(s8 *pfile, struct Command *pcmd, s8 *presp, u32 *plen, s8 *var)
+{
+    s8 *pwep;
+    s8 *pkey;
+
+    if(eSUCCESS != qsap_read_cfg(pfile, pcmd, presp, plen, var, GET_COMMENTED_VALUE))
+        return;
+
+    pwep = strchr(presp, '=');
+    if(NULL == pwep)
+        return;
+    pwep++;
+
+    if(pwep[0] == '"') {
+        pkey = pwep;
+        pwep++;
+
+        while(*pwep != '\0') {
+            *pkey = *pwep;
+             pkey++;
+             pwep++;
+        }
+        pkey--;
+        *pkey = '\0';
+        *plen -= 2;
+    }
+
+    return;
+}
+
+void qsap_read_ap_stats(struct qsap_ctx *pctx, s8 *presp, u32 *plen)
+{
+    int sock, ret;
+    struct iwreq wrq;
+    s8 interface[MAX_CONF_LINE_LEN];
+    u32 len = MAX_CONF_LINE_LEN;
+    s8 *pif;
+    s8 *pbuf;
+
+    if(ENABLE != is_softap_enabled_ctx(pctx)) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_SOFTAP_NOT_STARTED);
+        return;
+    }
+
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGE("%s :interface error \n", __func__);
+        goto error;
+    }
+    interface[len] = '\0';
+
+    sock = qsap_ctx_get_sock(pctx);
+    if(sock < 0) {
+        ALOGE("%s :socket failure \n", __func__);
+        goto error;
+    }
+
+    pbuf = (s8 *)malloc(MAX_RESP_LEN);
+    if(NULL == pbuf) {
+        ALOGE("%s :No memory \n", __func__);
+        goto error;
+    }
+
+    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
+    wrq.u.data.length = MAX_RESP_LEN;
+    wrq.u.data.pointer = (void *)pbuf;
+    wrq.u.data.flags = 0;
+
+    ret = ioctl(sock, QCSAP_IOCTL_AP_STATS, &wrq);
+    if(ret < 0) {
+        ALOGE("%s :ioctl failure \n", __func__);
+        free(pbuf);
+        goto error;
+    }
+
+    *plen = qsap_scnprintf(presp, *plen, "%s %s=%s", SUCCESS, cmd_list[eCMD_AP_STATISTICS].name, pbuf);
+
+    free(pbuf);
+    return;
+
+error:
+    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+
+    return;
+}
+
+void qsap_read_autoshutoff(struct qsap_ctx *pctx, s8 *presp, u32 *plen)
+{
+    u32 tlen, time = 0;
+    s8 *ptime;
+
+    tlen = *plen;
+
+    if(NULL == (ptime = qsap_get_config_value(qsap_ctx_ini(pctx), &qsap_str[STR_AP_AUTOSHUTOFF], presp, &tlen))) {
+        /** unable to read the AP shutoff time */
+        ALOGE("%s :Failed to read AP shutoff time\n", __func__);
+    }
+    else {
+        time = atoi(ptime);
+        time = time / 60; /** Convert seconds to minutes */
+    }
+
+    *plen = qsap_scnprintf(presp, *plen, "success %s=%d", cmd_list[eCMD_AP_AUTOSHUTOFF].name, time);
+
+    return;
+}
+
+
+/** Driver ini parameters reported by qsap_get_all_config */
+static const esap_str_t ini_str_list[] = {
+    STR_MAC_IN_INI,
+    STR_PROT_FLAG_IN_INI,
+    STR_DATA_RATE_IN_INI,
+    STR_TX_POWER_IN_INI,
+    STR_FRAG_THRESHOLD_IN_INI,
+    STR_RTS_THRESHOLD_IN_INI,
+    STR_COUNTRY_CODE_IN_INI,
+    STR_INTRA_BSS_FORWARD_IN_INI,
+    STR_WMM_IN_INI,
+    STR_802DOT11D_IN_INI,
+    STR_AP_AUTOSHUTOFF,
+    STR_AP_ENERGY_DETECT_TH,
+};
+
+/**
+ * @brief
+ *        Report the MAC addresses of an allow or deny list, one per call of
+ *        the callback.
+ * @param cNum [IN] eCMD_ALLOW_LIST or eCMD_DENY_LIST, name of the reported key
+ * @param sNum [IN] STR_ACCEPT_MAC_FILE or STR_DENY_MAC_FILE
+ * @param cb [IN] callback
+ * @param ctx [IN] callback context
+**/
+static void qsap_dump_mac_list(struct qsap_ctx *pctx, esap_cmd_t cNum, esap_str_t sNum, qsap_config_cb_t cb, void *ctx)
+{
+    s8 path[MAX_FILE_PATH_LEN];
+    s8 mac[MAC_ADDR_LEN + 1];
+    struct qsap_cfg *pcfg;
+    struct qsap_cfg_line *pline;
+    const s8 *pval;
+    u32 i, vlen;
+
+    /** The list is in use only if its file is enabled in hostapd.conf */
+    if((eSUCCESS != qsap_cfg_get_value(pctx->conf, &qsap_str[sNum], GET_ENABLED_ONLY, &pval, &vlen)) ||
+       (vlen == 0) || (vlen >= sizeof(path)))
+        return;
+
+    memcpy(path, pval, vlen);
+    path[vlen] = '\0';
+
+    if(NULL == (pcfg = qsap_cfg_get(path)))
+        return;
+
+    for(i=0; i<pcfg->nlines; i++) {
+        pline = &pcfg->lines[i];
+
+        if(pline->commented || (pline->len < MAC_ADDR_LEN))
+            continue;
+
+        memcpy(mac, pline->text, MAC_ADDR_LEN);
+        mac[MAC_ADDR_LEN] = '\0';
+        if(TRUE != isValid_MAC_address(mac))
+            continue;
+
+        cb(ctx, cmd_list[cNum].name, strlen(cmd_list[cNum].name), mac, MAC_ADDR_LEN);
+    }
+
+    return;
+}
+
+/**
+ * @brief
+ *        Report the whole soft AP configuration in one pass: every enabled
+ *        parameter of hostapd.conf in file order, the driver ini parameters,
+ *        and the allow and deny lists, with one call of the callback per
+ *        MAC address. The configuration files are checked by the caller.
+ * @param pctx [IN] soft AP instance
+ * @param cb [IN] callback, called once per parameter. The key and the value
+ *                are not null terminated, and are valid only during the call
+ * @param ctx [IN] callback context
+ * @return On success, eSUCCESS
+ *         If hostapd.conf can not be read, eERR_FILE_OPEN
+**/
+static s32 qsap_dump_config(struct qsap_ctx *pctx, qsap_config_cb_t cb, void *ctx)
+{
+    struct qsap_cfg *pcfg;
+    struct qsap_cfg_line *pline;
+    const s8 *pval;
+    u32 i, vlen;
+
+    if(NULL == cb)
+        return eERR_INVALID_ARG;
+
+    qsap_cfg_pass_begin();
+
+    if(NULL == (pcfg = qsap_cfg_get(pctx->conf))) {
+        qsap_cfg_pass_end();
+        return eERR_FILE_OPEN;
+    }
+
+    for(i=0; i<pcfg->nlines; i++) {
+        pline = &pcfg->lines[i];
+        if(pline->klen && !pline->commented)
+            cb(ctx, pline->key, pline->klen, pline->val, pline->vlen);
+    }
+
+    for(i=0; i<sizeof(ini_str_list)/sizeof(ini_str_list[0]); i++) {
+        struct Command *pcmd = &qsap_str[ini_str_list[i]];
+
+        if(eSUCCESS == qsap_cfg_get_value(qsap_ctx_ini(pctx), pcmd, GET_ENABLED_ONLY, &pval, &vlen))
+            cb(ctx, pcmd->name, strlen(pcmd->name), pval, vlen);
+    }
+
+    qsap_dump_mac_list(pctx, eCMD_ALLOW_LIST, STR_ACCEPT_MAC_FILE, cb, ctx);
+    qsap_dump_mac_list(pctx, eCMD_DENY_LIST, STR_DENY_MAC_FILE, cb, ctx);
+
+    qsap_cfg_pass_end();
+
+    return eSUCCESS;
+}
+
+/** Report the whole configuration of an instance, see qsap_dump_config(). The
+  * configuration files are fixed first, holding the lock only if one must be.
+  * The callback may not be called twice for a parameter: the dump itself
+  * never asks for a retry, and runs as a reader, not holding up the updates */
+s32 qsap_get_all_config_ctx(struct qsap_ctx *pctx, qsap_config_cb_t cb, void *ctx)
+{
+    u8 mode = QSAP_LOCK_READ;
+    s32 status;
+
+    do {
+        qsap_lock(mode);
+        qsap_check_config_files(pctx);
+    } while(qsap_unlock(&mode));
+
+    qsap_lock(QSAP_LOCK_READ);
+    status = qsap_dump_config(pctx, cb, ctx);
+    qsap_unlock(NULL);
+
+    return status;
+}
+
+/** Report the whole configuration of the default instance, see qsap_dump_config() */
+s32 qsap_get_all_config(qsap_config_cb_t cb, void *ctx)
+{
+    return qsap_get_all_config_ctx(DEFAULT_CTX, cb, ctx);
+}
+
+/** Add a parameter of qsap_get_all_config to the response of the "get all" request */
+static void qsap_dump_to_resp(void *ctx, const s8 *key, u32 klen, const s8 *val, u32 vlen)
+{
+    /** Only complete lines are added to the response */
+    qsap_resp_printf(ctx, "\n%.*s=%.*s", (int)klen, key, (int)vlen, val);
+    return;
+}
+
+/**
+ * @brief
+ *       Get a list parameter, the allow list, the deny list or the
+ *       associated stations. The list is as long as the response allows.
+ * @param cNum [INPUT] command number
+ * @param pr [OUTPUT] response
+ * @return void
+**/
+static void qsap_get_list(struct qsap_ctx *pctx, esap_cmd_t cNum, struct qsap_resp *pr)
+{
+    if(cNum == eCMD_ASSOC_STA_MACS)
+        qsap_get_associated_sta_mac(pctx, pr);
+    else
+        qsap_get_mac_list(pctx->conf, cNum, pr);
+
+    return;
+}
+
+/**
+ * @brief
+ *       Get the configuration information from the softAP configuration
+ *       files
+ * @param cNum [INPUT]
+ * @param presp [OUTPUT] presp The command output format :
+ *                    On success,
+ *                            success <cmd>=<value>
+ *                    On failure,
+ *                            failure <error message>
+ * @param plen [IN-OUT] plen
+ *                      [IN] The length of the buffer, presp
+ *                      [OUT] The length of the response in the buffer, presp
+ * @return void
+**/
+static void qsap_get_from_config(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *presp, u32 *plen)
+{
+    u32 len;
+    int status;
+
+    switch(cNum) {
         case eCMD_ENABLE_SOFTAP:
-            status = is_softap_enabled();
+            status = is_softap_enabled_ctx(pctx);
             *plen = qsap_scnprintf(presp, *plen, "%s %s=%d", SUCCESS, cmd_list[cNum].name, status);
             break;
 
-        case eCMD_WPA_PAIRWISE:
-        case eCMD_RSN_PAIRWISE:
-        case eCMD_DEFAULT_KEY:
-        case eCMD_PASSPHRASE:
-        case eCMD_GTK_TIMEOUT:
-                qsap_read_cfg(pconffile, &cmd_list[cNum], presp, plen, NULL, GET_COMMENTED_VALUE);
+        case eCMD_WPA_PAIRWISE:
+        case eCMD_RSN_PAIRWISE:
+        case eCMD_DEFAULT_KEY:
+        case eCMD_PASSPHRASE:
+        case eCMD_GTK_TIMEOUT:
+                qsap_read_cfg(pctx->conf, &cmd_list[cNum], presp, plen, NULL, GET_COMMENTED_VALUE);
+            break;
+
+        case eCMD_SSID:
+        case eCMD_BSSID:
+        case eCMD_BCN_INTERVAL:
+        case eCMD_DTIM_PERIOD:
+        case eCMD_HW_MODE:
+        case eCMD_AUTH_ALGS:
+        case eCMD_MAC_ACL:
+        case eCMD_WPS_CONFIG_METHOD:
+        case eCMD_UUID:
+        case eCMD_DEVICE_NAME:
+        case eCMD_MANUFACTURER:
+        case eCMD_MODEL_NAME:
+        case eCMD_MODEL_NUMBER:
+        case eCMD_SERIAL_NUMBER:
+        case eCMD_DEVICE_TYPE:
+        case eCMD_OS_VERSION:
+        case eCMD_FRIENDLY_NAME:
+        case eCMD_MANUFACTURER_URL:
+        case eCMD_MODEL_DESC:
+        case eCMD_MODEL_URL:
+        case eCMD_UPC:
+        case eCMD_SDK_VERSION:
+        case eCMD_COUNTRY_CODE:
+                qsap_read_cfg(pctx->conf, &cmd_list[cNum], presp, plen, NULL, GET_ENABLED_ONLY);
+                break;
+
+        case eCMD_WEP_KEY0:
+        case eCMD_WEP_KEY1:
+        case eCMD_WEP_KEY2:
+        case eCMD_WEP_KEY3:
+                qsap_read_wep_key(pctx->conf, &cmd_list[cNum], presp, plen, NULL);
+                break;
+
+        case eCMD_CHAN:
+                qsap_read_channel(pctx, &cmd_list[cNum], presp, plen, NULL);
+                break;
+
+        case eCMD_FRAG_THRESHOLD:
+        case eCMD_REGULATORY_DOMAIN:
+        case eCMD_RTS_THRESHOLD:
+        case eCMD_IEEE80211H:
+                qsap_read_cfg(pctx->conf, &cmd_list[cNum], presp, plen, NULL, GET_ENABLED_ONLY);
+                break;
+
+        case eCMD_ALLOW_LIST: /* fall through */
+        case eCMD_DENY_LIST:
+        case eCMD_ASSOC_STA_MACS:
+            {
+                struct qsap_resp resp;
+
+                qsap_resp_init(&resp, presp, *plen);
+                qsap_get_list(pctx, cNum, &resp);
+                *plen = resp.len;
+            }
+                break;
+
+        case eCMD_SEC_MODE:
+                qsap_read_security_mode(pctx->conf, presp, plen);
+                break;
+
+        case eCMD_MAC_ADDR:
+                if(eSUCCESS != qsap_read_mac_address(pctx, presp, plen)) {
+                    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_NOT_SUPPORTED);
+                }
+                break;
+
+        case eCMD_WMM_STATE:
+                qsap_read_cfg(pctx->conf, &cmd_list[cNum], presp, plen, NULL, GET_ENABLED_ONLY);
+                break;
+
+        case eCMD_WPS_STATE:
+                qsap_read_wps_state(pctx, presp, plen);
+                break;
+
+        case eCMD_PROTECTION_FLAG:
+                qsap_read_cfg(qsap_ctx_ini(pctx), &qsap_str[STR_PROT_FLAG_IN_INI], presp, plen, cmd_list[eCMD_PROTECTION_FLAG].name, GET_ENABLED_ONLY);
+                break;
+
+        case eCMD_DATA_RATES:
+                qsap_read_cfg(qsap_ctx_ini(pctx), &qsap_str[STR_DATA_RATE_IN_INI], presp, plen, cmd_list[eCMD_DATA_RATES].name, GET_ENABLED_ONLY);
+                break;
+
+        case eCMD_TX_POWER:
+                qsap_read_cfg(qsap_ctx_ini(pctx), &qsap_str[STR_TX_POWER_IN_INI], presp, plen, cmd_list[eCMD_TX_POWER].name, GET_ENABLED_ONLY);
+                break;
+
+        case eCMD_INTRA_BSS_FORWARD:
+                qsap_read_cfg(pctx->conf, &cmd_list[eCMD_INTRA_BSS_FORWARD], presp, plen, NULL, GET_ENABLED_ONLY);
+                break;
+
+        case eCMD_AP_STATISTICS:
+                qsap_read_ap_stats(pctx, presp, plen);
+                break;
+
+        case eCMD_AP_AUTOSHUTOFF:
+            qsap_read_autoshutoff(pctx, presp, plen);
+            break;
+
+        case eCMD_AP_ENERGY_DETECT_TH:
+                qsap_read_cfg(qsap_ctx_ini(pctx), &qsap_str[STR_AP_ENERGY_DETECT_TH], presp, plen, cmd_list[eCMD_AP_ENERGY_DETECT_TH].name, GET_ENABLED_ONLY);
+                break;
+        case eCMD_GET_AUTO_CHANNEL:
+                qsap_read_auto_channel(pctx, &cmd_list[cNum],presp, plen);
+               break;
+        default:
+            /** Error case */
+            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_ARG);
+    }
+
+    len = *plen-1;
+
+    /** Remove the space or tabs in the end of response */
+    while(len) {
+        if((presp[len] == ' ') || (presp[len] == '\t'))
+            len--;
+        else
+            break;
+    }
+    presp[len+1] = '\0';
+    *plen = len+1;
+
+    return;
+}
+
+/** Largest space given to the value of a parameter in a response */
+#define QSAP_RESP_VALUE_MAX    (64 * 1024)
+
+/**
+ * @brief
+ *       Add the value of a parameter to the response. A value longer than the
+ *       space given to qsap_get_from_config() is clamped, so the space is
+ *       extended until the value fits. In a fixed buffer, a value which does
+ *       not fit is not added and the response is marked full.
+ * @param cNum [INPUT] command number
+ * @param pr [OUTPUT] response, in the format of qsap_get_from_config()
+ * @return void
+**/
+static void qsap_get_to_resp(struct qsap_ctx *pctx, esap_cmd_t cNum, struct qsap_resp *pr)
+{
+    struct qsap_resp tmp;
+    s8 *pout;
+    u32 want = MAX_RESP_LEN + MAX_CONF_LINE_LEN;
+    u32 avail;
+    u32 len;
+
+    if((cNum == eCMD_ALLOW_LIST) || (cNum == eCMD_DENY_LIST) || (cNum == eCMD_ASSOC_STA_MACS)) {
+        qsap_get_list(pctx, cNum, pr);
+        return;
+    }
+
+    if(pr->full)
+        return;
+
+    pout = qsap_resp_space(pr, want, &avail);
+    if(avail < 2) {
+        pr->full = TRUE;
+        return;
+    }
+
+    len = avail;
+    qsap_get_from_config(pctx, cNum, pout, &len);
+
+    /** The output is clamped to avail - 1 bytes */
+    while((len + 1 >= avail) && pr->grow && (want < QSAP_RESP_VALUE_MAX)) {
+        want *= 2;
+        pout = qsap_resp_space(pr, want, &avail);
+        if(avail < want + 1)
+            break;
+        len = avail;
+        qsap_get_from_config(pctx, cNum, pout, &len);
+    }
+
+    if(len + 1 < avail) {
+        pr->len += len;
+        return;
+    }
+
+    /** The value may not fit: read it in a growable buffer, and add it as a whole */
+    *pout = '\0';
+    if(pr->grow || (eSUCCESS != qsap_resp_init_alloc(&tmp))) {
+        pr->full = TRUE;
+        return;
+    }
+
+    qsap_get_to_resp(pctx, cNum, &tmp);
+    if(!tmp.full)
+        qsap_resp_printf(pr, "%s", tmp.buf);
+    else
+        pr->full = TRUE;
+
+    free(tmp.buf);
+
+    return;
+}
+
+/** Size of the command lookup table, a power of 2 well above eCMD_LAST */
+#define QSAP_CMD_HASH_SIZE    (256)
+
+/** Command lookup table, slots hold a command number + 1, 0 for a free slot */
+static u8 cmd_hash[QSAP_CMD_HASH_SIZE];
+static pthread_once_t cmd_hash_once = PTHREAD_ONCE_INIT;
+
+_Static_assert(eCMD_LAST < 255 && eCMD_LAST <= QSAP_CMD_HASH_SIZE / 2,
+               "esap_cmd_t outgrew cmd_hash, enlarge QSAP_CMD_HASH_SIZE and the slot type");
+
+/**
+ * @brief
+ *        Hash the command name at the start of a user command. The name
+ *        ends at the first '=' or at the end of the string.
+ * @param cName [IN] command name
+ * @param plen [OUT] length of the command name
+ * @return hash of the command name
+**/
+static u32 qsap_cmd_hash(const s8 *cName, u32 *plen)
+{
+    u32 hash = 2166136261u;
+    const s8 *p = cName;
+
+    while(*p && (*p != '=')) {
+        hash = (hash ^ (u8)*p) * 16777619u;
+        p++;
+    }
+    *plen = p - cName;
+
+    return hash;
+}
+
+/**
+ * @brief
+ *        Build the command lookup table from the cmd_list. A hole or a
+ *        duplicate name in the cmd_list is reported and left out.
+**/
+static void qsap_cmd_hash_init(void)
+{
+    u32 i, len, slot;
+
+    for(i=0; i<eCMD_LAST; i++) {
+        if(cmd_list[i].name == NULL) {
+            ALOGE("%s :No name for command %d\n", __func__, i);
+            continue;
+        }
+        slot = qsap_cmd_hash(cmd_list[i].name, &len) & (QSAP_CMD_HASH_SIZE - 1);
+        while(cmd_hash[slot]) {
+            if(!strcmp(cmd_list[cmd_hash[slot] - 1].name, cmd_list[i].name))
+                break;
+            slot = (slot + 1) & (QSAP_CMD_HASH_SIZE - 1);
+        }
+        if(cmd_hash[slot]) {
+            ALOGE("%s :Duplicate command '%s'\n", __func__, cmd_list[i].name);
+            continue;
+        }
+        cmd_hash[slot] = i + 1;
+    }
+
+    return;
+}
+
+/**
+ * @brief
+ *        Identify the command number corresponding to the input user command.
+ * @param cName [INPUT] command name
+ * @return
+ *             On success,
+ *                     command number in the range 0 to (eCMD_INVALID-1)
+ *          On failure,
+ *                  eCMD_INVALID
+**/
+static esap_cmd_t qsap_get_cmd_num(s8 *cName)
+{
+    u32 len, slot;
+    const s8 *name;
+
+    pthread_once(&cmd_hash_once, qsap_cmd_hash_init);
+
+    slot = qsap_cmd_hash(cName, &len) & (QSAP_CMD_HASH_SIZE - 1);
+
+    while(cmd_hash[slot]) {
+        name = cmd_list[cmd_hash[slot] - 1].name;
+        if(!strncmp(name, cName, len) && (name[len] == '\0'))
+            return cmd_hash[slot] - 1;
+        slot = (slot + 1) & (QSAP_CMD_HASH_SIZE - 1);
+    }
+
+    return eCMD_INVALID;
+}
+
+/**
+ * @brief
+ *            Handle the user requests of the form,
+ *                "get <cmd> [<cmd> ...]"
+ *           These commands are used to retreive the soft AP
+ *           configuration information
+ *
+ * @param pctx [IN] soft AP instance addressed by the request
+ * @param pcmd [IN] pointer to the structure, storing the command, after the
+ *                  "get" keyword and the configuration qualifier.
+ * @param pr [OUT] response. The command output format :
+ *                    On success,
+ *                            success <cmd>=<value>
+ *                    On failure,
+ *                            failure <error message>
+ *                    For more than one command, the response of each
+ *                    command is on its own line, in the request order.
+ *                    In a fixed response buffer, the parameters which do
+ *                    not fit are left out, and if none fits the response
+ *                    is ERR_RES_UNAVAILABLE.
+ *                    For "get all", "success" is followed by one line
+ *                    <key>=<value> per parameter, as many as fit in a
+ *                    fixed response buffer.
+ * @return
+ *         void
+*/
+static void qsap_handle_get_request(struct qsap_ctx *pctx, s8 *pcmd, struct qsap_resp *pr)
+{
+    esap_cmd_t cNum;
+    s8 *pkey, sep;
+    u32 mark;
+
+    if(!strncmp(pcmd, "all", 3) && ((pcmd[3] == '\0') || isblank(pcmd[3]))) {
+        qsap_resp_printf(pr, "%s", SUCCESS);
+        if(eSUCCESS != qsap_dump_config(pctx, qsap_dump_to_resp, pr)) {
+            qsap_resp_init(pr, pr->buf, pr->size);
+            qsap_resp_printf(pr, "%s", ERR_RES_UNAVAILABLE);
+        }
+        return;
+    }
+
+    /** Read all the requested parameters in one pass over the sources */
+    qsap_cfg_pass_begin();
+
+    do {
+        pkey = pcmd;
+        while(*pcmd && !isblank(*pcmd))
+            pcmd++;
+
+        sep = *pcmd;
+        *pcmd = '\0';
+        cNum = qsap_get_cmd_num(pkey);
+        *pcmd = sep;
+
+        SKIP_BLANK_SPACE(pcmd);
+
+        /** The response of each parameter is on its own line */
+        mark = pr->len;
+        if(pr->len) {
+            if(!pr->grow && (pr->len + 2 >= pr->size))
+                break;
+            if(eSUCCESS != qsap_resp_printf(pr, "\n"))
+                break;
+        }
+
+        if(cNum == eCMD_INVALID) {
+            qsap_resp_printf(pr, "%s", ERR_INVALID_PARAM);
+        }
+        else {
+            qsap_get_to_resp(pctx, cNum, pr);
+        }
+
+        /** Do not leave the separator of a parameter which did not fit */
+        if(pr->full && (pr->len == mark + 1)) {
+            pr->len = mark;
+            pr->buf[mark] = '\0';
+        }
+    } while(*pcmd && !pr->full);
+
+    qsap_cfg_pass_end();
+
+    /** Nothing fit, report the failure rather than an empty response */
+    if(pr->full && (pr->len == 0)) {
+        pr->full = FALSE;
+        qsap_resp_printf(pr, "%s", ERR_RES_UNAVAILABLE);
+    }
+
+    return;
+}
+
+static s16 is_valid_wep_key(s8 *pwep, s8 *pkey, s16 len)
+{
+    int weplen;
+    s16 ret = TRUE;
+    int ascii = FALSE;
+
+    weplen = strlen(pwep);
+
+    /** Remove the double quotes if any */
+    if((pwep[0] == '"') && (pwep[weplen-1] == '"')) {
+        pwep[weplen-1] = '\0';
+        pwep++;
+        weplen -= 2;
+    }
+
+    /** The WEP key should be of length 5, 13 or 16 characters
+      * or 10, 26, or 32 digits */
+    switch(weplen) {
+        case WEP_64_KEY_ASCII:
+        case WEP_128_KEY_ASCII:
+        case WEP_152_KEY_ASCII:
+                weplen--;
+                while(weplen--) {
+                    if(0 == isascii(pwep[weplen])) {
+                        ALOGD("%c not ascii \n", pwep[weplen]);
+                        return FALSE;
+                    }
+                }
+                ascii = TRUE;
+                break;
+
+        case WEP_64_KEY_HEX:
+        case WEP_128_KEY_HEX:
+        case WEP_152_KEY_HEX:
+                while(weplen--) {
+                    if(0 == isxdigit(pwep[weplen]))
+                        return FALSE;
+                }
+                break;
+
+        default:
+            ret = FALSE;
+    }
+
+    qsap_scnprintf(pkey, len, (ascii == TRUE) ? "\"%s\"" : "%s", pwep);
+
+    return ret;
+}
+
+/**
+ * @brief
+ *        Copy a file in the kernel, with copy_file_range() or sendfile().
+ * @param in [IN] source file, read from its current offset
+ * @param out [IN] destination file, written at its current offset
+ * @param size [IN] number of bytes to copy
+ * @return On success, eSUCCESS
+ *         On failure, eERR_UNKNOWN
+*/
+static s32 qsap_copy_file(int in, int out, off_t size)
+{
+    ssize_t n;
+    int use_sendfile = FALSE;
+
+    while(size > 0) {
+        n = -1;
+#ifdef __NR_copy_file_range
+        if(!use_sendfile) {
+            n = syscall(__NR_copy_file_range, in, NULL, out, NULL, (size_t)size, 0);
+            if((n < 0) && ((errno == ENOSYS) || (errno == EXDEV) || (errno == EINVAL) || (errno == EOPNOTSUPP)))
+                use_sendfile = TRUE;
+        }
+#else
+        use_sendfile = TRUE;
+#endif
+        if(use_sendfile)
+            n = sendfile(out, in, NULL, (size_t)size);
+
+        if((n < 0) && (errno == EINTR))
+            continue;
+        if(n < 0)
+            return eERR_UNKNOWN;
+
+        /** The file is shorter than expected */
+        if(n == 0)
+            break;
+
+        size -= n;
+    }
+
+    return eSUCCESS;
+}
+
+/** Replace a configuration file by a copy of its default file */
+static s16 qsap_reset_file(s8 *pcfgfile, s8 *pdefault)
+{
+    struct qsap_file_update upd;
+    struct stat st;
+    FILE *ftmp;
+    int fd;
+    int status = eSUCCESS;
+
+    fd = TEMP_FAILURE_RETRY(open(pdefault, O_RDONLY | O_CLOEXEC));
+
+    if((fd < 0) || (fstat(fd, &st) < 0)) {
+        ALOGE("%s : unable to open file \n", __func__);
+        if(fd >= 0)
+            close(fd);
+        return eERR_FILE_OPEN;
+    }
+
+    ftmp = qsap_file_update_open(&upd, pcfgfile);
+    if(NULL == ftmp) {
+        ALOGE("%s : unable to open file \n", __func__);
+        close(fd);
+        return eERR_FILE_OPEN;
+    }
+
+    /** Nothing is buffered in the stream, the file is copied to its descriptor */
+    if(eSUCCESS != qsap_copy_file(fd, fileno(ftmp), st.st_size))
+        status = eERR_CONF_FILE;
+
+    close(fd);
+
+    if(status != eSUCCESS) {
+        ALOGE("%s : unable to copy %s \n", __func__, pdefault);
+        qsap_file_update_abort(&upd);
+        return status;
+    }
+
+    if(eSUCCESS != qsap_file_update_commit(&upd, pcfgfile))
+        status = eERR_CONF_FILE;
+    qsap_cfg_invalidate(pcfgfile);
+
+    return status;
+}
+
+s16 wifi_qsap_reset_to_default(s8 *pcfgfile, s8 *pdefault)
+{
+    s16 status;
+
+    qsap_lock(QSAP_LOCK_WRITE);
+    status = qsap_reset_file(pcfgfile, pdefault);
+    qsap_unlock(NULL);
+
+    return status;
+}
+
+#define CTRL_IFACE_PATH_LEN   (128)
+
+/** Remove the hostapd control interface socket of a soft AP instance */
+void qsap_del_ctrl_iface_ctx(struct qsap_ctx *pctx)
+{
+    u32 len;
+    s8 dst_path[CTRL_IFACE_PATH_LEN], *pcif, *pif;
+    s8 interface[64];
+    s8 path[CTRL_IFACE_PATH_LEN + 64];
+
+    len = CTRL_IFACE_PATH_LEN;
+
+    if(NULL == (pcif = qsap_get_config_value(pctx->conf, &qsap_str[STR_CTRL_INTERFACE], dst_path, &len))) {
+        ALOGE("%s :ctrl_iface path error \n", __func__);
+        goto error;
+    }
+
+    len = 64;
+
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGE("%s :interface error \n", __func__);
+        goto error;
+    }
+
+    if ((int)sizeof(path) <= snprintf(path, sizeof(path), "%s/%s", pcif, pif)) {
+        ALOGE("Iface path : truncating error, %s \n", path);
+        goto error;
+    }
+
+    unlink(path);
+
+error:
+    return;
+}
+
+void qsap_del_ctrl_iface(void)
+{
+    qsap_del_ctrl_iface_ctx(DEFAULT_CTX);
+}
+
+/** Number of hostapd control interfaces the process keeps connected */
+#define QSAP_CTRL_CONN_MAX    (8)
+
+/** Number of idle sockets kept connected to a control interface */
+#define QSAP_CTRL_IDLE_MAX    (4)
+
+/** Length of the reply expected from hostapd */
+#define HOSTAPD_REPLY_LEN     (128)
+
+#define HOSTAPD_RECV_TIMEOUT  (2)
+
+/** Connections to the control interface of a hostapd, shared by the instances
+  * of the process using the same control interface directory and interface.
+  * Each request uses a socket of its own, so that the replies of concurrent
+  * requests can not be mixed up: hostapd replies to the socket the command
+  * came from. The sockets are bound to unique addresses in the abstract
+  * namespace, which leave no file behind, and are kept connected between
+  * requests. A slot no instance nor request uses any more is reused for
+  * another control interface.
+  */
+struct qsap_ctrl_conn {
+    struct sockaddr_un dst;
+    int    idle[QSAP_CTRL_IDLE_MAX];  /** sockets connected, not in use */
+    u32    nidle;
+    pid_t  pid;                       /** process which opened the idle sockets */
+    u32    ref;                       /** instances and requests using the slot, under ctrl_conn_lock */
+    pthread_mutex_t lock;             /** protects the idle sockets */
+};
+
+static struct qsap_ctrl_conn ctrl_conn[QSAP_CTRL_CONN_MAX];
+static u32 ctrl_conn_num;
+static pthread_mutex_t ctrl_conn_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Number of the sockets opened, to name their address */
+static u32 ctrl_sock_count;
+
+static void qsap_ctrl_conn_flush(struct qsap_ctrl_conn *pconn);
+static int qsap_ctrl_pipe_release(u32 i);
+
+/**
+ * @brief
+ *        Find the slot of a control interface, else take a free slot, else
+ *        reuse a slot no instance nor request uses, and which has no
+ *        asynchronous command pending. Called with ctrl_conn_lock held.
+ * @param pdst [IN] control interface
+ * @return the connections, NULL if all the slots are in use
+**/
+static struct qsap_ctrl_conn *qsap_ctrl_conn_slot(struct sockaddr_un *pdst)
+{
+    struct qsap_ctrl_conn *pconn;
+    u32 i;
+
+    for(i=0; i<ctrl_conn_num; i++) {
+        if(!strcmp(ctrl_conn[i].dst.sun_path, pdst->sun_path))
+            return &ctrl_conn[i];
+    }
+
+    if(ctrl_conn_num < QSAP_CTRL_CONN_MAX) {
+        pconn = &ctrl_conn[ctrl_conn_num++];
+        pthread_mutex_init(&pconn->lock, NULL);
+    }
+    else {
+        for(i=0; i<QSAP_CTRL_CONN_MAX; i++) {
+            if(!ctrl_conn[i].ref && qsap_ctrl_pipe_release(i))
+                break;
+        }
+        if(i == QSAP_CTRL_CONN_MAX)
+            return NULL;
+
+        /** The idle sockets are connected to the previous control interface */
+        pconn = &ctrl_conn[i];
+        pthread_mutex_lock(&pconn->lock);
+        qsap_ctrl_conn_flush(pconn);
+        pthread_mutex_unlock(&pconn->lock);
+    }
+
+    pconn->dst = *pdst;
+    pconn->pid = getpid();
+
+    return pconn;
+}
+
+/**
+ * @brief
+ *        Get the hostapd control interface connections of an instance. The
+ *        control interface directory and the interface are read from the
+ *        configuration on first use, or when 'reload' is set.
+ * @param pctx [IN] soft AP instance
+ * @param reload [IN] if set, the path of the control interface is read again
+ * @return the connections, to be released with qsap_ctrl_conn_put(). NULL if
+ *         the control interface path is unknown
+**/
+static struct qsap_ctrl_conn *qsap_ctrl_conn_get(struct qsap_ctx *pctx, int reload)
+{
+    struct qsap_ctrl_conn *pconn, *pold;
+    struct sockaddr_un dst;
+    s8 dst_path[CTRL_IFACE_PATH_LEN], *pcif, *pif;
+    s8 interface[64];
+    u32 len;
+
+    if(!reload) {
+        pthread_mutex_lock(&ctrl_conn_lock);
+        if(NULL != (pconn = pctx->ctrl))
+            pconn->ref++;
+        pthread_mutex_unlock(&ctrl_conn_lock);
+
+        if(pconn)
+            return pconn;
+    }
+
+    len = CTRL_IFACE_PATH_LEN;
+
+    if(NULL == (pcif = qsap_get_config_value(pctx->conf, &qsap_str[STR_CTRL_INTERFACE], dst_path, &len))) {
+        ALOGE("%s :ctrl_iface path error \n", __func__);
+        return NULL;
+    }
+
+    len = 64;
+
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, interface, &len))) {
+        ALOGE("%s :interface error \n", __func__);
+        return NULL;
+    }
+
+    memset(&dst, 0, sizeof(dst));
+    dst.sun_family = AF_UNIX;
+    if ((int)sizeof(dst.sun_path) <= snprintf(dst.sun_path, sizeof(dst.sun_path), "%s/%s", pcif, pif)) {
+        /* the sun_path is truncated. */
+        ALOGE("Iface path : truncating error, %s \n", dst.sun_path);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&ctrl_conn_lock);
+
+    if(NULL == (pconn = qsap_ctrl_conn_slot(&dst))) {
+        pthread_mutex_unlock(&ctrl_conn_lock);
+        ALOGE("%s : too many control interfaces, %s \n", __func__, dst.sun_path);
+        return NULL;
+    }
+
+    /** One reference for the caller, one for the instance */
+    pconn->ref++;
+    pold = pctx->ctrl;
+    if(pold != pconn) {
+        pconn->ref++;
+        if(pold)
+            pold->ref--;
+        pctx->ctrl = pconn;
+    }
+
+    pthread_mutex_unlock(&ctrl_conn_lock);
+
+    return pconn;
+}
+
+/** Release the connections of qsap_ctrl_conn_get() */
+static void qsap_ctrl_conn_put(struct qsap_ctrl_conn *pconn)
+{
+    pthread_mutex_lock(&ctrl_conn_lock);
+    pconn->ref--;
+    pthread_mutex_unlock(&ctrl_conn_lock);
+}
+
+/** Release the connections of an instance being destroyed */
+static void qsap_ctrl_conn_release_ctx(struct qsap_ctx *pctx)
+{
+    pthread_mutex_lock(&ctrl_conn_lock);
+    if(pctx->ctrl)
+        pctx->ctrl->ref--;
+    pctx->ctrl = NULL;
+    pthread_mutex_unlock(&ctrl_conn_lock);
+}
+
+/** Close the idle sockets, they are connected to a hostapd which is gone or
+  * belong to the parent process. Called with the connections locked */
+static void qsap_ctrl_conn_flush(struct qsap_ctrl_conn *pconn)
+{
+    while(pconn->nidle)
+        close(pconn->idle[--pconn->nidle]);
+
+    pconn->pid = getpid();
+}
+
+/**
+ * @brief
+ *        Open a socket connected to the control interface, bound to the
+ *        abstract address "<SDK_CTRL_IF>_<pid>_<n>".
+ * @return the socket, -1 on failure
+**/
+static int qsap_ctrl_sock_open(struct qsap_ctrl_conn *pconn)
+{
+    struct sockaddr_un src;
+    socklen_t len;
+    int sock;
+
+    sock = socket(PF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(sock < 0) {
+        ALOGE("%s :Socket error \n", __func__);
+        return -1;
+    }
+
+    memset(&src, 0, sizeof(src));
+    src.sun_family = AF_UNIX;
+    len = qsap_scnprintf(src.sun_path + 1, sizeof(src.sun_path) - 1, "%s_%d_%u", SDK_CTRL_IF, getpid(),
+                         __atomic_add_fetch(&ctrl_sock_count, 1, __ATOMIC_RELAXED));
+    len += offsetof(struct sockaddr_un, sun_path) + 1;
+
+    if(bind(sock, (struct sockaddr *)&src, len) < 0) {
+        ALOGE("Bind Failure\n");
+        close(sock);
+        return -1;
+    }
+
+    ALOGD("Connect to: %s,(%d)\n", pconn->dst.sun_path, sock);
+
+    if(connect(sock, (struct sockaddr *)&pconn->dst, sizeof(pconn->dst)) < 0) {
+        ALOGE("Connect Failure...\n");
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+/** Take an idle socket of the connections, or open a new one */
+static int qsap_ctrl_sock_get(struct qsap_ctrl_conn *pconn)
+{
+    int sock = -1;
+
+    pthread_mutex_lock(&pconn->lock);
+    if(pconn->pid != getpid())
+        qsap_ctrl_conn_flush(pconn);
+    if(pconn->nidle)
+        sock = pconn->idle[--pconn->nidle];
+    pthread_mutex_unlock(&pconn->lock);
+
+    if(sock < 0)
+        sock = qsap_ctrl_sock_open(pconn);
+
+    return sock;
+}
+
+/** Keep a socket for the next requests, once its request is complete */
+static void qsap_ctrl_sock_put(struct qsap_ctrl_conn *pconn, int sock)
+{
+    pthread_mutex_lock(&pconn->lock);
+    if((pconn->pid == getpid()) && (pconn->nidle < QSAP_CTRL_IDLE_MAX)) {
+        pconn->idle[pconn->nidle++] = sock;
+        sock = -1;
+    }
+    pthread_mutex_unlock(&pconn->lock);
+
+    if(sock >= 0)
+        close(sock);
+}
+
+/**
+ * @brief
+ *        Send a command to hostapd and wait for its reply, on a socket of the
+ *        caller. The socket is connected again if hostapd closed its end, i.e.
+ *        it restarted since the socket was connected.
+ * @param pconn [IN] connections
+ * @param pcmd [IN] command
+ * @return eSUCCESS if hostapd accepted the command
+ *         eERR_SEND_TO_HOSTAPD if hostapd can not be reached
+ *         eERR_UNKNOWN if the command failed, or hostapd did not reply
+**/
+static int qsap_ctrl_request(struct qsap_ctrl_conn *pconn, s8 *pcmd)
+{
+    struct pollfd pfd;
+    s8 reply[HOSTAPD_REPLY_LEN];
+    u32 retry_cnt = 3;
+    int reconnect = TRUE;
+    int sock, ret;
+
+    while(1) {
+        if((sock = qsap_ctrl_sock_get(pconn)) < 0)
+            return eERR_SEND_TO_HOSTAPD;
+
+        if(send(sock, pcmd, strlen(pcmd), 0) >= 0)
+            break;
+
+        close(sock);
+
+        if(!reconnect || ((errno != ECONNREFUSED) && (errno != ENOTCONN) && (errno != ENOENT))) {
+            ALOGE("Unable to send cmd to hostapd \n");
+            return eERR_SEND_TO_HOSTAPD;
+        }
+
+        /** The other idle sockets were connected to the same hostapd */
+        pthread_mutex_lock(&pconn->lock);
+        qsap_ctrl_conn_flush(pconn);
+        pthread_mutex_unlock(&pconn->lock);
+        reconnect = FALSE;
+    }
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    while(1) {
+        ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, HOSTAPD_RECV_TIMEOUT * 1000));
+        if(ret <= 0) {
+            /** A late reply would be taken for the reply of the next command */
+            ALOGE("%s: no reply from hostapd \n", __func__);
+            close(sock);
+            return eERR_UNKNOWN;
+        }
+
+        ret = recv(sock, reply, sizeof(reply) - 1, 0);
+        if(ret < 0) {
+            ALOGE("%s: recv() failed \n", __func__);
+            close(sock);
+            return eERR_UNKNOWN;
+        }
+        reply[ret] = 0;
+
+        if((ret > 0) && (reply[0] == '<')) {
+            ALOGE("Not the expected response...\n: %s", reply);
+            retry_cnt--;
+            if(retry_cnt)
+                continue;
+            break;
+        }
+
+        if(!strncmp(reply, "FAIL", 4)) {
+            ALOGE("Command failed in hostapd \n");
+            qsap_ctrl_sock_put(pconn, sock);
+            return eERR_UNKNOWN;
+        }
+        break;
+    }
+
+    qsap_ctrl_sock_put(pconn, sock);
+
+    return eSUCCESS;
+}
+
+/**
+ * @brief
+ *        Send a command to the hostapd of an instance, on the connection kept
+ *        open for its control interface.
+ * @param pctx [IN] soft AP instance
+ * @param pcmd [IN] command
+ * @return eSUCCESS if hostapd accepted the command
+**/
+static int qsap_send_cmd_to_hostapd(struct qsap_ctx *pctx, s8 *pcmd)
+{
+    struct qsap_ctrl_conn *pconn, *pnew;
+    int ret;
+
+    if(NULL == (pconn = qsap_ctrl_conn_get(pctx, FALSE)))
+        return eERR_SEND_TO_HOSTAPD;
+
+    ret = qsap_ctrl_request(pconn, pcmd);
+
+    /** hostapd may have been restarted on another control interface */
+    if((eERR_SEND_TO_HOSTAPD == ret) && (NULL != (pnew = qsap_ctrl_conn_get(pctx, TRUE)))) {
+        if(pnew != pconn)
+            ret = qsap_ctrl_request(pnew, pcmd);
+        qsap_ctrl_conn_put(pnew);
+    }
+    qsap_ctrl_conn_put(pconn);
+
+    return (eSUCCESS == ret) ? eSUCCESS : eERR_SEND_TO_HOSTAPD;
+}
+
+/** Number of the callbacks registered for the hostapd events */
+#define QSAP_EVENT_CB_MAX           (16)
+
+/** Length of an event message of hostapd */
+#define HOSTAPD_EVENT_LEN           (512)
+
+/** Seconds without a message after which hostapd is checked with a PING. An
+  * attached socket is not told when hostapd exits */
+#define QSAP_EVENT_PING_INTERVAL    (5)
+
+/** Seconds between two attempts to attach to hostapd */
+#define QSAP_EVENT_RETRY_INTERVAL   (5)
+
+/** Socket polled by the event thread */
+struct qsap_event_src {
+    void   (*recv)(struct qsap_event_src *psrc, u32 events);
+};
+
+/** Callback of qsap_event_register(), free if 'cb' is NULL */
+struct qsap_event_cb {
+    struct qsap_ctx *pctx;
+    u32    mask;
+    qsap_event_cb_t cb;
+    void   *arg;
+};
+
+/** Monitor of the events of an instance: a socket ATTACHed to its hostapd.
+  * The monitors are only used by the event thread */
+struct qsap_event_mon {
+    struct qsap_event_src src;
+    struct qsap_ctx *pctx;          /** NULL if the monitor is free */
+    int    sock;                    /** -1 if not attached */
+    time_t last;                    /** last message, or last attempt to attach */
+    u8     ping;                    /** a PING is not answered yet */
+};
+
+/** Events reported to the callbacks. A name ending with '-' is a prefix */
+static const struct qsap_event_desc {
+    const s8 *name;
+    esap_event_t type;
+    u8 sta;                         /** the first argument is a station address */
+} event_desc[] = {
+    { "AP-STA-CONNECTED",    eEVENT_STA_CONNECTED,    TRUE  },
+    { "AP-STA-DISCONNECTED", eEVENT_STA_DISCONNECTED, TRUE  },
+    { "AP-ENABLED",          eEVENT_AP_ENABLED,       FALSE },
+    { "AP-DISABLED",         eEVENT_AP_DISABLED,      FALSE },
+    { "WPS-",                eEVENT_WPS,              FALSE },
+    { "DFS-",                eEVENT_DFS,              FALSE },
+};
+
+static struct qsap_event_cb event_cb[QSAP_EVENT_CB_MAX];
+static struct qsap_event_mon event_mon[QSAP_EVENT_CB_MAX];
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_cond = PTHREAD_COND_INITIALIZER;
+
+/** Instance the event thread uses out of event_lock. The callbacks of an
+  * instance are not removed while it is in use */
+static struct qsap_ctx *event_busy;
+
+static pthread_t event_thread;
+static pid_t event_pid;             /** process of the event thread, 0 if not started */
+static int event_epfd = -1;
+static int event_wakefd = -1;       /** eventfd waking the thread up to update the monitors */
+
+static int qsap_ctrl_expire(void);
+
+static time_t qsap_event_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec;
+}
+
+/** Check if an instance has callbacks. Called with event_lock held */
+static int qsap_event_used(struct qsap_ctx *pctx)
+{
+    u32 i;
+
+    for(i=0; i<QSAP_EVENT_CB_MAX; i++) {
+        if(event_cb[i].cb && (event_cb[i].pctx == pctx))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/** Mark an instance in use by the event thread. FALSE if it has no callback
+  * anymore, it may be released then */
+static int qsap_event_hold(struct qsap_ctx *pctx)
+{
+    int used;
+
+    pthread_mutex_lock(&event_lock);
+    used = qsap_event_used(pctx);
+    if(used)
+        event_busy = pctx;
+    pthread_mutex_unlock(&event_lock);
+
+    return used;
+}
+
+/** The event thread is done with the instance of qsap_event_hold(). Called with event_lock held */
+static void qsap_event_put(void)
+{
+    event_busy = NULL;
+    pthread_cond_broadcast(&event_cond);
+}
+
+/** Wait until the event thread is done with an instance, unless it is the
+  * caller, from a callback. Called with event_lock held */
+static void qsap_event_wait(struct qsap_ctx *pctx)
+{
+    if((event_pid == getpid()) && pthread_equal(pthread_self(), event_thread))
+        return;
+
+    while(event_busy == pctx)
+        pthread_cond_wait(&event_cond, &event_lock);
+}
+
+/** Wake the event thread up to update the monitors. Called with event_lock held */
+static void qsap_event_wake(void)
+{
+    uint64_t one = 1;
+
+    if((event_wakefd >= 0) && (write(event_wakefd, &one, sizeof(one)) < 0))
+        ALOGE("%s : %s \n", __func__, strerror(errno));
+}
+
+/**
+ * @brief
+ *        Parse an event message of hostapd, "<level>NAME arguments".
+ * @param pmsg [IN-OUT] null terminated message, split after the name
+ * @param pevent [OUT] event
+ * @return TRUE if the event is reported to the callbacks
+**/
+static int qsap_event_parse(s8 *pmsg, struct qsap_event *pevent)
+{
+    const struct qsap_event_desc *pdesc = NULL;
+    s8 *pname, *pend;
+    u32 i, len, nlen;
+
+    /** The global control interface names the interface first */
+    if(!strncmp(pmsg, "IFNAME=", 7) && (NULL != (pname = strchr(pmsg, ' '))))
+        pmsg = pname + 1;
+
+    if(*pmsg != '<')
+        return FALSE;
+
+    pevent->level = strtoul(pmsg + 1, &pname, 10);
+    if(*pname++ != '>')
+        return FALSE;
+
+    pend = pname + strcspn(pname, " ");
+    len = pend - pname;
+
+    for(i=0; i<sizeof(event_desc)/sizeof(event_desc[0]); i++) {
+        nlen = strlen(event_desc[i].name);
+        if(event_desc[i].name[nlen - 1] == '-') {
+            if((len > nlen) && !strncmp(pname, event_desc[i].name, nlen))
+                break;
+        }
+        else if((len == nlen) && !strncmp(pname, event_desc[i].name, nlen)) {
+            break;
+        }
+    }
+    if(i == sizeof(event_desc)/sizeof(event_desc[0]))
+        return FALSE;
+    pdesc = &event_desc[i];
+
+    if(*pend != '\0')
+        *pend++ = '\0';
+
+    pevent->type = pdesc->type;
+    pevent->name = pname;
+    pevent->args = pend;
+    memset(pevent->mac, 0, sizeof(pevent->mac));
+
+    if(pdesc->sta && (6 != sscanf(pend, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &pevent->mac[0], &pevent->mac[1],
+                                  &pevent->mac[2], &pevent->mac[3], &pevent->mac[4], &pevent->mac[5]))) {
+        ALOGE("%s : no station address, %s %s \n", __func__, pname, pend);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/** Call the callbacks registered for an event of an instance */
+static void qsap_event_dispatch(struct qsap_ctx *pctx, const struct qsap_event *pevent)
+{
+    qsap_event_cb_t cb;
+    void *arg;
+    u32 i;
+
+    pthread_mutex_lock(&event_lock);
+
+    for(i=0; i<QSAP_EVENT_CB_MAX; i++) {
+        if((NULL == event_cb[i].cb) || (event_cb[i].pctx != pctx) ||
+           !(event_cb[i].mask & QSAP_EVENT_MASK(pevent->type)))
+            continue;
+
+        cb = event_cb[i].cb;
+        arg = event_cb[i].arg;
+        event_busy = pctx;
+
+        /** A callback may register or remove callbacks */
+        pthread_mutex_unlock(&event_lock);
+        cb(arg, pctx, pevent);
+        pthread_mutex_lock(&event_lock);
+
+        qsap_event_put();
+    }
+
+    pthread_mutex_unlock(&event_lock);
+}
+
+/** Stop monitoring the hostapd of an instance */
+static void qsap_event_detach(struct qsap_event_mon *pmon, int bye)
+{
+    if(pmon->sock < 0)
+        return;
+
+    epoll_ctl(event_epfd, EPOLL_CTL_DEL, pmon->sock, NULL);
+    if(bye)
+        send(pmon->sock, "DETACH", 6, MSG_DONTWAIT);
+    close(pmon->sock);
+    pmon->sock = -1;
+}
+
+/**
+ * @brief
+ *        Attach a socket to the hostapd of an instance, to receive its events.
+ *        The control interface is read again from the configuration, hostapd
+ *        may have been restarted on another one.
+ * @param pmon [IN-OUT] monitor, attached on success
+ * @param now [IN] current time
+ * @return void
+**/
+static void qsap_event_attach(struct qsap_event_mon *pmon, time_t now)
+{
+    struct qsap_ctrl_conn *pconn;
+    struct epoll_event ev;
+    struct pollfd pfd;
+    s8 reply[HOSTAPD_REPLY_LEN];
+    int sock, ret;
+
+    pmon->last = now;
+
+    if(!qsap_event_hold(pmon->pctx))
+        return;
+
+    /** Reading the control interface never asks for a retry, which would
+      * take a second reference */
+    qsap_lock(QSAP_LOCK_READ);
+    pconn = qsap_ctrl_conn_get(pmon->pctx, TRUE);
+    qsap_unlock(NULL);
+
+    pthread_mutex_lock(&event_lock);
+    qsap_event_put();
+    pthread_mutex_unlock(&event_lock);
+
+    if(NULL == pconn)
+        return;
+
+    if((sock = qsap_ctrl_sock_open(pconn)) < 0) {
+        qsap_ctrl_conn_put(pconn);
+        return;
+    }
+
+    if(send(sock, "ATTACH", 6, 0) < 0)
+        goto error;
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    /** Skip the events of a socket attached before */
+    do {
+        if(TEMP_FAILURE_RETRY(poll(&pfd, 1, HOSTAPD_RECV_TIMEOUT * 1000)) <= 0)
+            goto error;
+        if((ret = recv(sock, reply, sizeof(reply) - 1, 0)) < 0)
+            goto error;
+        reply[ret] = '\0';
+    } while(reply[0] == '<');
+
+    if(strncmp(reply, "OK", 2))
+        goto error;
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &pmon->src;
+    if(epoll_ctl(event_epfd, EPOLL_CTL_ADD, sock, &ev) < 0)
+        goto error;
+
+    ALOGD("%s : attached to %s \n", __func__, pconn->dst.sun_path);
+    qsap_ctrl_conn_put(pconn);
+    pmon->sock = sock;
+    pmon->ping = FALSE;
+
+    return;
+
+error:
+    ALOGE("%s : unable to attach to %s \n", __func__, pconn->dst.sun_path);
+    qsap_ctrl_conn_put(pconn);
+    close(sock);
+}
+
+/** Receive a message on an attached socket */
+static void qsap_event_recv(struct qsap_event_src *psrc, u32 events)
+{
+    struct qsap_event_mon *pmon = (struct qsap_event_mon *)psrc;
+    struct qsap_event event;
+    s8 msg[HOSTAPD_EVENT_LEN];
+    int ret;
+
+    if(pmon->sock < 0)
+        return;
+
+    ret = recv(pmon->sock, msg, sizeof(msg) - 1, MSG_DONTWAIT);
+    if(ret < 0) {
+        if(((errno == EAGAIN) || (errno == EINTR)) && !(events & (EPOLLERR | EPOLLHUP)))
+            return;
+        ALOGE("%s : connection to hostapd lost \n", __func__);
+        qsap_event_detach(pmon, FALSE);
+        return;
+    }
+    msg[ret] = '\0';
+
+    /** Any message, the PONG included, tells hostapd is alive */
+    pmon->last = qsap_event_now();
+    pmon->ping = FALSE;
+
+    if(qsap_event_parse(msg, &event))
+        qsap_event_dispatch(pmon->pctx, &event);
+}
+
+/**
+ * @brief
+ *        Update the monitors to the registered callbacks: attach to the
+ *        hostapd of the new instances, detach from the instances without
+ *        callbacks. Check the attached hostapd are alive, and attach again to
+ *        the ones lost.
+ * @return the time in ms until the next update is needed, -1 if none
+**/
+static int qsap_event_update(void)
+{
+    struct qsap_event_mon *pmon, *pfree;
+    time_t now = qsap_event_now(), next, wait = -1;
+    u32 i, j;
+
+    pthread_mutex_lock(&event_lock);
+
+    for(i=0; i<QSAP_EVENT_CB_MAX; i++) {
+        pmon = &event_mon[i];
+        if(pmon->pctx && !qsap_event_used(pmon->pctx)) {
+            qsap_event_detach(pmon, TRUE);
+            pmon->pctx = NULL;
+        }
+    }
+
+    for(i=0; i<QSAP_EVENT_CB_MAX; i++) {
+        if(NULL == event_cb[i].cb)
+            continue;
+
+        pfree = NULL;
+        for(j=0; j<QSAP_EVENT_CB_MAX; j++) {
+            pmon = &event_mon[j];
+            if(pmon->pctx == event_cb[i].pctx)
+                break;
+            if((NULL == pmon->pctx) && (NULL == pfree))
+                pfree = pmon;
+        }
+
+        if((j == QSAP_EVENT_CB_MAX) && pfree) {
+            pfree->src.recv = qsap_event_recv;
+            pfree->pctx = event_cb[i].pctx;
+            pfree->sock = -1;
+            pfree->last = now - QSAP_EVENT_RETRY_INTERVAL;
+        }
+    }
+
+    pthread_mutex_unlock(&event_lock);
+
+    for(i=0; i<QSAP_EVENT_CB_MAX; i++) {
+        pmon = &event_mon[i];
+        if(NULL == pmon->pctx)
+            continue;
+
+        if(pmon->sock < 0) {
+            if(now - pmon->last >= QSAP_EVENT_RETRY_INTERVAL)
+                qsap_event_attach(pmon, now);
+        }
+        else if(pmon->ping) {
+            if(now - pmon->last >= QSAP_EVENT_PING_INTERVAL + HOSTAPD_RECV_TIMEOUT) {
+                ALOGE("%s : no reply from hostapd \n", __func__);
+                qsap_event_detach(pmon, FALSE);
+                qsap_event_attach(pmon, now);
+            }
+        }
+        else if(now - pmon->last >= QSAP_EVENT_PING_INTERVAL) {
+            if(send(pmon->sock, "PING", 4, MSG_DONTWAIT) >= 0) {
+                pmon->ping = TRUE;
+            }
+            else {
+                /** hostapd exited, it may be running again */
+                qsap_event_detach(pmon, FALSE);
+                qsap_event_attach(pmon, now);
+            }
+        }
+
+        if(pmon->sock < 0)
+            next = pmon->last + QSAP_EVENT_RETRY_INTERVAL;
+        else
+            next = pmon->last + QSAP_EVENT_PING_INTERVAL + (pmon->ping ? HOSTAPD_RECV_TIMEOUT : 0);
+
+        next = (next > now) ? (next - now) : 0;
+        if((wait < 0) || (next < wait))
+            wait = next;
+    }
+
+    return (wait < 0) ? -1 : (int)(wait * 1000);
+}
+
+/** Event thread: receive the events of the attached sockets and call the
+  * callbacks, receive the replies of the asynchronous commands */
+static void *qsap_event_run(UNUSED void *arg)
+{
+    struct epoll_event ev[QSAP_EVENT_CB_MAX + 1];
+    struct qsap_event_src *psrc;
+    uint64_t count;
+    int i, n, timeout, expire;
+
+    while(1) {
+        timeout = qsap_event_update();
+        expire = qsap_ctrl_expire();
+        if((timeout < 0) || ((expire >= 0) && (expire < timeout)))
+            timeout = expire;
+
+        n = epoll_wait(event_epfd, ev, QSAP_EVENT_CB_MAX + 1, timeout);
+        if((n < 0) && (errno != EINTR)) {
+            ALOGE("%s : epoll_wait failed: %s \n", __func__, strerror(errno));
+            sleep(1);
+            continue;
+        }
+
+        for(i=0; i<n; i++) {
+            psrc = ev[i].data.ptr;
+            if(NULL == psrc) {
+                if(read(event_wakefd, &count, sizeof(count)) < 0)
+                    ALOGE("%s : %s \n", __func__, strerror(errno));
+                continue;
+            }
+            psrc->recv(psrc, ev[i].events);
+        }
+    }
+
+    return NULL;
+}
+
+/** Start the event thread of the process. Called with event_lock held */
+static s32 qsap_event_start(void)
+{
+    struct epoll_event ev;
+    pthread_attr_t attr;
+    u32 i;
+    int ret;
+
+    if(event_pid == getpid())
+        return eSUCCESS;
+
+    /** The thread of the parent process does not run in a child process, and
+      * its callbacks are not the child's */
+    if(event_pid) {
+        for(i=0; i<QSAP_EVENT_CB_MAX; i++) {
+            if(event_mon[i].pctx && (event_mon[i].sock >= 0))
+                close(event_mon[i].sock);
+        }
+        memset(event_mon, 0, sizeof(event_mon));
+        memset(event_cb, 0, sizeof(event_cb));
+        close(event_epfd);
+        close(event_wakefd);
+        event_busy = NULL;
+        event_pid = 0;
+    }
+
+    event_epfd = epoll_create1(EPOLL_CLOEXEC);
+    event_wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if((event_epfd < 0) || (event_wakefd < 0))
+        goto error;
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if(epoll_ctl(event_epfd, EPOLL_CTL_ADD, event_wakefd, &ev) < 0)
+        goto error;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&event_thread, &attr, qsap_event_run, NULL);
+    pthread_attr_destroy(&attr);
+    if(ret) {
+        errno = ret;
+        goto error;
+    }
+
+    event_pid = getpid();
+
+    return eSUCCESS;
+
+error:
+    ALOGE("%s : unable to start the event thread: %s \n", __func__, strerror(errno));
+    if(event_epfd >= 0)
+        close(event_epfd);
+    if(event_wakefd >= 0)
+        close(event_wakefd);
+    event_epfd = event_wakefd = -1;
+    return eERR_UNKNOWN;
+}
+
+/**
+ * @brief
+ *        Register a callback for the hostapd events of a soft AP instance.
+ *        The callback is called from the event thread of the SDK, which
+ *        attaches to hostapd and attaches again when it restarts. The events
+ *        received while hostapd is not reachable are lost.
+ * @param pctx [IN] soft AP instance
+ * @param mask [IN] events of interest, QSAP_EVENT_MASK() of esap_event_t
+ * @param cb [IN] callback
+ * @param arg [IN] first argument of the callback
+ * @param pid [OUT] identifier for qsap_event_unregister()
+ * @return On success, eSUCCESS
+ *         eERR_INVALID_ARG if an argument is invalid
+ *         eERR_UNKNOWN if too many callbacks are registered, or the event
+ *         thread can not be started
+**/
+s32 qsap_event_register_ctx(qsap_ctx_t *pctx, u32 mask, qsap_event_cb_t cb, void *arg, u32 *pid)
+{
+    s32 status;
+    u32 i;
+
+    if((NULL == pctx) || (NULL == cb) || (NULL == pid) || !(mask & QSAP_EVENT_ALL))
+        return eERR_INVALID_ARG;
+
+    pthread_mutex_lock(&event_lock);
+
+    status = qsap_event_start();
+    if(eSUCCESS == status) {
+        for(i=0; (i<QSAP_EVENT_CB_MAX) && event_cb[i].cb; i++)
+            ;
+
+        if(i < QSAP_EVENT_CB_MAX) {
+            event_cb[i].pctx = pctx;
+            event_cb[i].mask = mask;
+            event_cb[i].cb = cb;
+            event_cb[i].arg = arg;
+            *pid = i;
+            qsap_event_wake();
+        }
+        else {
+            ALOGE("%s : too many callbacks \n", __func__);
+            status = eERR_UNKNOWN;
+        }
+    }
+
+    pthread_mutex_unlock(&event_lock);
+
+    return status;
+}
+
+/** Register a callback for the events of the default instance, see qsap_event_register_ctx() */
+s32 qsap_event_register(u32 mask, qsap_event_cb_t cb, void *arg, u32 *pid)
+{
+    return qsap_event_register_ctx(DEFAULT_CTX, mask, cb, arg, pid);
+}
+
+/**
+ * @brief
+ *        Remove a callback of qsap_event_register(). The callback is not
+ *        running anymore on return, unless called from a callback.
+ * @param id [IN] identifier of the callback
+ * @return eSUCCESS, eERR_INVALID_ARG if no callback has the identifier
+**/
+s32 qsap_event_unregister(u32 id)
+{
+    struct qsap_ctx *pctx;
+
+    if(id >= QSAP_EVENT_CB_MAX)
+        return eERR_INVALID_ARG;
+
+    pthread_mutex_lock(&event_lock);
+
+    if((event_pid != getpid()) || (NULL == event_cb[id].cb)) {
+        pthread_mutex_unlock(&event_lock);
+        return eERR_INVALID_ARG;
+    }
+
+    pctx = event_cb[id].pctx;
+    memset(&event_cb[id], 0, sizeof(event_cb[id]));
+    qsap_event_wait(pctx);
+    qsap_event_wake();
+
+    pthread_mutex_unlock(&event_lock);
+
+    return eSUCCESS;
+}
+
+/** Remove the callbacks of an instance being released */
+static void qsap_event_release_ctx(struct qsap_ctx *pctx)
+{
+    u32 i;
+
+    pthread_mutex_lock(&event_lock);
+
+    if(event_pid == getpid()) {
+        for(i=0; i<QSAP_EVENT_CB_MAX; i++) {
+            if(event_cb[i].pctx == pctx)
+                memset(&event_cb[i], 0, sizeof(event_cb[i]));
+        }
+        qsap_event_wait(pctx);
+        qsap_event_wake();
+    }
+
+    pthread_mutex_unlock(&event_lock);
+}
+
+/** Number of the asynchronous commands of the process, from their submission
+  * until their completion is reported */
+#define QSAP_CTRL_CMD_MAX         (32)
+
+/** Number of the commands sent on a socket and not answered yet */
+#define QSAP_CTRL_INFLIGHT_MAX    (8)
+
+/** Length of an asynchronous command and of its reply */
+#define HOSTAPD_CMD_LEN           (256)
+#define HOSTAPD_CMD_REPLY_LEN     (512)
+
+/** Asynchronous command, free if 'token' is 0 */
+struct qsap_ctrl_cmd {
+    u32    token;
+    u8     done;                    /** the reply is available to qsap_ctrl_result() */
+    struct qsap_ctrl_cmd *next;     /** next command of the same queue */
+    qsap_ctrl_cb_t cb;
+    void   *arg;
+    u32    sent;                    /** time it was sent, in ms */
+    s32    status;
+    u32    len;
+    s8     buf[HOSTAPD_CMD_REPLY_LEN];  /** the command, then its reply */
+};
+
+/** Socket of a control interface carrying the asynchronous commands. hostapd
+  * handles the commands of a socket in order, so the replies come in the
+  * order the commands were sent. */
+struct qsap_ctrl_pipe {
+    struct qsap_event_src src;
+    struct qsap_ctrl_conn *pconn;   /** NULL if the pipe is not used yet */
+    int    sock;                    /** -1 if not connected */
+    struct qsap_ctrl_cmd *sent;     /** commands waiting for their reply, oldest first */
+    struct qsap_ctrl_cmd *queue;    /** commands not sent yet */
+    u32    nsent;
+};
+
+static struct qsap_ctrl_cmd ctrl_cmd[QSAP_CTRL_CMD_MAX];
+static struct qsap_ctrl_pipe ctrl_pipe[QSAP_CTRL_CONN_MAX];
+static pthread_mutex_t ctrl_cmd_lock = PTHREAD_MUTEX_INITIALIZER;
+static pid_t ctrl_cmd_pid;          /** process of the commands */
+static u32 ctrl_cmd_seq;            /** makes the tokens of a slot differ */
+static int ctrl_cmd_fd = -1;        /** eventfd of the commands completed without callback */
+
+static u32 qsap_ctrl_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** Add a command at the end of a queue */
+static void qsap_ctrl_cmd_append(struct qsap_ctrl_cmd **pqueue, struct qsap_ctrl_cmd *pcmd)
+{
+    while(*pqueue)
+        pqueue = &(*pqueue)->next;
+
+    pcmd->next = NULL;
+    *pqueue = pcmd;
+}
+
+/**
+ * @brief
+ *        Complete a command. A command with a callback is added to the list
+ *        of the callbacks to call once the lock is released, the others are
+ *        reported on the eventfd. Called with ctrl_cmd_lock held.
+ * @param pcmd [IN] command
+ * @param status [IN] status of the command
+ * @param preply [IN] reply of hostapd, NULL if none
+ * @param len [IN] length of the reply
+ * @param pdone [IN-OUT] list of the commands with a callback
+ * @return void
+**/
+static void qsap_ctrl_cmd_done(struct qsap_ctrl_cmd *pcmd, s32 status, s8 *preply, u32 len, struct qsap_ctrl_cmd **pdone)
+{
+    uint64_t one = 1;
+
+    pcmd->status = status;
+    pcmd->len = qsap_scnprintf(pcmd->buf, sizeof(pcmd->buf), "%.*s", (int)len, preply ? preply : "");
+    pcmd->done = TRUE;
+
+    if(pcmd->cb) {
+        qsap_ctrl_cmd_append(pdone, pcmd);
+        return;
+    }
+
+    if((ctrl_cmd_fd >= 0) && (write(ctrl_cmd_fd, &one, sizeof(one)) < 0))
+        ALOGE("%s : %s \n", __func__, strerror(errno));
+}
+
+/** Call the callbacks of the completed commands, then release them */
+static void qsap_ctrl_cmd_complete(struct qsap_ctrl_cmd *pdone)
+{
+    struct qsap_ctrl_cmd *pnext;
+
+    for(; pdone; pdone = pnext) {
+        pnext = pdone->next;
+        pdone->cb(pdone->arg, pdone->token, pdone->status, pdone->buf, pdone->len);
+
+        pthread_mutex_lock(&ctrl_cmd_lock);
+        pdone->token = 0;
+        pthread_mutex_unlock(&ctrl_cmd_lock);
+    }
+}
+
+/** Close the socket of a pipe, the commands sent on it complete with 'status'.
+  * Called with ctrl_cmd_lock held */
+static void qsap_ctrl_pipe_close(struct qsap_ctrl_pipe *ppipe, s32 status, struct qsap_ctrl_cmd **pdone)
+{
+    struct qsap_ctrl_cmd *pcmd;
+
+    if(ppipe->sock >= 0) {
+        epoll_ctl(event_epfd, EPOLL_CTL_DEL, ppipe->sock, NULL);
+        close(ppipe->sock);
+        ppipe->sock = -1;
+    }
+
+    while(NULL != (pcmd = ppipe->sent)) {
+        ppipe->sent = pcmd->next;
+        qsap_ctrl_cmd_done(pcmd, status, NULL, 0, pdone);
+    }
+    ppipe->nsent = 0;
+}
+
+/**
+ * @brief
+ *        Send the queued commands of a pipe, while less than
+ *        QSAP_CTRL_INFLIGHT_MAX wait for their reply. The socket is
+ *        connected again once if hostapd restarted. Called with
+ *        ctrl_cmd_lock held.
+ * @param ppipe [IN] pipe
+ * @param pdone [IN-OUT] list of the completed commands with a callback
+ * @return void
+**/
+static void qsap_ctrl_pipe_send(struct qsap_ctrl_pipe *ppipe, struct qsap_ctrl_cmd **pdone)
+{
+    struct qsap_ctrl_cmd *pcmd;
+    struct epoll_event ev;
+    int reconnect = TRUE;
+
+    while(ppipe->queue && (ppipe->nsent < QSAP_CTRL_INFLIGHT_MAX)) {
+        if(ppipe->sock < 0) {
+            if((ppipe->sock = qsap_ctrl_sock_open(ppipe->pconn)) < 0)
+                break;
+
+            ev.events = EPOLLIN;
+            ev.data.ptr = &ppipe->src;
+            if(epoll_ctl(event_epfd, EPOLL_CTL_ADD, ppipe->sock, &ev) < 0) {
+                ALOGE("%s : epoll_ctl failed: %s \n", __func__, strerror(errno));
+                close(ppipe->sock);
+                ppipe->sock = -1;
+                break;
+            }
+        }
+
+        pcmd = ppipe->queue;
+        if(send(ppipe->sock, pcmd->buf, strlen(pcmd->buf), MSG_DONTWAIT) < 0) {
+            /** The socket queue of hostapd is full, the next reply makes room */
+            if((errno == EAGAIN) && ppipe->nsent)
+                return;
+
+            /** The commands sent to a hostapd which exited are lost */
+            ALOGE("%s : unable to send cmd to hostapd: %s \n", __func__, strerror(errno));
+            qsap_ctrl_pipe_close(ppipe, eERR_SEND_TO_HOSTAPD, pdone);
+            if(reconnect) {
+                reconnect = FALSE;
+                continue;
+            }
             break;
+        }
 
-        case eCMD_SSID:
-        case eCMD_BSSID:
-        case eCMD_BCN_INTERVAL:
-        case eCMD_DTIM_PERIOD:
-        case eCMD_HW_MODE:
-        case eCMD_AUTH_ALGS:
-        case eCMD_MAC_ACL:
-        case eCMD_WPS_CONFIG_METHOD:
-        case eCMD_UUID:
-        case eCMD_DEVICE_NAME:
-        case eCMD_MANUFACTURER:
-        case eCMD_MODEL_NAME:
-        case eCMD_MODEL_NUMBER:
-        case eCMD_SERIAL_NUMBER:
-        case eCMD_DEVICE_TYPE:
-        case eCMD_OS_VERSION:
-        case eCMD_FRIENDLY_NAME:
-        case eCMD_MANUFACTURER_URL:
-        case eCMD_MODEL_DESC:
-        case eCMD_MODEL_URL:
-        case eCMD_UPC:
-        case eCMD_SDK_VERSION:
-        case eCMD_COUNTRY_CODE:
-                qsap_read_cfg(pconffile, &cmd_list[cNum], presp, plen, NULL, GET_ENABLED_ONLY);
+        ppipe->queue = pcmd->next;
+        pcmd->sent = qsap_ctrl_now();
+        qsap_ctrl_cmd_append(&ppipe->sent, pcmd);
+        ppipe->nsent++;
+    }
+
+    /** hostapd can not be reached */
+    if(ppipe->sock < 0) {
+        while(NULL != (pcmd = ppipe->queue)) {
+            ppipe->queue = pcmd->next;
+            qsap_ctrl_cmd_done(pcmd, eERR_SEND_TO_HOSTAPD, NULL, 0, pdone);
+        }
+    }
+}
+
+/** Receive the replies of a pipe, from the event thread */
+static void qsap_ctrl_pipe_recv(struct qsap_event_src *psrc, UNUSED u32 events)
+{
+    struct qsap_ctrl_pipe *ppipe = (struct qsap_ctrl_pipe *)psrc;
+    struct qsap_ctrl_cmd *pcmd, *pdone = NULL;
+    s8 reply[HOSTAPD_CMD_REPLY_LEN];
+    int ret;
+
+    pthread_mutex_lock(&ctrl_cmd_lock);
+
+    while(ppipe->sock >= 0) {
+        ret = recv(ppipe->sock, reply, sizeof(reply) - 1, MSG_DONTWAIT);
+        if(ret < 0) {
+            /** An error of the socket is returned by recv(), the events may
+              * be of a socket closed since */
+            if((errno == EAGAIN) || (errno == EINTR))
                 break;
+            ALOGE("%s : connection to hostapd lost \n", __func__);
+            qsap_ctrl_pipe_close(ppipe, eERR_UNKNOWN, &pdone);
+            break;
+        }
+        reply[ret] = '\0';
+
+        if((reply[0] == '<') || (NULL == (pcmd = ppipe->sent)))
+            continue;
+
+        ppipe->sent = pcmd->next;
+        ppipe->nsent--;
+        qsap_ctrl_cmd_done(pcmd, strncmp(reply, "FAIL", 4) ? eSUCCESS : eERR_UNKNOWN, reply, ret, &pdone);
+    }
+
+    qsap_ctrl_pipe_send(ppipe, &pdone);
+
+    pthread_mutex_unlock(&ctrl_cmd_lock);
+
+    qsap_ctrl_cmd_complete(pdone);
+}
+
+/**
+ * @brief
+ *        Fail the commands not answered in time, from the event thread. The
+ *        socket is closed: a late reply would be taken for the reply of the
+ *        next command.
+ * @return the time in ms until the next command expires, -1 if none
+**/
+static int qsap_ctrl_expire(void)
+{
+    struct qsap_ctrl_pipe *ppipe;
+    struct qsap_ctrl_cmd *pdone = NULL;
+    u32 now = qsap_ctrl_now(), elapsed, i;
+    int wait = -1;
+
+    pthread_mutex_lock(&ctrl_cmd_lock);
+
+    for(i=0; i<QSAP_CTRL_CONN_MAX; i++) {
+        ppipe = &ctrl_pipe[i];
+        if((NULL == ppipe->pconn) || (NULL == ppipe->sent))
+            continue;
+
+        elapsed = now - ppipe->sent->sent;
+        if(elapsed >= HOSTAPD_RECV_TIMEOUT * 1000) {
+            ALOGE("%s: no reply from hostapd \n", __func__);
+            qsap_ctrl_pipe_close(ppipe, eERR_UNKNOWN, &pdone);
+            qsap_ctrl_pipe_send(ppipe, &pdone);
+            if(NULL == ppipe->sent)
+                continue;
+            elapsed = 0;
+        }
+
+        if((wait < 0) || (HOSTAPD_RECV_TIMEOUT * 1000 - elapsed < (u32)wait))
+            wait = HOSTAPD_RECV_TIMEOUT * 1000 - elapsed;
+    }
+
+    pthread_mutex_unlock(&ctrl_cmd_lock);
+
+    qsap_ctrl_cmd_complete(pdone);
+
+    return wait;
+}
+
+/** Drop the commands of the parent process. Called with ctrl_cmd_lock held */
+static void qsap_ctrl_cmd_reset(void)
+{
+    u32 i;
+
+    if(ctrl_cmd_pid) {
+        for(i=0; i<QSAP_CTRL_CONN_MAX; i++) {
+            if(ctrl_pipe[i].pconn && (ctrl_pipe[i].sock >= 0))
+                close(ctrl_pipe[i].sock);
+        }
+        memset(ctrl_pipe, 0, sizeof(ctrl_pipe));
+        memset(ctrl_cmd, 0, sizeof(ctrl_cmd));
+        if(ctrl_cmd_fd >= 0)
+            close(ctrl_cmd_fd);
+        ctrl_cmd_fd = -1;
+    }
 
-        case eCMD_WEP_KEY0:
-        case eCMD_WEP_KEY1:
-        case eCMD_WEP_KEY2:
-        case eCMD_WEP_KEY3:
-                qsap_read_wep_key(pconffile, &cmd_list[cNum], presp, plen, NULL);
-                break;
+    if(ctrl_cmd_fd < 0)
+        ctrl_cmd_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
 
-        case eCMD_CHAN:
-                qsap_read_channel(pconffile, &cmd_list[cNum], presp, plen, NULL);
-                break;
+    ctrl_cmd_pid = getpid();
+}
 
-        case eCMD_FRAG_THRESHOLD:
-        case eCMD_REGULATORY_DOMAIN:
-        case eCMD_RTS_THRESHOLD:
-        case eCMD_IEEE80211H:
-                qsap_read_cfg(pconffile, &cmd_list[cNum], presp, plen, NULL, GET_ENABLED_ONLY);
-                break;
+/**
+ * @brief
+ *        Close the pipe of a connection slot about to be reused for another
+ *        control interface. Called with ctrl_conn_lock held.
+ * @param i [IN] slot
+ * @return TRUE if the pipe is closed, FALSE if it has commands pending
+**/
+static int qsap_ctrl_pipe_release(u32 i)
+{
+    struct qsap_ctrl_pipe *ppipe = &ctrl_pipe[i];
+    int ret = TRUE;
 
-        case eCMD_ALLOW_LIST: /* fall through */
-        case eCMD_DENY_LIST:
-                qsap_get_mac_list(pconffile, cNum, presp, plen);
-                break;
+    pthread_mutex_lock(&ctrl_cmd_lock);
 
-        case eCMD_SEC_MODE:
-                qsap_read_security_mode(pconffile, presp, plen);
-                break;
+    /** The pipes of the parent process are dropped by qsap_ctrl_cmd_reset() */
+    if((ctrl_cmd_pid == getpid()) && ppipe->pconn) {
+        if(ppipe->sent || ppipe->queue) {
+            ret = FALSE;
+        }
+        else if(ppipe->sock >= 0) {
+            epoll_ctl(event_epfd, EPOLL_CTL_DEL, ppipe->sock, NULL);
+            close(ppipe->sock);
+            ppipe->sock = -1;
+        }
+    }
 
-        case eCMD_MAC_ADDR:
-                if(eSUCCESS != qsap_read_mac_address(presp, plen)) {
-                    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_NOT_SUPPORTED);
-                }
-                break;
+    pthread_mutex_unlock(&ctrl_cmd_lock);
 
-        case eCMD_WMM_STATE:
-                qsap_read_cfg(pconffile, &cmd_list[cNum], presp, plen, NULL, GET_ENABLED_ONLY);
-                break;
+    return ret;
+}
 
-        case eCMD_WPS_STATE:
-                qsap_read_wps_state(presp, plen);
-                break;
+/**
+ * @brief
+ *        Submit a command to the hostapd of an instance without waiting for
+ *        its reply. The commands of a control interface are pipelined on one
+ *        socket, up to QSAP_CTRL_INFLIGHT_MAX wait for their reply at a time.
+ *        A command completes when its reply is received, or when hostapd
+ *        does not reply within HOSTAPD_RECV_TIMEOUT seconds.
+ * @param pctx [IN] soft AP instance
+ * @param pcmd [IN] hostapd control interface command, e.g. "DISASSOCIATE <mac>"
+ * @param cb [IN] callback called on completion from the event thread of the
+ *                SDK, or NULL to collect the completion with qsap_ctrl_result()
+ *                once qsap_ctrl_get_fd() is readable
+ * @param arg [IN] first argument of the callback
+ * @param ptoken [OUT] token of the command, passed to the callback
+ * @return On success, eSUCCESS. The callback may be called before return.
+ *         eERR_INVALID_ARG if an argument is invalid
+ *         eERR_SEND_TO_HOSTAPD if the control interface is unknown
+ *         eERR_UNKNOWN if too many commands are pending
+**/
+s32 qsap_ctrl_submit_ctx(qsap_ctx_t *pctx, const s8 *pcmd, qsap_ctrl_cb_t cb, void *arg, u32 *ptoken)
+{
+    struct qsap_ctrl_conn *pconn;
+    struct qsap_ctrl_pipe *ppipe;
+    struct qsap_ctrl_cmd *pslot = NULL, *pdone = NULL;
+    s32 status;
+    u32 i;
 
-        case eCMD_PROTECTION_FLAG:
-                qsap_read_cfg(fIni, &qsap_str[STR_PROT_FLAG_IN_INI], presp, plen, cmd_list[eCMD_PROTECTION_FLAG].name, GET_ENABLED_ONLY);
-                break;
+    if((NULL == pctx) || (NULL == pcmd) || (NULL == ptoken) || (*pcmd == '\0') || (strlen(pcmd) >= HOSTAPD_CMD_LEN))
+        return eERR_INVALID_ARG;
 
-        case eCMD_DATA_RATES:
-                qsap_read_cfg(fIni, &qsap_str[STR_DATA_RATE_IN_INI], presp, plen, cmd_list[eCMD_DATA_RATES].name, GET_ENABLED_ONLY);
-                break;
+    /** The event thread receives the replies */
+    pthread_mutex_lock(&event_lock);
+    status = qsap_event_start();
+    pthread_mutex_unlock(&event_lock);
+    if(eSUCCESS != status)
+        return status;
 
-        case eCMD_ASSOC_STA_MACS:
-                qsap_get_associated_sta_mac(presp, plen);
-                break;
+    /** Reading the control interface never asks for a retry, which would
+      * take a second reference */
+    qsap_lock(QSAP_LOCK_READ);
+    pconn = qsap_ctrl_conn_get(pctx, FALSE);
+    qsap_unlock(NULL);
 
-        case eCMD_TX_POWER:
-                qsap_read_cfg(fIni, &qsap_str[STR_TX_POWER_IN_INI], presp, plen, cmd_list[eCMD_TX_POWER].name, GET_ENABLED_ONLY);
-                break;
+    if(NULL == pconn)
+        return eERR_SEND_TO_HOSTAPD;
 
-        case eCMD_INTRA_BSS_FORWARD:
-                qsap_read_cfg(pconffile, &cmd_list[eCMD_INTRA_BSS_FORWARD], presp, plen, NULL, GET_ENABLED_ONLY);
-                break;
+    pthread_mutex_lock(&ctrl_cmd_lock);
 
-        case eCMD_AP_STATISTICS:
-                qsap_read_ap_stats(presp, plen);
-                break;
+    if(ctrl_cmd_pid != getpid())
+        qsap_ctrl_cmd_reset();
 
-        case eCMD_AP_AUTOSHUTOFF:
-            qsap_read_autoshutoff(presp, plen);
+    for(i=0; i<QSAP_CTRL_CMD_MAX; i++) {
+        if(0 == ctrl_cmd[i].token) {
+            pslot = &ctrl_cmd[i];
             break;
+        }
+    }
 
-        case eCMD_AP_ENERGY_DETECT_TH:
-                qsap_read_cfg(fIni, &qsap_str[STR_AP_ENERGY_DETECT_TH], presp, plen, cmd_list[eCMD_AP_ENERGY_DETECT_TH].name, GET_ENABLED_ONLY);
-                break;
-        case eCMD_GET_AUTO_CHANNEL:
-                qsap_read_auto_channel(&cmd_list[cNum],presp, plen);
-               break;
-        default:
-            /** Error case */
-            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_ARG);
+    if(NULL == pslot) {
+        pthread_mutex_unlock(&ctrl_cmd_lock);
+        qsap_ctrl_conn_put(pconn);
+        ALOGE("%s : too many commands pending \n", __func__);
+        return eERR_UNKNOWN;
     }
 
-    len = *plen-1;
+    /** The slot is in the low bits, a token is never 0 */
+    ctrl_cmd_seq++;
+    pslot->token = (ctrl_cmd_seq * QSAP_CTRL_CMD_MAX) + i + 1;
+    pslot->done = FALSE;
+    pslot->cb = cb;
+    pslot->arg = arg;
+    strlcpy(pslot->buf, pcmd, sizeof(pslot->buf));
+    *ptoken = pslot->token;
 
-    /** Remove the space or tabs in the end of response */
-    while(len) {
-        if((presp[len] == ' ') || (presp[len] == '\t'))
-            len--;
-        else
-            break;
+    ppipe = &ctrl_pipe[pconn - ctrl_conn];
+    if(NULL == ppipe->pconn) {
+        ppipe->src.recv = qsap_ctrl_pipe_recv;
+        ppipe->pconn = pconn;
+        ppipe->sock = -1;
     }
-    presp[len+1] = '\0';
-    *plen = len+1;
 
-    return;
+    qsap_ctrl_cmd_append(&ppipe->queue, pslot);
+    qsap_ctrl_pipe_send(ppipe, &pdone);
+
+    pthread_mutex_unlock(&ctrl_cmd_lock);
+
+    /** The slot is not reused while the pipe has commands pending */
+    qsap_ctrl_conn_put(pconn);
+
+    qsap_ctrl_cmd_complete(pdone);
+
+    /** The event thread watches the time of the reply */
+    pthread_mutex_lock(&event_lock);
+    qsap_event_wake();
+    pthread_mutex_unlock(&event_lock);
+
+    return eSUCCESS;
+}
+
+/** Submit a command to the hostapd of the default instance, see qsap_ctrl_submit_ctx() */
+s32 qsap_ctrl_submit(const s8 *pcmd, qsap_ctrl_cb_t cb, void *arg, u32 *ptoken)
+{
+    return qsap_ctrl_submit_ctx(DEFAULT_CTX, pcmd, cb, arg, ptoken);
 }
 
 /**
  * @brief
- *        Identify the command number corresponding to the input user command.
- * @param cName [INPUT] command name
- * @return
- *             On success,
- *                     command number in the range 0 to (eCMD_INVALID-1)
- *          On failure,
- *                  eCMD_INVALID
+ *        Get the result of a command submitted without callback. The token is
+ *        not valid anymore once the result is returned.
+ * @param token [IN] token of qsap_ctrl_submit()
+ * @param pstatus [OUT] eSUCCESS if hostapd accepted the command,
+ *                      eERR_UNKNOWN if it failed or hostapd did not reply,
+ *                      eERR_SEND_TO_HOSTAPD if hostapd could not be reached
+ * @param presp [OUT] buffer to store the null terminated reply, may be NULL
+ * @param plen [IN-OUT] length of the buffer, length of the reply on return
+ * @return eSUCCESS if the command completed
+ *         eERR_NOT_READY if the command did not complete yet
+ *         eERR_INVALID_ARG if no command has the token
 **/
-static esap_cmd_t qsap_get_cmd_num(s8 *cName)
+s32 qsap_ctrl_result(u32 token, s32 *pstatus, s8 *presp, u32 *plen)
 {
-    s16 i, len;
+    struct qsap_ctrl_cmd *pcmd;
+    s32 status = eSUCCESS;
 
-    for(i=0; i<eCMD_LAST; i++)     {
-        len = strlen(cmd_list[i].name);
+    if((0 == token) || (NULL == pstatus) || (presp && (NULL == plen)))
+        return eERR_INVALID_ARG;
 
-        if(!strncmp(cmd_list[i].name, cName, len)) {
-            if((cName[len] == '=') || (cName[len] == '\0'))
-                return i;
-        }
+    pcmd = &ctrl_cmd[(token - 1) % QSAP_CTRL_CMD_MAX];
+
+    pthread_mutex_lock(&ctrl_cmd_lock);
+
+    if((ctrl_cmd_pid != getpid()) || (pcmd->token != token) || pcmd->cb) {
+        status = eERR_INVALID_ARG;
     }
-    return eCMD_INVALID;
+    else if(!pcmd->done) {
+        status = eERR_NOT_READY;
+    }
+    else {
+        *pstatus = pcmd->status;
+        if(presp)
+            *plen = qsap_scnprintf(presp, *plen, "%s", pcmd->buf);
+        pcmd->token = 0;
+    }
+
+    pthread_mutex_unlock(&ctrl_cmd_lock);
+
+    return status;
 }
 
 /**
  * @brief
- *            Handle the user requests of the form,
- *                "get <cmd num> [<value1> ...]"
- *           These commands are used to retreive the soft AP
- *           configuration information
- *
- * @param pcmd [IN] pointer to the structure, storing the command.
- * @param presp [OUT] pointer to the buffer, to store the command response.
- *                         The command output format :
- *                    On success,
- *                            success <cmd>=<value>
- *                    On failure,
- *                            failure <error message>
- * @param plen [IN-OUT]
- *                 [IN] : Maximum length of the reponse buffer
- *                [OUT]: Reponse length
- * @return
- *         void
-*/
-static void qsap_handle_get_request(s8 *pcmd, s8 *presp, u32 *plen)
+ *        Get the eventfd signaled when a command submitted without callback
+ *        completes. It is created by the first submission.
+ * @return the eventfd, -1 if none
+**/
+int qsap_ctrl_get_fd(void)
 {
-    esap_cmd_t cNum;
+    int fd;
 
-    pcmd += strlen("get");
+    pthread_mutex_lock(&ctrl_cmd_lock);
+    if(ctrl_cmd_pid != getpid())
+        qsap_ctrl_cmd_reset();
+    fd = ctrl_cmd_fd;
+    pthread_mutex_unlock(&ctrl_cmd_lock);
 
-    SKIP_BLANK_SPACE(pcmd);
+    return fd;
+}
 
-    cNum = qsap_get_cmd_num(pcmd);
+static s32 qsap_update_wps_config(struct qsap_ctx *pctx, s8 *pVal, s8 *presp, u32 *plen)
+{
+    u32 tlen = *plen;
+    s32 status, ret;
+    s8  pwps_state[MAX_INT_STR+1];
+    s32 i;
+    struct qsap_cfg_toggle toggle[eCMD_UPC - eCMD_UUID + 2];
+    u32 num = 0;
 
-    if(cNum == eCMD_INVALID) {
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
-        return;
+    /* Enable/disable the following in hostapd.conf
+     * 1. Update the wps_state
+     * 2. Set eap_server=1
+     * 3. Update UPnP related variables
+     */
+    status = atoi(pVal);
+
+    qsap_scnprintf(pwps_state, sizeof(pwps_state), "%d", (status == ENABLE) ? WPS_STATE_ENABLE : WPS_STATE_DISABLE);
+
+    qsap_write_cfg(pctx->conf, &cmd_list[eCMD_WPS_STATE], pwps_state, presp, &tlen, HOSTAPD_CONF_QCOM_FILE);
+
+    qsap_scnprintf(pwps_state, sizeof(pwps_state), "%d", ENABLE);
+
+    /** update the eap_server=1 */
+    ret = qsap_write_cfg(pctx->conf, &qsap_str[STR_EAP_SERVER], pwps_state, presp, plen, HOSTAPD_CONF_QCOM_FILE);
+
+    /** Enable or disable the wps_state and the UPnP variables together */
+    toggle[num].pcmd = &cmd_list[eCMD_WPS_STATE];
+    toggle[num++].status = status;
+
+    for(i=eCMD_UUID; i<=eCMD_UPC; i++) {
+        toggle[num].pcmd = &cmd_list[i];
+        toggle[num++].status = status;
     }
 
-    qsap_get_from_config(cNum, presp, plen);
+    if(eERR_UNKNOWN == qsap_change_cfg_list(pctx->conf, toggle, num)) {
+        ALOGE("%s: failed to update the WPS parameters\n", __func__);
+        goto error;
+    }
 
-    return;
+    return ret;
+error:
+    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+
+    return eERR_UNKNOWN;
 }
 
-static s16 is_valid_wep_key(s8 *pwep, s8 *pkey, s16 len)
+static s32 qsap_config_wps_method(struct qsap_ctx *pctx, s8 *pVal, s8 *presp, u32 *plen)
 {
-    int weplen;
-    s16 ret = TRUE;
-    int ascii = FALSE;
+    s8 buf[64];
+    s8 *ptr;
+    int i;
+    s32 value;
 
-    weplen = strlen(pwep);
+    /** INPUT : <0/1> <PIN> */
+    /** PBC method : WPS_PBC */
+    /** PIN method : WPS_PIN any <key> */
+    ptr = pVal;
+    i = 0;
 
-    /** Remove the double quotes if any */
-    if((pwep[0] == '"') && (pwep[weplen-1] == '"')) {
-        pwep[weplen-1] = '\0';
-        pwep++;
-        weplen -= 2;
+    while((*ptr != '\0') && (*ptr != ' ')) {
+        buf[i] = *ptr;
+        ptr++;
+        i++;
     }
 
-    /** The WEP key should be of length 5, 13 or 16 characters
-      * or 10, 26, or 32 digits */
-    switch(weplen) {
-        case WEP_64_KEY_ASCII:
-        case WEP_128_KEY_ASCII:
-        case WEP_152_KEY_ASCII:
-                weplen--;
-                while(weplen--) {
-                    if(0 == isascii(pwep[weplen])) {
-                        ALOGD("%c not ascii \n", pwep[weplen]);
-                        return FALSE;
-                    }
-                }
-                ascii = TRUE;
+    buf[i] = '\0';
+
+    /** Identify the WPS method */
+    value = atoi(buf);
+    if(TRUE != IS_VALID_WPS_CONFIG(value)) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+        return eERR_INVALID_PARAM;
+    }
+
+    SKIP_BLANK_SPACE(ptr);
+
+    if( (value == WPS_CONFIG_PIN) && (*ptr == '\0') ){
+        ALOGE("%s :Invalid command \n", __func__);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+        return eERR_INVALID_PARAM;
+    }
+
+    if(value == WPS_CONFIG_PBC)
+        qsap_scnprintf(buf, sizeof(buf), "WPS_PBC");
+    else {
+        if(strlen(ptr) < WPS_KEY_LEN) {
+            ALOGD("%s :Invalid WPS key length\n", __func__);
+            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+            return eERR_INVALID_PARAM;
+        }
+        qsap_scnprintf(buf, sizeof(buf), "WPS_PIN any %s", ptr);
+    }
+
+    value = qsap_send_cmd_to_hostapd(pctx, buf);
+
+    *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS: ERR_UNKNOWN);
+
+    return (value == eSUCCESS) ? eSUCCESS : eERR_UNKNOWN;
+}
+
+
+s32 atoh(u8 *str)
+{
+    u32 val = 0;
+    u32 pos = 0;
+    s32 len = strlen((char *)str) - 1;
+
+    while(len >= 0) {
+        switch(str[len]) {
+
+        case '0' ... '9':
+                val += (str[len] - '0') << pos;
                 break;
 
-        case WEP_64_KEY_HEX:
-        case WEP_128_KEY_HEX:
-        case WEP_152_KEY_HEX:
-                while(weplen--) {
-                    if(0 == isxdigit(pwep[weplen]))
-                        return FALSE;
-                }
+        case 'a' ... 'f':
+                val += (str[len] - 'a' + 10) << pos;
+                break;
+
+        case 'A'... 'F':
+                val += (str[len] - 'A' + 10) << pos;
                 break;
+        }
+        len--;
+        pos += 4;
+    }
+
+    return val;
+}
+
+int qsap_get_mac_in_bytes(char *psmac, char *pbmac)
+{
+    int val;
+    u8 str[3];
+    u32 i;
 
-        default:
-            ret = FALSE;
+    str[2] = '\0';
+
+    if(FALSE == isValid_MAC_address(psmac)) {
+        return FALSE;
     }
 
-    qsap_scnprintf(pkey, len, (ascii == TRUE) ? "\"%s\"" : "%s", pwep);
+    for(i=0; i<strlen(psmac); i++) {
+        if(psmac[i] == ':')
+            continue;
 
-    return ret;
+        str[0] = psmac[i];
+        str[1] = psmac[i+1];
+        val = atoh(str);
+        *pbmac = val;
+        pbmac++;
+        i += 2;
+    }
+    *pbmac = 0;
+
+    return TRUE;
 }
 
-s16 wifi_qsap_reset_to_default(s8 *pcfgfile, s8 *pdefault)
+s32 qsap_disassociate_sta(struct qsap_ctx *pctx, s8 *pVal, s8 *presp, u32 *plen)
 {
-    FILE *fcfg, *ftmp;
-    char buf[MAX_CONF_LINE_LEN];
-    int status = eSUCCESS;
-
-    fcfg = fopen(pdefault, "r");
+    int sock, ret = eERR_UNKNOWN;
+    struct iwreq wrq;
+    s8 pbuf[MAX_CONF_LINE_LEN];
+    u32 len = MAX_CONF_LINE_LEN;
+    s8 *pif;
 
-    if(NULL == fcfg) {
-        ALOGE("%s : unable to open file \n", __func__);
-        return eERR_FILE_OPEN;
+    if(ENABLE != is_softap_enabled_ctx(pctx)) {
+        goto end;
     }
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pcfgfile);
-
-    ftmp = fopen(buf, "w+");
-    if(NULL == ftmp) {
-        ALOGE("%s : unable to open file \n", __func__);
-        fclose(fcfg);
-        return eERR_FILE_OPEN;
+    if(NULL == (pif = qsap_ctx_get_iface(pctx, pbuf, &len))) {
+        ALOGE("%s :interface error \n", __func__);
+        goto end;
     }
 
-    while(NULL != fgets(buf, MAX_CONF_LINE_LEN, fcfg)) {
-        fprintf(ftmp, "%s", buf);
+    pbuf[len] = '\0';
+
+    sock = qsap_ctx_get_sock(pctx);
+    if(sock < 0) {
+        ALOGE("%s: socket failure \n", __func__);
+        goto end;
     }
 
-    fclose(fcfg);
-    fclose(ftmp);
+    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
 
-    qsap_scnprintf(buf, sizeof(buf), "%s~", pcfgfile);
+    if (TRUE != qsap_get_mac_in_bytes(pVal, (char *) &wrq.u)) {
+        ALOGE("%s: Invalid input \n", __func__);
+        goto end;
+    }
 
-    if(eERR_UNKNOWN == rename(buf, pcfgfile))
-        status = eERR_CONF_FILE;
+    ret = ioctl(sock, QCSAP_IOCTL_DISASSOC_STA, &wrq);
+    if(ret < 0) {
+        ALOGE("%s: ioctl failure \n", __func__);
+    }
 
-    /** Remove the temporary file. Dont care the return value */
-    unlink(buf);
+end:
+    *plen = qsap_scnprintf(presp, *plen, "%s", (ret == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
 
-    return status;
+    return (ret == eSUCCESS) ? eSUCCESS : eERR_UNKNOWN;
 }
 
-#define CTRL_IFACE_PATH_LEN   (128)
-
-void qsap_del_ctrl_iface(void)
+static int qsap_set_channel(struct qsap_ctx *pctx, s32 channel, s8 *tbuf, u32 *tlen)
 {
-    u32 len;
-    s8 dst_path[CTRL_IFACE_PATH_LEN], *pcif, *pif;
-    s8 interface[64];
-    s8 path[CTRL_IFACE_PATH_LEN + 64];
+    u32 ulen;
+    s8 *pcfgval;
+    s8 schan[MAX_INT_STR+1];
+    s8 *pcfg = pctx->conf;
 
-    len = CTRL_IFACE_PATH_LEN;
+    ulen = *tlen;
 
-    if(NULL == (pcif = qsap_get_config_value(pconffile, &qsap_str[STR_CTRL_INTERFACE], dst_path, &len))) {
-        ALOGE("%s :ctrl_iface path error \n", __func__);
-        goto error;
+    /* Do not worry about hw_mode if intention is to use ACS (channel=0) */
+    if (channel == 0)
+        goto end;
+
+    /** Read the current operating mode */
+    if(NULL == (pcfgval = qsap_get_config_value(pctx->conf, &cmd_list[eCMD_HW_MODE], tbuf, &ulen))) {
+        return eERR_UNKNOWN;
     }
 
-    len = 64;
+    /** If the operating mode is 'A' and the channel to be set is in between 1 and 14
+      * then change the operating mode to 'G' mode */
+    if((!strcmp(hw_mode[HW_MODE_A], pcfgval)) && (channel <=14)) {
+        /** Change the operating mode to 'G' */
+        ulen = *tlen;
+        if(eSUCCESS != qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], hw_mode[HW_MODE_G], tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE)) {
+            ALOGE("%s :Unable to update the operating mode \n", __func__);
+            return eERR_UNKNOWN;
+        }
+    }
 
-    if(NULL == (pif = qsap_get_config_value(pconffile, &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGE("%s :interface error \n", __func__);
-        goto error;
+    /** If the operating mode is NOT 'B' and the channel to be set is  14
+      * then change the operating mode to 'B' mode */
+    if(strcmp(hw_mode[HW_MODE_B], pcfgval) && (channel == 14)) {
+        /** Change the operating mode to 'B' */
+        ulen = *tlen;
+        if(eSUCCESS != qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], hw_mode[HW_MODE_B], tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE)) {
+            ALOGE("%s :Unable to update the operating mode \n", __func__);
+            return eERR_UNKNOWN;
+        }
     }
 
-    if ((int)sizeof(path) <= snprintf(path, sizeof(path), "%s/%s", pcif, pif)) {
-        ALOGE("Iface path : truncating error, %s \n", path);
-        goto error;
+    if(channel > 14) {
+        /** Change the operating mode to 'A' */
+        ulen = *tlen;
+        if(eSUCCESS != qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], hw_mode[HW_MODE_A], tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE)) {
+            ALOGE("%s :Unable to update the operating mode \n", __func__);
+            return eERR_UNKNOWN;
+        }
     }
 
-    unlink(path);
+end:
+    qsap_scnprintf(schan, sizeof(schan), "%d", channel);
 
-error:
-    return;
+    return qsap_write_cfg(pcfg, &cmd_list[eCMD_CHAN], schan, tbuf, tlen, HOSTAPD_CONF_QCOM_FILE);
 }
 
-static int qsap_send_cmd_to_hostapd(s8 *pcmd)
+static int qsap_set_operating_mode(struct qsap_ctx *pctx, s32 mode, s8 *pmode, int pmode_len, s8 *tbuf, u32 *tlen)
 {
-    int sock;
-    struct sockaddr_un cli;
-    struct sockaddr_un ser;
-    struct timeval timeout;
-    int ret = eERR_SEND_TO_HOSTAPD;
-    u32 len;
-    fd_set read;
-    s8 dst_path[CTRL_IFACE_PATH_LEN], *pcif, *pif;
-    s8 interface[64];
-    s8 *ptr;
-    u32 retry_cnt = 3;
-    size_t ptr_size;
+    u32 ulen;
+    s8 *pcfg = pctx->conf;
+    s8  ieee11n_enable[] = "1";
+    s8  ieee11n_disable[] = "0";
+    s8 *pieee11n = ieee11n_disable;
+    struct qsap_cfg_toggle toggle[3] = {
+        { &cmd_list[eCMD_BASIC_RATES], DISABLE },
+        { &cmd_list[eCMD_REQUIRE_HT],  DISABLE },
+        { &cmd_list[eCMD_HT_CAPAB],    DISABLE },
+    };
+    u32 num = 2;
 
-    len = CTRL_IFACE_PATH_LEN;
-    ptr_size = (sizeof(ser.sun_path) < CTRL_IFACE_PATH_LEN)?
-        CTRL_IFACE_PATH_LEN : sizeof(ser.sun_path);
-    ptr = malloc(ptr_size);
-    if(NULL == ptr) {
-        ALOGE("%s :No memory \n", __func__);
-        return ret;
+    ulen = *tlen;
+
+    /** Update the operating mode */
+    switch(mode)
+    {
+        case HW_MODE_G_ONLY:
+            toggle[0].status = ENABLE;
+            break;
+        case HW_MODE_N_ONLY:
+            toggle[1].status = ENABLE;
+            /* fall through */
+        case HW_MODE_N:
+        case HW_MODE_G:
+        case HW_MODE_A:
+        case HW_MODE_ANY:
+            pieee11n = ieee11n_enable;
+            break;
+        case HW_MODE_AD:
+            /** For 802.11ad, disable the 802.11 HT */
+            num = 3;
+            break;
     }
+    qsap_change_cfg_list(pcfg, toggle, num);
+    qsap_write_cfg(pcfg, &cmd_list[eCMD_IEEE80211N], pieee11n, tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE);
 
-    if(NULL == (pcif = qsap_get_config_value(pconffile, &qsap_str[STR_CTRL_INTERFACE], dst_path, &len))) {
-        ALOGE("%s :ctrl_iface path error \n", __func__);
-        goto error;
+    if(mode == HW_MODE_G_ONLY || mode == HW_MODE_N_ONLY || mode == HW_MODE_N ) {
+        qsap_scnprintf(pmode, pmode_len, "%s",hw_mode[HW_MODE_G]);
     }
+    return qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], pmode, tbuf, tlen, HOSTAPD_CONF_QCOM_FILE);
+}
 
-    len = 64;
+static int qsap_set_data_rate(struct qsap_ctx *pctx, s32 drate_idx, s8 *presp, u32 *plen)
+{
+    u32 ulen;
+    s8 *pmode;
+    s8 sconf[MAX_INT_STR+1];
+    int ret = eERR_UNKNOWN;
 
-    if(NULL == (pif = qsap_get_config_value(pconffile, &qsap_str[STR_INTERFACE], interface, &len))) {
-        ALOGE("%s :interface error \n", __func__);
-        goto error;
+    if(TRUE != IS_VALID_DATA_RATE_IDX(drate_idx)) {
+        ALOGE("%s :Invalid rate index \n", __func__);
+        goto end;
     }
 
-    if ((int)sizeof(ser.sun_path) <= snprintf(ptr, sizeof(ser.sun_path), "%s/%s", pcif, pif)) {
-        /* the sun_path is truncated. */
-        ALOGE("Iface path : truncating error, %s \n", ptr);
-        goto error;
+    ulen = *plen;
+    /** Read the current operating mode */
+    if(NULL == (pmode = qsap_get_config_value(pctx->conf, &cmd_list[eCMD_HW_MODE], presp, &ulen))) {
+        ALOGE("%s :Unable to read mode \n", __func__);
+        goto end;
     }
 
-    ALOGD("Connect to :%s\n", ptr);
-
-    sock = socket(PF_UNIX, SOCK_DGRAM, 0);
-    if(sock < 0) {
-        ALOGE("%s :Socket error \n", __func__);
-        goto error;
+    /** Validate the rate index against the current operating mode */
+    if(((!strcmp(pmode, hw_mode[HW_MODE_B])) && (drate_idx > B_MODE_MAX_DATA_RATE_IDX)) ||
+        ((!strcmp(pmode, hw_mode[HW_MODE_G]) || (!strcmp(pmode, hw_mode[HW_MODE_G_ONLY]))) &&
+        (drate_idx > G_ONLY_MODE_MAX_DATA_RATE_IDX))) {
+        ALOGE("%s :Invalid rate index \n", __func__);
+        goto end;
     }
 
-    cli.sun_family = AF_UNIX;
-    qsap_scnprintf(cli.sun_path, sizeof(cli.sun_path), SDK_CTRL_IF);
+    qsap_scnprintf(sconf, sizeof(sconf), "%d", drate_idx);
 
-    ret = bind(sock, (struct sockaddr *)&cli, sizeof(cli));
+    /** Update the rate index in the configuration */
+    return qsap_write_cfg(qsap_ctx_ini(pctx), &qsap_str[STR_DATA_RATE_IN_INI], sconf, presp, plen, INI_CONF_FILE);
 
-    if(ret < 0) {
-        ALOGE("Bind Failure\n");
-        goto close_ret;
-    }
+end:
+    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
 
-    ser.sun_family = AF_UNIX;
-    qsap_scnprintf(ser.sun_path, sizeof(ser.sun_path), "%s", ptr);
-    ALOGD("Connect to: %s,(%d)\n", ser.sun_path, sock);
+    return ret;
+}
 
-    ret = connect(sock, (struct sockaddr *)&ser, sizeof(ser));
-    if(ret < 0) {
-        ALOGE("Connect Failure...\n");
-        goto close_ret;
-    }
+/** Types of the value of a 'set' command */
+enum qsap_param_type {
+    QSAP_TYPE_NONE = 0,    /** no value, the command is an action */
+    QSAP_TYPE_INT  = 1,    /** integer value in the range [min, max] */
+    QSAP_TYPE_STR  = 2     /** string value, of length in the range [min, max] */
+};
 
-    ret = send(sock, pcmd, strlen(pcmd), 0);
-    if(ret < 0) {
-        ALOGE("Unable to send cmd to hostapd \n");
-        goto close_ret;
-    }
-    /* reset the ptr buffer size for recv */
-    len = ptr_size;
+/** The change takes effect only after a restart of the soft AP */
+#define QSAP_PARAM_RESTART    (1 << 0)
+/** An empty value is accepted along with the values in the range */
+#define QSAP_PARAM_EMPTY      (1 << 1)
+/** The value is only sent to hostapd, the configuration files are not updated */
+#define QSAP_PARAM_CTRL       (1 << 2)
+/** hostapd takes the new value at runtime with SET, see qsap_live_apply() */
+#define QSAP_PARAM_LIVE       (1 << 3)
+/** After a live update, the beacon is updated */
+#define QSAP_PARAM_BEACON     (1 << 4)
+/** MAC address list, updated in hostapd with ACCEPT_ACL or DENY_ACL */
+#define QSAP_PARAM_ACL        (1 << 5)
+
+/** No upper limit for a value or a length */
+#define QSAP_NO_LIMIT         (0x7fffffff)
 
-#define HOSTAPD_RECV_TIMEOUT    (2)
-    while(1) {
-        timeout.tv_sec = HOSTAPD_RECV_TIMEOUT;
-        timeout.tv_usec = 0;
+/**
+ * Custom handler of a 'set' command, called with the validated value.
+ * For an integer type, the value is also written back to pVal as "%d".
+ * The handler stores the command response in presp and returns eSUCCESS,
+ * or one of the error codes of enum error_val.
+ */
+typedef s32 (*qsap_set_fn)(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s32 value, s8 *presp, u32 *plen);
+
+/** Descriptor of a 'set' command */
+struct qsap_param {
+    u8 type;          /** QSAP_TYPE_* */
+    s32 min;          /** minimum value or length */
+    s32 max;          /** maximum value or length */
+    esap_str_t ini;   /** parameter in the ini file, eSTR_INVALID for hostapd.conf */
+    u8 flags;         /** QSAP_PARAM_* */
+    qsap_set_fn set;  /** custom handler, NULL to write the value to the file */
+};
 
-        FD_ZERO(&read);
-        FD_SET(sock, &read);
+/**
+ * @brief
+ *        Write the value of a parameter to the file it is stored in.
+ * @param cNum [IN] command number
+ * @param pVal [IN] value of the parameter
+ * @param presp [OUT] buffer to store the command response
+ * @param plen [IN-OUT] length of the response buffer
+ * @return On success, eSUCCESS
+**/
+static s32 qsap_set_param_value(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s8 *presp, u32 *plen);
 
-        ret = select(sock+1, &read, NULL, NULL, &timeout);
+static s32 qsap_handle_set_mac_list(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    esap_str_t sNum = STR_DENY_MAC_FILE;
+    s8 filename[MAX_FILE_PATH_LEN];
+    u32 ulen = MAX_FILE_PATH_LEN;
+    s8 *pfile;
 
-        if(FD_ISSET(sock, &read)) {
+    if((cNum == eCMD_ADD_TO_ALLOW) || (cNum == eCMD_REMOVE_FROM_ALLOW))
+        sNum = STR_ACCEPT_MAC_FILE;
 
-            ret = recv(sock, ptr, len, 0);
+    if(NULL == (pfile = qsap_get_allow_deny_file_name(pctx->conf, &qsap_str[sNum], filename, &ulen))) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
+        return eERR_FILE_OPEN;
+    }
 
-            if(ret < 0) {
-                ALOGE("%s: recv() failed \n", __func__);
-                goto close_ret;
-            }
+    return qsap_update_mac_list(pfile, cNum, pVal, presp, plen);
+}
 
-            if ((u32)ret >= len)
-                ptr[len-1] = 0;
-            else
-                ptr[ret] = 0;
+static s32 qsap_handle_set_sec_mode(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, UNUSED s8 *pVal, s32 value, s8 *presp, u32 *plen)
+{
+    return qsap_set_security_mode(pctx->conf, value, presp, plen);
+}
 
-            if((ret > 0) && (ptr[0] == '<')) {
-                ALOGE("Not the expected response...\n: %s", ptr);
-                retry_cnt--;
-                if(retry_cnt)
-                    continue;
-                break;
-            }
+static s32 qsap_handle_set_mac_acl(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s32 value, s8 *presp, u32 *plen)
+{
+    s32 status;
 
-            if(!strncmp(ptr, "FAIL", 4)) {
-                ALOGE("Command failed in hostapd \n");
-                goto close_ret;
-            }
-            else {
-                break;
-            }
-        }
-        else {
-            ALOGE("%s: Select failed \n", __func__);
-            goto close_ret;
+    if(ACL_ALLOW_LIST == value) {
+        value = ENABLE;
+        status = DISABLE;
+    }
+    else if(ACL_DENY_LIST == value){
+        value = DISABLE;
+        status = ENABLE;
+    }
+    else {
+        // must be ACL_ALLOW_AND_DENY_LIST
+        value = ENABLE;
+        status = ENABLE;
+    }
+
+    {
+        struct qsap_cfg_toggle toggle[2] = {
+            { &qsap_str[STR_ACCEPT_MAC_FILE], value },
+            { &qsap_str[STR_DENY_MAC_FILE], status },
+        };
+
+        if(eERR_UNKNOWN == qsap_change_cfg_list(pctx->conf, toggle, 2)) {
+            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+            return eERR_UNKNOWN;
         }
     }
 
-    ret = eSUCCESS;
+    return qsap_write_cfg(pctx->conf, &cmd_list[cNum], pVal, presp, plen, HOSTAPD_CONF_QCOM_FILE);
+}
 
-close_ret:
-    close(sock);
+static s32 qsap_handle_set_transaction(UNUSED struct qsap_ctx *pctx, esap_cmd_t cNum, UNUSED s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    if(cNum == eCMD_BEGIN) {
+        qsap_begin_transaction();
+    }
+    else if(cNum == eCMD_ABORT) {
+        qsap_abort_transaction();
+    }
+    /** Write the updates staged since 'begin' */
+    else if(cfg_tx_owner && (eSUCCESS != qsap_commit_transaction())) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+        return eERR_COMMIT;
+    }
+#if 0 // COMMIT is not required currently for ICS framework
+    if ( gIniUpdated ) {
+        status = wifi_qsap_reload_softap();
+        gIniUpdated = 0;
+    }
+    else {
+        status = commit();
+    }
+    *plen = qsap_scnprintf(presp, *plen, "%s", (status ==  eSUCCESS)? SUCCESS : ERR_UNKNOWN);
+#endif
+    *plen = qsap_scnprintf(presp, *plen, "%s", SUCCESS);
+    return eSUCCESS;
+}
 
-error:
-    free(ptr);
-    unlink(SDK_CTRL_IF);
-    return ret;
+static s32 qsap_handle_set_enable_softap(struct qsap_ctx *pctx, esap_cmd_t cNum, UNUSED s8 *pVal, s32 value, s8 *presp, u32 *plen)
+{
+    s32 status;
+
+    if(cNum == eCMD_ENABLE_WIGIG_SOFTAP) {
+        status = (value == DISABLE) ? wifi_qsap_stop_wigig_softap_ctx(pctx) : wifi_qsap_start_wigig_softap_ctx(pctx);
+        *plen = qsap_scnprintf(presp, *plen, "%s", (status==eSUCCESS) ? SUCCESS : "failure Could not enable Wigig softap");
+        return status;
+    }
+
+    status = (value == DISABLE) ? wifi_qsap_unload_driver() : wifi_qsap_load_driver();
+    *plen = qsap_scnprintf(presp, *plen, "%s", (status==eSUCCESS) ? SUCCESS : "failure Could not enable softap");
+    return status;
+}
+
+static s32 qsap_handle_set_ssid(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    /* Disable ssid2 while setting ssid, and ssid while setting ssid2 */
+    qsap_change_cfg(pctx->conf, &cmd_list[(cNum == eCMD_SSID) ? eCMD_SSID2 : eCMD_SSID], DISABLE);
+    return qsap_set_param_value(pctx, cNum, pVal, presp, plen);
 }
 
-static void qsap_update_wps_config(s8 *pVal, s8 *presp, u32 *plen)
+static s32 qsap_handle_set_channel(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, UNUSED s8 *pVal, s32 value, s8 *presp, u32 *plen)
 {
-    u32 tlen = *plen;
-    s32 status;
-    s8  pwps_state[MAX_INT_STR+1];
-    s32 i;
+    s8 filename[MAX_FILE_PATH_LEN];
+    u32 ulen = MAX_FILE_PATH_LEN;
 
-    /* Enable/disable the following in hostapd.conf
-     * 1. Update the wps_state
-     * 2. Set eap_server=1
-     * 3. Update UPnP related variables
-     */
-    status = atoi(pVal);
+    value = qsap_set_channel(pctx, value, filename, &ulen);
+    *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
+    return (value == eSUCCESS) ? eSUCCESS : eERR_UNKNOWN;
+}
 
-    qsap_scnprintf(pwps_state, sizeof(pwps_state), "%d", (status == ENABLE) ? WPS_STATE_ENABLE : WPS_STATE_DISABLE);
+static s32 qsap_handle_set_hw_mode(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    s8 filename[MAX_FILE_PATH_LEN];
+    u32 ulen = MAX_FILE_PATH_LEN;
 
-    qsap_write_cfg(pconffile, &cmd_list[eCMD_WPS_STATE], pwps_state, presp, &tlen, HOSTAPD_CONF_QCOM_FILE);
+    for(value=HW_MODE_B; value<HW_MODE_UNKNOWN; value++) {
+        if(!strcmp(pVal, hw_mode[value]))
+            break;
+    }
 
-    if(eERR_UNKNOWN == qsap_change_cfg(pconffile, &cmd_list[eCMD_WPS_STATE], status)) {
-        ALOGE("%s: Failed to enable %s\n", __func__, cmd_list[eCMD_WPS_STATE].name);
-        goto error;
+    if(value == HW_MODE_UNKNOWN) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+        return eERR_INVALID_PARAM;
     }
 
-    qsap_scnprintf(pwps_state, sizeof(pwps_state), "%d", ENABLE);
+    /* pVal is anull terminated string */
+    value = qsap_set_operating_mode(pctx, value, pVal, strlen(pVal)+1, filename, &ulen);
+    *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
+    return (value == eSUCCESS) ? eSUCCESS : eERR_UNKNOWN;
+}
 
-    /** update the eap_server=1 */
-    qsap_write_cfg(pconffile, &qsap_str[STR_EAP_SERVER], pwps_state, presp, plen, HOSTAPD_CONF_QCOM_FILE);
+static s32 qsap_handle_set_wep(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    s8 filename[MAX_FILE_PATH_LEN];
+    u32 ulen = MAX_FILE_PATH_LEN;
+    s32 status;
 
-    for(i=eCMD_UUID; i<=eCMD_UPC; i++) {
-        if(eERR_UNKNOWN == qsap_change_cfg(pconffile, &cmd_list[i], status)) {
-            ALOGE("%s: failed to set %s\n", __func__, cmd_list[i].name);
-            goto error;
+    if(cNum == eCMD_DEFAULT_KEY) {
+        status = qsap_write_cfg(pctx->conf, &cmd_list[cNum], pVal, presp, plen, HOSTAPD_CONF_QCOM_FILE);
+    }
+    else {
+        if(FALSE == is_valid_wep_key(pVal, filename, MAX_FILE_PATH_LEN)) {
+            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+            return eERR_INVALID_PARAM;
         }
+        status = qsap_write_cfg(pctx->conf, &cmd_list[cNum], filename, presp, plen, HOSTAPD_CONF_QCOM_FILE);
     }
 
-    return;
-error:
-    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+    /** if the security mode is not WEP, update the WEP features, and
+        do NOT set the WEP security */
+    if(SEC_MODE_WEP != qsap_read_security_mode(pctx->conf, filename, &ulen)) {
+        if(eERR_UNKNOWN == qsap_change_cfg(pctx->conf, &cmd_list[cNum], 0)) {
+            ALOGE("%s: %s \n", __func__, cmd_list[cNum].name);
+            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+            return eERR_UNKNOWN;
+        }
+    }
 
-    return;
+    return status;
 }
 
-static void qsap_config_wps_method(s8 *pVal, s8 *presp, u32 *plen)
+static s32 qsap_handle_set_pairwise(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s32 value, s8 *presp, u32 *plen)
 {
-    s8 buf[64];
-    s8 *ptr;
-    int i;
-    s32 value;
-
-    /** INPUT : <0/1> <PIN> */
-    /** PBC method : WPS_PBC */
-    /** PIN method : WPS_PIN any <key> */
-    ptr = pVal;
-    i = 0;
-
-    while((*ptr != '\0') && (*ptr != ' ')) {
-        buf[i] = *ptr;
-        ptr++;
-        i++;
+    if(FALSE == IS_VALID_PAIRWISE(pVal)) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+        return eERR_INVALID_PARAM;
     }
 
-    buf[i] = '\0';
+    /** If the encryption type is TKIP, disable the 802.11 HT */
+    value = 1;
+    if(!strcmp(pVal, "TKIP")) {
+        value = 0;
+    }
 
-    /** Identify the WPS method */
-    value = atoi(buf);
-    if(TRUE != IS_VALID_WPS_CONFIG(value)) {
+    if(eERR_UNKNOWN == qsap_change_cfg(pctx->conf, &qsap_str[STR_HT_80211N], value)) {
+        ALOGE("%s: unable to update 802.11 HT\n", __func__);
         *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
-        return;
+        return eERR_UNKNOWN;
     }
 
-    SKIP_BLANK_SPACE(ptr);
+    return qsap_set_param_value(pctx, cNum, pVal, presp, plen);
+}
 
-    if( (value == WPS_CONFIG_PIN) && (*ptr == '\0') ){
-        ALOGE("%s :Invalid command \n", __func__);
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
-        return;
-    }
+static s32 qsap_handle_set_reset_ap(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, UNUSED s8 *pVal, s32 value, s8 *presp, u32 *plen)
+{
+    s32 status;
 
-    if(value == WPS_CONFIG_PBC)
-        qsap_scnprintf(buf, sizeof(buf), "WPS_PBC");
-    else {
-        if(strlen(ptr) < WPS_KEY_LEN) {
-            ALOGD("%s :Invalid WPS key length\n", __func__);
-            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
-            return;
+    ALOGE("Reset :%d \n", value);
+    if(SAP_RESET_BSS == value) {
+        status = wifi_qsap_stop_softap_ctx(pctx);
+        if(status == eSUCCESS) {
+            status = wifi_qsap_start_softap();
+            if (eSUCCESS != status)
+                wifi_qsap_unload_driver();
         }
-        qsap_scnprintf(buf, sizeof(buf), "WPS_PIN any %s", ptr);
     }
+    else if(SAP_RESET_DRIVER_BSS == value){
+        status = wifi_qsap_reload_softap();
+    }
+    else if(SAP_STOP_BSS == value) {
+        status = wifi_qsap_stop_bss_ctx(pctx);
+    }
+    else if(SAP_STOP_DRIVER_BSS == value) {
+        status = wifi_qsap_stop_softap_ctx(pctx);
+        if(status == eSUCCESS)
+            status = wifi_qsap_unload_driver();
+    }
+#ifdef QCOM_WLAN_CONCURRENCY
+    else if(SAP_INITAP == value) {
+        status = wifi_qsap_start_softap_in_concurrency();
+    }
+    else if(SAP_EXITAP == value) {
+        status = wifi_qsap_stop_softap_in_concurrency();
+    }
+#endif
+    else {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+        return eERR_INVALID_PARAM;
+    }
+    *plen = qsap_scnprintf(presp, *plen, "%s", (status == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
+    return status;
+}
 
-    value = qsap_send_cmd_to_hostapd(buf);
+static s32 qsap_handle_set_disassoc_sta(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    return qsap_disassociate_sta(pctx, pVal, presp, plen);
+}
 
-    *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS: ERR_UNKNOWN);
+static s32 qsap_handle_set_reset_to_default(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, UNUSED s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    s32 status;
 
-    return;
+    if(eSUCCESS == (status = wifi_qsap_reset_to_default(pctx->conf, DEFAULT_CONFIG_FILE_PATH))) {
+        if(eSUCCESS == (status = wifi_qsap_reset_to_default(qsap_ctx_ini(pctx), DEFAULT_INI_FILE))) {
+            status = wifi_qsap_reload_softap();
+        }
+    }
+    *plen = qsap_scnprintf(presp, *plen, "%s", (status ==  eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
+    return status;
 }
 
-
-s32 atoh(u8 *str)
+static s32 qsap_handle_set_data_rate(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, UNUSED s8 *pVal, s32 value, s8 *presp, u32 *plen)
 {
-    u32 val = 0;
-    u32 pos = 0;
-    s32 len = strlen((char *)str) - 1;
+    return qsap_set_data_rate(pctx, value, presp, plen);
+}
 
-    while(len >= 0) {
-        switch(str[len]) {
+static s32 qsap_handle_set_wps_state(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    return qsap_update_wps_config(pctx, pVal, presp, plen);
+}
 
-        case '0' ... '9':
-                val += (str[len] - '0') << pos;
-                break;
+static s32 qsap_handle_set_wps_method(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    return qsap_config_wps_method(pctx, pVal, presp, plen);
+}
 
-        case 'a' ... 'f':
-                val += (str[len] - 'a' + 10) << pos;
-                break;
+static s32 qsap_handle_set_intra_bss(struct qsap_ctx *pctx, esap_cmd_t cNum, UNUSED s8 *pVal, s32 value, s8 *presp, u32 *plen)
+{
+    s32 status;
 
-        case 'A'... 'F':
-                val += (str[len] - 'A' + 10) << pos;
-                break;
-        }
-        len--;
-        pos += 4;
-    }
+    status = qsap_change_cfg(pctx->conf, &cmd_list[cNum], (DISABLE == value) ? DISABLE : ENABLE);
+    *plen = qsap_scnprintf(presp, *plen, "%s", (status == eSUCCESS) ?
+             SUCCESS : ERR_UNKNOWN);
+    return status;
+}
 
-    return val;
+static s32 qsap_handle_set_autoshutoff(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s32 value, s8 *presp, u32 *plen)
+{
+    /* copy a larger value back to pVal. Please pay special care
+     * in caller to make sure that the buffer has sufficient size. */
+    qsap_scnprintf(pVal, MAX_INT_STR, "%d", value*60);
+    return qsap_set_param_value(pctx, cNum, pVal, presp, plen);
 }
 
-int qsap_get_mac_in_bytes(char *psmac, char *pbmac)
+static s32 qsap_handle_set_energy_detect(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s32 value, s8 *presp, u32 *plen)
 {
-    int val;
-    u8 str[3];
-    u32 i;
+    if(TRUE != IS_VALID_ENERGY_DETECT_TH(value)) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+        return eERR_INVALID_PARAM;
+    }
+    return qsap_set_param_value(pctx, cNum, pVal, presp, plen);
+}
 
-    str[2] = '\0';
+static s32 qsap_handle_set_channel_range(struct qsap_ctx *pctx, UNUSED esap_cmd_t cNum, s8 *pVal, UNUSED s32 value, s8 *presp, u32 *plen)
+{
+    ALOGE("eCMD_SET_CHANNEL_RANGE value :%s\n", pVal);
+    value = qsap_set_channel_range_val(pctx, pVal);
+    *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS :
+                     ERR_UNKNOWN);
+    return (value == eSUCCESS) ? eSUCCESS : eERR_SET_CHAN_RANGE;
+}
 
-    if(FALSE == isValid_MAC_address(psmac)) {
-        return FALSE;
-    }
+/*
+ * Descriptors of the 'set' commands, indexed by the enum esap_cmd in file
+ * qsap_api.h. Every command number must have an entry here.
+ */
+static const struct qsap_param param_list[eCMD_LAST] = {
+    /*                                type           min                      max                      ini                        flags                                    set */
+    [eCMD_SSID]                  = { QSAP_TYPE_STR,  1,                       SSD_MAX_LEN,             eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_ssid },
+    [eCMD_BSSID]                 = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_CHAN]                  = { QSAP_TYPE_INT,  -QSAP_NO_LIMIT,          QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_channel },
+    [eCMD_BCN_INTERVAL]          = { QSAP_TYPE_INT,  BCN_INTERVAL_MIN,        BCN_INTERVAL_MAX,        eSTR_INVALID,              QSAP_PARAM_LIVE | QSAP_PARAM_BEACON,     NULL },
+    [eCMD_DTIM_PERIOD]           = { QSAP_TYPE_INT,  DTIM_PERIOD_MIN,         DTIM_PERIOD_MAX,         eSTR_INVALID,              QSAP_PARAM_LIVE | QSAP_PARAM_BEACON,     NULL },
+    [eCMD_HW_MODE]               = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_hw_mode },
+    [eCMD_AUTH_ALGS]             = { QSAP_TYPE_INT,  AHTH_ALG_OPEN,           AUTH_ALG_OPEN_SHARED,    eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_SEC_MODE]              = { QSAP_TYPE_INT,  SEC_MODE_NONE,           SEC_MODE_INVALID-1,      eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_sec_mode },
+    [eCMD_WEP_KEY0]              = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_wep },
+    [eCMD_WEP_KEY1]              = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_wep },
+    [eCMD_WEP_KEY2]              = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_wep },
+    [eCMD_WEP_KEY3]              = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_wep },
+    [eCMD_DEFAULT_KEY]           = { QSAP_TYPE_INT,  0,                       3,                       eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_wep },
+    [eCMD_PASSPHRASE]            = { QSAP_TYPE_STR,  PASSPHRASE_MIN,          PASSPHRASE_MAX,          eSTR_INVALID,              QSAP_PARAM_RESTART | QSAP_PARAM_EMPTY,   NULL },
+    [eCMD_WPA_PAIRWISE]          = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_pairwise },
+    [eCMD_RSN_PAIRWISE]          = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_pairwise },
+    [eCMD_MAC_ADDR]              = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_RESET_AP]              = { QSAP_TYPE_INT,  -QSAP_NO_LIMIT,          QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       qsap_handle_set_reset_ap },
+    [eCMD_MAC_ACL]               = { QSAP_TYPE_INT,  ACL_DENY_LIST,           ACL_ALLOW_AND_DENY_LIST, eSTR_INVALID,              QSAP_PARAM_LIVE,                         qsap_handle_set_mac_acl },
+    [eCMD_ADD_TO_ALLOW]          = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_ACL,                          qsap_handle_set_mac_list },
+    [eCMD_ADD_TO_DENY]           = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_ACL,                          qsap_handle_set_mac_list },
+    [eCMD_REMOVE_FROM_ALLOW]     = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_ACL,                          qsap_handle_set_mac_list },
+    [eCMD_REMOVE_FROM_DENY]      = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_ACL,                          qsap_handle_set_mac_list },
+    [eCMD_ALLOW_LIST]            = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       NULL },
+    [eCMD_DENY_LIST]             = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       NULL },
+    [eCMD_COMMIT]                = { QSAP_TYPE_NONE, 0,                       0,                       eSTR_INVALID,              0,                                       qsap_handle_set_transaction },
+    [eCMD_ENABLE_SOFTAP]         = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  eSTR_INVALID,              0,                                       qsap_handle_set_enable_softap },
+    [eCMD_DISASSOC_STA]          = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       qsap_handle_set_disassoc_sta },
+    [eCMD_RESET_TO_DEFAULT]      = { QSAP_TYPE_NONE, 0,                       0,                       eSTR_INVALID,              0,                                       qsap_handle_set_reset_to_default },
+    [eCMD_PROTECTION_FLAG]       = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  STR_PROT_FLAG_IN_INI,      QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_DATA_RATES]            = { QSAP_TYPE_INT,  -QSAP_NO_LIMIT,          QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_data_rate },
+    [eCMD_ASSOC_STA_MACS]        = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       NULL },
+    [eCMD_TX_POWER]              = { QSAP_TYPE_INT,  MIN_TX_POWER,            MAX_TX_POWER,            STR_TX_POWER_IN_INI,       QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_SDK_VERSION]           = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       NULL },
+    [eCMD_WMM_STATE]             = { QSAP_TYPE_INT,  WMM_AUTO_IN_INI,         WMM_DISABLED_IN_INI,     eSTR_INVALID,              QSAP_PARAM_LIVE | QSAP_PARAM_BEACON,     NULL },
+    [eCMD_WPS_STATE]             = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_wps_state },
+    [eCMD_WPS_CONFIG_METHOD]     = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_CTRL,                         qsap_handle_set_wps_method },
+    [eCMD_UUID]                  = { QSAP_TYPE_STR,  MIN_UUID_LEN,            MAX_UUID_LEN,            eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_DEVICE_NAME]           = { QSAP_TYPE_STR,  MIN_DEVICENAME_LEN,      MAX_DEVICENAME_LEN,      eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_MANUFACTURER]          = { QSAP_TYPE_STR,  MIN_MANUFACTURER_LEN,    MAX_MANUFACTURER_LEN,    eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_MODEL_NAME]            = { QSAP_TYPE_STR,  MIN_MODELNAME_LEN,       MAX_MODELNAME_LEN,       eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_MODEL_NUMBER]          = { QSAP_TYPE_STR,  MIN_MODELNUM_LEN,        MAX_MODELNUM_LEN,        eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_SERIAL_NUMBER]         = { QSAP_TYPE_STR,  MIN_SERIALNUM_LEN,       MAX_SERIALNUM_LEN,       eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_DEVICE_TYPE]           = { QSAP_TYPE_STR,  MIN_DEV_TYPE_LEN,        MAX_DEV_TYPE_LEN,        eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_OS_VERSION]            = { QSAP_TYPE_STR,  MIN_OS_VERSION_LEN,      MAX_OS_VERSION_LEN,      eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_FRIENDLY_NAME]         = { QSAP_TYPE_STR,  MIN_FRIENDLY_NAME_LEN,   MAX_FRIENDLY_NAME_LEN,   eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_MANUFACTURER_URL]      = { QSAP_TYPE_STR,  1,                       MAX_URL_LEN,             eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_MODEL_DESC]            = { QSAP_TYPE_STR,  MIN_MODEL_DESC_LEN+1,    MAX_MODEL_DESC_LEN,      eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_MODEL_URL]             = { QSAP_TYPE_STR,  1,                       MAX_URL_LEN,             eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_UPC]                   = { QSAP_TYPE_STR,  MIN_UPC_LEN+1,           MAX_UPC_LEN,             eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_FRAG_THRESHOLD]        = { QSAP_TYPE_INT,  FRAG_THRESHOLD_MIN,      FRAG_THRESHOLD_MAX,      eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_RTS_THRESHOLD]         = { QSAP_TYPE_INT,  RTS_THRESHOLD_MIN,       RTS_THRESHOLD_MAX,       eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_GTK_TIMEOUT]           = { QSAP_TYPE_INT,  GTK_MIN,                 QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_COUNTRY_CODE]          = { QSAP_TYPE_STR,  1,                       CTRY_MAX_LEN,            eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_INTRA_BSS_FORWARD]     = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  eSTR_INVALID,              QSAP_PARAM_LIVE,                         qsap_handle_set_intra_bss },
+    [eCMD_REGULATORY_DOMAIN]     = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_AP_STATISTICS]         = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       NULL },
+    [eCMD_AP_AUTOSHUTOFF]        = { QSAP_TYPE_INT,  AP_SHUTOFF_MIN,          AP_SHUTOFF_MAX,          STR_AP_AUTOSHUTOFF,        QSAP_PARAM_RESTART,                      qsap_handle_set_autoshutoff },
+    [eCMD_AP_ENERGY_DETECT_TH]   = { QSAP_TYPE_INT,  AP_ENERGY_DETECT_TH_MIN, 128,                     STR_AP_ENERGY_DETECT_TH,   QSAP_PARAM_RESTART,                      qsap_handle_set_energy_detect },
+    [eCMD_BASIC_RATES]           = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_REQUIRE_HT]            = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_IEEE80211N]            = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_SET_CHANNEL_RANGE]     = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       qsap_handle_set_channel_range },
+    [eCMD_GET_AUTO_CHANNEL]      = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              0,                                       NULL },
+    [eCMD_IEEE80211W]            = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_WPA_KEY_MGMT]          = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_SET_MAX_CLIENTS]       = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_LIVE,                         NULL },
+    [eCMD_IEEE80211AC]           = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_VHT_OPER_CH_WIDTH]     = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_ACS_CHAN_LIST]         = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_HT_CAPAB]              = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_IEEE80211H]            = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_ENABLE_WIGIG_SOFTAP]   = { QSAP_TYPE_INT,  DISABLE,                 ENABLE,                  eSTR_INVALID,              0,                                       qsap_handle_set_enable_softap },
+    [eCMD_INTERFACE]             = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_SSID2]                 = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      qsap_handle_set_ssid },
+    [eCMD_BRIDGE]                = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_CTRL_INTERFACE]        = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_VENDOR_ELEMENT]        = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_ASSOCRESP_ELEMENT]     = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_ACS_EXCLUDE_DFS]       = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_WOWLAN_TRIGGERS]       = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_ACCEPT_MAC_FILE]       = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_DENY_MAC_FILE]         = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_OWE_TRANS_IFNAME]      = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_SAE_REQUIRE_MPF]       = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_IEEE80211AX]           = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_ENABLE_EDMG]           = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_EDMG_CHANNEL]          = { QSAP_TYPE_STR,  1,                       QSAP_NO_LIMIT,           eSTR_INVALID,              QSAP_PARAM_RESTART,                      NULL },
+    [eCMD_BEGIN]                 = { QSAP_TYPE_NONE, 0,                       0,                       eSTR_INVALID,              0,                                       qsap_handle_set_transaction },
+    [eCMD_ABORT]                 = { QSAP_TYPE_NONE, 0,                       0,                       eSTR_INVALID,              0,                                       qsap_handle_set_transaction },
+};
 
-    for(i=0; i<strlen(psmac); i++) {
-        if(psmac[i] == ':')
-            continue;
+static s32 qsap_set_param_value(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s8 *presp, u32 *plen)
+{
+    esap_str_t sNum = param_list[cNum].ini;
 
-        str[0] = psmac[i];
-        str[1] = psmac[i+1];
-        val = atoh(str);
-        *pbmac = val;
-        pbmac++;
-        i += 2;
+    if(sNum != eSTR_INVALID) {
+        ALOGD("WRITE TO INI FILE :%s\n", qsap_str[sNum].name);
+        return qsap_write_cfg(qsap_ctx_ini(pctx), &qsap_str[sNum], pVal, presp, plen, INI_CONF_FILE);
     }
-    *pbmac = 0;
 
-    return TRUE;
+    return qsap_write_cfg(pctx->conf, &cmd_list[cNum], pVal, presp, plen, HOSTAPD_CONF_QCOM_FILE);
 }
 
-void qsap_disassociate_sta(s8 *pVal, s8 *presp, u32 *plen)
+/** Number of the parameters of a transaction pushed to hostapd at its commit */
+#define QSAP_LIVE_PENDING_MAX    (32)
+
+/** Parameters updated in the open transaction, for qsap_live_flush() */
+static struct qsap_live_pending {
+    struct qsap_ctx *pctx;
+    esap_cmd_t cNum;
+} live_pending[QSAP_LIVE_PENDING_MAX];
+static u32 live_npending;
+
+/** Report a change hostapd did not take, it applies on the next start */
+static void qsap_live_done(void *arg, UNUSED u32 token, s32 status, const s8 *presp, UNUSED u32 len)
 {
-    int sock, ret = eERR_UNKNOWN;
-    struct iwreq wrq;
-    s8 pbuf[MAX_CONF_LINE_LEN];
-    u32 len = MAX_CONF_LINE_LEN;
-    s8 *pif;
+    if(eSUCCESS == status)
+        return;
 
-    if(ENABLE != is_softap_enabled()) {
-        goto end;
-    }
+    if(eERR_SEND_TO_HOSTAPD == status)
+        ALOGD("%s : hostapd not running, %s applies on start \n", __func__, (const s8 *)arg);
+    else
+        ALOGE("%s : hostapd did not take %s: %s \n", __func__, (const s8 *)arg, presp);
+}
 
-    if(NULL == (pif = qsap_get_config_value(pconffile, &qsap_str[STR_INTERFACE], pbuf, &len))) {
-        ALOGE("%s :interface error \n", __func__);
-        goto end;
-    }
+/** Send a command to the running hostapd without waiting for its reply */
+static void __attribute__((format(printf, 3, 4))) qsap_live_submit(struct qsap_ctx *pctx, const s8 *pname, const s8 *pfmt, ...)
+{
+    s8 cmd[HOSTAPD_CMD_LEN];
+    va_list arg_ptr;
+    u32 token;
+    int len;
 
-    pbuf[len] = '\0';
+    va_start(arg_ptr, pfmt);
+    len = vsnprintf(cmd, sizeof(cmd), pfmt, arg_ptr);
+    va_end(arg_ptr);
 
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if(sock < 0) {
-        ALOGE("%s: socket failure \n", __func__);
-        goto end;
+    if((len < 0) || (len >= (int)sizeof(cmd))) {
+        ALOGE("%s : %s is too long, it applies on restart \n", __func__, pname);
+        return;
     }
 
-    strlcpy(wrq.ifr_name, pif, sizeof(wrq.ifr_name));
+    if(eSUCCESS != qsap_ctrl_submit_ctx(pctx, cmd, qsap_live_done, (void *)pname, &token))
+        ALOGD("%s : hostapd not reachable, %s applies on start \n", __func__, pname);
+}
 
-    if (TRUE != qsap_get_mac_in_bytes(pVal, (char *) &wrq.u)) {
-        ALOGE("%s: Invalid input \n", __func__);
-        close(sock);
-        goto end;
-    }
+/** Update the MAC address list of hostapd with the addresses of a 'set' command */
+static void qsap_live_acl(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal)
+{
+    const s8 *plist = "DENY_ACL", *pop = "DEL_MAC";
+    s8 mac[MAC_ADDR_LEN + 1];
+    u32 len;
 
-    ret = ioctl(sock, QCSAP_IOCTL_DISASSOC_STA, &wrq);
-    if(ret < 0) {
-        ALOGE("%s: ioctl failure \n", __func__);
-    }
-    close(sock);
+    if((cNum == eCMD_ADD_TO_ALLOW) || (cNum == eCMD_REMOVE_FROM_ALLOW))
+        plist = "ACCEPT_ACL";
+    if((cNum == eCMD_ADD_TO_ALLOW) || (cNum == eCMD_ADD_TO_DENY))
+        pop = "ADD_MAC";
 
-end:
-    *plen = qsap_scnprintf(presp, *plen, "%s", (ret == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
+    /** The addresses are separated by a blank space */
+    while(*pVal != '\0') {
+        len = strcspn(pVal, " ");
+        qsap_scnprintf(mac, sizeof(mac), "%.*s", (int)len, pVal);
+        pVal += len;
+        SKIP_BLANK_SPACE(pVal);
 
-    return;
+        if((len == MAC_ADDR_LEN) && (TRUE == isValid_MAC_address(mac)))
+            qsap_live_submit(pctx, cmd_list[cNum].name, "%s %s %s", plist, pop, mac);
+    }
 }
 
-static int qsap_set_channel(s32 channel, s8 *tbuf, u32 *tlen)
+/**
+ * @brief
+ *        Push the new value of a parameter to the running hostapd, so that it
+ *        takes effect without a restart of the soft AP. The value is the one
+ *        of the configuration, as hostapd would read it on start. The
+ *        commands are pipelined, their failure is only logged: the value of
+ *        the configuration applies on the next start.
+ * @param pctx [IN] soft AP instance
+ * @param cNum [IN] command number, of a parameter with QSAP_PARAM_LIVE or
+ *                  QSAP_PARAM_ACL
+ * @param pVal [IN] value of the 'set' command
+ * @return void
+**/
+static void qsap_live_apply(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal)
 {
-    u32 ulen;
-    s8 *pcfgval;
-    s8 schan[MAX_INT_STR+1];
-    s8 *pcfg = pconffile;
-
-    ulen = *tlen;
-
-    /* Do not worry about hw_mode if intention is to use ACS (channel=0) */
-    if (channel == 0)
-        goto end;
+    const struct qsap_param *pparam = &param_list[cNum];
+    s8 val[HOSTAPD_CMD_LEN];
+    u32 len = sizeof(val), i;
+    esap_str_t acl_file[2] = { STR_ACCEPT_MAC_FILE, STR_DENY_MAC_FILE };
 
-    /** Read the current operating mode */
-    if(NULL == (pcfgval = qsap_get_config_value(pconffile, &cmd_list[eCMD_HW_MODE], tbuf, &ulen))) {
-        return eERR_UNKNOWN;
+    if(pparam->flags & QSAP_PARAM_ACL) {
+        qsap_live_acl(pctx, cNum, pVal);
+        return;
     }
 
-    /** If the operating mode is 'A' and the channel to be set is in between 1 and 14
-      * then change the operating mode to 'G' mode */
-    if((!strcmp(hw_mode[HW_MODE_A], pcfgval)) && (channel <=14)) {
-        /** Change the operating mode to 'G' */
-        ulen = *tlen;
-        if(eSUCCESS != qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], hw_mode[HW_MODE_G], tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE)) {
-            ALOGE("%s :Unable to update the operating mode \n", __func__);
-            return eERR_UNKNOWN;
+    if(NULL == qsap_get_config_value(pctx->conf, &cmd_list[cNum], val, &len)) {
+        /** A flag with its line disabled is off */
+        if((pparam->type != QSAP_TYPE_INT) || (pparam->min != DISABLE) || (pparam->max != ENABLE)) {
+            ALOGE("%s : %s not in the configuration, it applies on restart \n", __func__, cmd_list[cNum].name);
+            return;
         }
+        qsap_scnprintf(val, sizeof(val), "%d", DISABLE);
     }
 
-    /** If the operating mode is NOT 'B' and the channel to be set is  14
-      * then change the operating mode to 'B' mode */
-    if(strcmp(hw_mode[HW_MODE_B], pcfgval) && (channel == 14)) {
-        /** Change the operating mode to 'B' */
-        ulen = *tlen;
-        if(eSUCCESS != qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], hw_mode[HW_MODE_B], tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE)) {
-            ALOGE("%s :Unable to update the operating mode \n", __func__);
-            return eERR_UNKNOWN;
+    qsap_live_submit(pctx, cmd_list[cNum].name, "SET %s %s", cmd_list[cNum].name, val);
+
+    /** The lists of the ACL policy are read again, the stations they do not
+      * allow anymore are disconnected */
+    if(cNum == eCMD_MAC_ACL) {
+        for(i=0; i<2; i++) {
+            len = sizeof(val);
+            if(NULL != qsap_get_config_value(pctx->conf, &qsap_str[acl_file[i]], val, &len))
+                qsap_live_submit(pctx, qsap_str[acl_file[i]].name, "SET %s %s", qsap_str[acl_file[i]].name, val);
         }
     }
 
-    if(channel > 14) {
-        /** Change the operating mode to 'A' */
-        ulen = *tlen;
-        if(eSUCCESS != qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], hw_mode[HW_MODE_A], tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE)) {
-            ALOGE("%s :Unable to update the operating mode \n", __func__);
-            return eERR_UNKNOWN;
-        }
+    if(pparam->flags & QSAP_PARAM_BEACON)
+        qsap_live_submit(pctx, cmd_list[cNum].name, "UPDATE_BEACON");
+}
+
+/**
+ * @brief
+ *        Push a parameter updated by a 'set' command to the running hostapd.
+ *        In a transaction, the configuration is written on commit: the
+ *        parameter is pushed then, by qsap_live_flush(). The MAC address
+ *        lists are written at once, they are pushed at once.
+ * @param pctx [IN] soft AP instance
+ * @param cNum [IN] command number
+ * @param pVal [IN] value of the 'set' command
+ * @return void
+**/
+static void qsap_live_update(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal)
+{
+    u32 i;
+
+    if((param_list[cNum].flags & QSAP_PARAM_ACL) || !cfg_tx_owner) {
+        qsap_live_apply(pctx, cNum, pVal);
+        return;
+    }
+
+    for(i=0; i<live_npending; i++) {
+        if((live_pending[i].pctx == pctx) && (live_pending[i].cNum == cNum))
+            return;
     }
 
-end:
-    qsap_scnprintf(schan, sizeof(schan), "%d", channel);
+    if(live_npending == QSAP_LIVE_PENDING_MAX) {
+        ALOGE("%s : too many updates, %s applies on restart \n", __func__, cmd_list[cNum].name);
+        return;
+    }
 
-    return qsap_write_cfg(pcfg, &cmd_list[eCMD_CHAN], schan, tbuf, tlen, HOSTAPD_CONF_QCOM_FILE);
+    live_pending[live_npending].pctx = pctx;
+    live_pending[live_npending].cNum = cNum;
+    live_npending++;
 }
 
-static int qsap_set_operating_mode(s32 mode, s8 *pmode, int pmode_len, s8 *tbuf, u32 *tlen)
+/**
+ * @brief
+ *        End of a transaction: push the parameters it updated to hostapd if
+ *        it is committed, drop them otherwise. Called with the lock held.
+ * @param apply [IN] TRUE if the transaction is committed
+ * @return void
+**/
+static void qsap_live_flush(int apply)
 {
-    u32 ulen;
-    s8 *pcfg = pconffile;
-    s8  ieee11n_enable[] = "1";
-    s8  ieee11n_disable[] = "0";
+    u32 i;
 
-    ulen = *tlen;
+    for(i=0; apply && (i<live_npending); i++)
+        qsap_live_apply(live_pending[i].pctx, live_pending[i].cNum, NULL);
 
-    /** Update the operating mode */
-    qsap_change_cfg(pcfg, &cmd_list[eCMD_BASIC_RATES],DISABLE);
-    qsap_change_cfg(pcfg, &cmd_list[eCMD_REQUIRE_HT],DISABLE);
-    qsap_write_cfg(pcfg, &cmd_list[eCMD_IEEE80211N],ieee11n_disable, tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE);
-    switch(mode)
-    {
-        case HW_MODE_G_ONLY:
-            qsap_change_cfg(pcfg, &cmd_list[eCMD_BASIC_RATES],ENABLE);
-            break;
-        case HW_MODE_N_ONLY:
-            qsap_change_cfg(pcfg, &cmd_list[eCMD_REQUIRE_HT],ENABLE);
-            /* fall through */
-        case HW_MODE_N:
-        case HW_MODE_G:
-        case HW_MODE_A:
-        case HW_MODE_ANY:
-            ulen = *tlen;
-            qsap_write_cfg(pcfg, &cmd_list[eCMD_IEEE80211N],ieee11n_enable, tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE);
-            break;
-        case HW_MODE_B:
-            ulen = *tlen;
-            qsap_write_cfg(pcfg, &cmd_list[eCMD_IEEE80211N],ieee11n_disable, tbuf, &ulen, HOSTAPD_CONF_QCOM_FILE);
-            break;
-        case HW_MODE_AD:
-            /** For 802.11ad, disable the 802.11 HT */
-            qsap_change_cfg(pcfg, &cmd_list[eCMD_HT_CAPAB], DISABLE);
-            break;
-    }
-    if(mode == HW_MODE_G_ONLY || mode == HW_MODE_N_ONLY || mode == HW_MODE_N ) {
-        qsap_scnprintf(pmode, pmode_len, "%s",hw_mode[HW_MODE_G]);
+    live_npending = 0;
+}
+
+/** Drop the pending updates of an instance being released, the transaction
+  * can not push them any more */
+static void qsap_live_release_ctx(struct qsap_ctx *pctx)
+{
+    u32 i, n = 0;
+
+    qsap_lock(QSAP_LOCK_WRITE);
+
+    for(i=0; i<live_npending; i++) {
+        if(live_pending[i].pctx != pctx)
+            live_pending[n++] = live_pending[i];
     }
-    return qsap_write_cfg(pcfg, &cmd_list[eCMD_HW_MODE], pmode, tbuf, tlen, HOSTAPD_CONF_QCOM_FILE);
+    live_npending = n;
+
+    qsap_unlock(NULL);
 }
 
-static int qsap_set_data_rate(s32 drate_idx, s8 *presp, u32 *plen)
+/**
+ * @brief
+ *        Check if a change of the parameter takes effect only after a
+ *        restart of the soft AP.
+ * @param cNum [IN] command number
+ * @return TRUE if a restart is needed, FALSE otherwise
+**/
+s32 qsap_param_needs_restart(esap_cmd_t cNum)
 {
-    u32 ulen;
-    s8 *pmode;
-    s8 sconf[MAX_INT_STR+1];
-    int ret = eERR_UNKNOWN;
+    if((cNum <= eCMD_INVALID) || (cNum >= eCMD_LAST))
+        return FALSE;
 
-    if(TRUE != IS_VALID_DATA_RATE_IDX(drate_idx)) {
-        ALOGE("%s :Invalid rate index \n", __func__);
-        goto end;
+    return (param_list[cNum].flags & QSAP_PARAM_RESTART) ? TRUE : FALSE;
+}
+
+/**
+ * @brief
+ *        Validate the value of a 'set' command against its descriptor and
+ *        apply it.
+ * @param cNum [IN] command number
+ * @param pVal [IN] value of the parameter, NULL for an action. An integer
+ *                  value is written back to pVal as "%d", so the buffer must
+ *                  hold at least MAX_INT_STR bytes.
+ * @param presp [OUT] buffer to store the command response
+ * @param plen [IN-OUT] length of the response buffer
+ * @return On success, eSUCCESS
+ *         eERR_INVALID_ARG if the command has no descriptor or the value
+ *         is missing,
+ *         eERR_NOT_READY if another thread has a transaction open,
+ *         eERR_INVALID_PARAM if the value is out of range,
+ *         or the error code of the failed update
+**/
+static s32 qsap_set_param(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pVal, s8 *presp, u32 *plen)
+{
+    const struct qsap_param *pparam;
+    s32 value = 0;
+    s32 status;
+
+    /** A command without an entry in param_list is all zero, an action with no handler */
+    if((cNum <= eCMD_INVALID) || (cNum >= eCMD_LAST) ||
+       ((param_list[cNum].type == QSAP_TYPE_NONE) && (param_list[cNum].set == NULL))) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_ARG);
+        return eERR_INVALID_ARG;
     }
+    pparam = &param_list[cNum];
 
-    ulen = *plen;
-    /** Read the current operating mode */
-    if(NULL == (pmode = qsap_get_config_value(pconffile, &cmd_list[eCMD_HW_MODE], presp, &ulen))) {
-        ALOGE("%s :Unable to read mode \n", __func__);
-        goto end;
+    /** The configuration belongs to the transaction of another thread until
+      * it ends. A command for hostapd only reads it, 'commit' and 'abort'
+      * do nothing out of a transaction */
+    if(qsap_tx_busy() && !(pparam->flags & QSAP_PARAM_CTRL) &&
+       (cNum != eCMD_COMMIT) && (cNum != eCMD_ABORT)) {
+        ALOGE("%s : %s rejected, a transaction is open \n", __func__, cmd_list[cNum].name);
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_NOT_READY);
+        return eERR_NOT_READY;
     }
 
-    /** Validate the rate index against the current operating mode */
-    if(((!strcmp(pmode, hw_mode[HW_MODE_B])) && (drate_idx > B_MODE_MAX_DATA_RATE_IDX)) ||
-        ((!strcmp(pmode, hw_mode[HW_MODE_G]) || (!strcmp(pmode, hw_mode[HW_MODE_G_ONLY]))) &&
-        (drate_idx > G_ONLY_MODE_MAX_DATA_RATE_IDX))) {
-        ALOGE("%s :Invalid rate index \n", __func__);
-        goto end;
+    if(pparam->type == QSAP_TYPE_NONE)
+        return pparam->set(pctx, cNum, pVal, value, presp, plen);
+
+    if((pVal == NULL) || (!(pparam->flags & QSAP_PARAM_EMPTY) && (*pVal == '\0'))) {
+        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_ARG);
+        return eERR_INVALID_ARG;
     }
 
-    qsap_scnprintf(sconf, sizeof(sconf), "%d", drate_idx);
+    ALOGE("Cmd: %s Argument :%s \n", cmd_list[cNum].name, pVal);
 
-    /** Update the rate index in the configuration */
-    return qsap_write_cfg(fIni, &qsap_str[STR_DATA_RATE_IN_INI], sconf, presp, plen, INI_CONF_FILE);
+    if(pparam->type == QSAP_TYPE_INT) {
+        value = atoi(pVal);
+        if((value < pparam->min) || (value > pparam->max))
+            goto error;
+        /** Write back the integer value. This is to avoid values like 01, 001, 0001
+          * being written to the configuration
+          */
+        qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
+    }
+    else {
+        value = strlen(pVal);
+        if(((value < pparam->min) || (value > pparam->max)) &&
+           !((value == 0) && (pparam->flags & QSAP_PARAM_EMPTY)))
+            goto error;
+    }
 
-end:
-    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_UNKNOWN);
+    if(pparam->set != NULL)
+        status = pparam->set(pctx, cNum, pVal, value, presp, plen);
+    else
+        status = qsap_set_param_value(pctx, cNum, pVal, presp, plen);
 
-    return ret;
+    if((eSUCCESS == status) && (pparam->flags & (QSAP_PARAM_LIVE | QSAP_PARAM_ACL)))
+        qsap_live_update(pctx, cNum, pVal);
+
+    return status;
+
+error:
+    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
+    return eERR_INVALID_PARAM;
 }
 
 /**
@@ -2567,7 +7108,9 @@ end:
  *     These commands are used to update the soft AP
  *     configuration information
  *
- * @param pcmd [IN]   pointer to the string, storing the command.
+ * @param pctx [IN] soft AP instance addressed by the request
+ * @param pcmd [IN]   pointer to the string, storing the command, after the
+ *                    "set" keyword and the configuration qualifier.
  * @param presp [OUT] pointer to the buffer, to store the command response.
  *                    The command output format :
  *                    On success,
@@ -2580,37 +7123,11 @@ end:
  * @return
  *         void
 */
-static void qsap_handle_set_request(s8 *pcmd, s8 *presp, u32 *plen)
+static void qsap_handle_set_request(struct qsap_ctx *pctx, s8 *pcmd, s8 *presp, u32 *plen)
 {
     esap_cmd_t cNum;
-    esap_str_t sNum = STR_DENY_MAC_FILE;
-    s8 *pVal, *pfile;
-    s8 filename[MAX_FILE_PATH_LEN];
-    u32 ulen;
-    s32 status;
-    s32 value;
-    s16 ini = HOSTAPD_CONF_QCOM_FILE;
-    s8 *pcfg = pconffile;
-
-    pcmd += strlen("set");
-
-    SKIP_BLANK_SPACE(pcmd);
+    s8 *pVal;
 
-    if(!(strncmp(pcmd, Conf_req[CONF_2g], strlen(Conf_req[CONF_2g])))) {
-           pcmd += strlen(Conf_req[CONF_2g]);
-           SKIP_BLANK_SPACE(pcmd);
-    } else if (!(strncmp(pcmd, Conf_req[CONF_5g], strlen(Conf_req[CONF_5g])))) {
-           pcmd += strlen(Conf_req[CONF_5g]);
-           SKIP_BLANK_SPACE(pcmd);
-    } else if (!(strncmp(pcmd, Conf_req[CONF_owe], strlen(Conf_req[CONF_owe])))) {
-           pcmd += strlen(Conf_req[CONF_owe]);
-           SKIP_BLANK_SPACE(pcmd);
-    } else if (!(strncmp(pcmd, Conf_req[CONF_60g], strlen(Conf_req[CONF_60g])))) {
-           pcmd += strlen(Conf_req[CONF_60g]);
-           SKIP_BLANK_SPACE(pcmd);
-    } else {
-	    // DO NOTHING
-    }
     cNum = qsap_get_cmd_num(pcmd);
     if(cNum == eCMD_INVALID) {
         *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_ARG);
@@ -2618,549 +7135,323 @@ static void qsap_handle_set_request(s8 *pcmd, s8 *presp, u32 *plen)
         return;
     }
     pVal = pcmd + strlen(cmd_list[cNum].name);
-    if( (cNum != eCMD_COMMIT) &&
-        (cNum != eCMD_RESET_TO_DEFAULT) &&
-        ((*pVal != '=') || (((eCMD_PASSPHRASE != cNum)) && (strlen(pVal) < 2)))) {
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_ARG);
-        return;
-    }
-
-    pVal++;
-
-    if((cNum != eCMD_COMMIT) && (cNum != eCMD_RESET_TO_DEFAULT)) {
-        ALOGE("Cmd: %s Argument :%s \n", cmd_list[cNum].name, pVal);
-    }
-    switch(cNum) {
-        case eCMD_ADD_TO_ALLOW:
-        case eCMD_REMOVE_FROM_ALLOW:
-            sNum = STR_ACCEPT_MAC_FILE;
-            /* fall through */
-
-        case eCMD_ADD_TO_DENY:
-        case eCMD_REMOVE_FROM_DENY:
-            ulen = MAX_FILE_PATH_LEN;
-            if(NULL != (pfile = qsap_get_allow_deny_file_name(pconffile, &qsap_str[sNum], filename, &ulen))) {
-                qsap_update_mac_list(pfile, cNum, pVal, presp, plen);
-            }
-            else {
-                *plen = qsap_scnprintf(presp, *plen, "%s", ERR_RES_UNAVAILABLE);
-            }
-            return;
-
-        case eCMD_SEC_MODE:
-            value = atoi(pVal);
-            if(FALSE == IS_VALID_SEC_MODE(value))
-                goto error;
-            /** Write back the integer value. This is to avoid values like 01, 001, 0001
-             * being written to the configuration.
-             */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            qsap_set_security_mode(pconffile, value, presp, plen);
-            return;
-
-        case eCMD_MAC_ACL:
-            value = atoi(pVal);
-            if(FALSE == IS_VALID_MAC_ACL(value))
-                goto error;
-
-            /** Write back the integer value. This is to avoid values like 01, 001, 0001
-              * being written to the configuration
-              */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-
-            if(ACL_ALLOW_LIST == value) {
-                value = ENABLE;
-                status = DISABLE;
-            }
-            else if(ACL_DENY_LIST == value){
-                value = DISABLE;
-                status = ENABLE;
-            }
-            else {
-                // must be ACL_ALLOW_AND_DENY_LIST
-                value = ENABLE;
-                status = ENABLE;
-            }
-
-            if(eERR_UNKNOWN != qsap_change_cfg(pconffile, &qsap_str[STR_ACCEPT_MAC_FILE], value)) {
-                if(eERR_UNKNOWN != qsap_change_cfg(pconffile, &qsap_str[STR_DENY_MAC_FILE], status))
-                {
-                    qsap_write_cfg(pconffile, &cmd_list[cNum], pVal, presp, plen, HOSTAPD_CONF_QCOM_FILE);
-                }
-                else {
-                    goto error;
-                }
-            }
-            else {
-                goto error;
-            }
-            return;
-
-        case eCMD_COMMIT:
-#if 0 // COMMIT is not required currently for ICS framework
-            if ( gIniUpdated ) {
-                status = wifi_qsap_reload_softap();
-                gIniUpdated = 0;
-            }
-            else {
-                status = commit();
-            }
-            *plen = qsap_scnprintf(presp, *plen, "%s", (status ==  eSUCCESS)? SUCCESS : ERR_UNKNOWN);
-#endif
-            *plen = qsap_scnprintf(presp, *plen, "%s", SUCCESS);
-            return;
-
-        case eCMD_ENABLE_SOFTAP:
-            value = atoi(pVal);
-
-            if(TRUE != IS_VALID_SOFTAP_ENABLE(value))
-                goto error;
-
-            if ( *pVal == '0' ) {
-                    status = wifi_qsap_unload_driver();
-            }
-            else {
-                status = wifi_qsap_load_driver();
-            }
-            *plen = qsap_scnprintf(presp, *plen, "%s", (status==eSUCCESS) ? SUCCESS : "failure Could not enable softap");
-            return;
-
-        case eCMD_ENABLE_WIGIG_SOFTAP:
-            value = atoi(pVal);
-
-            if (TRUE != IS_VALID_SOFTAP_ENABLE(value))
-                goto error;
-
-            if ( *pVal == '0' ) {
-                status = wifi_qsap_stop_wigig_softap();
-            }
-            else {
-                status = wifi_qsap_start_wigig_softap();
-            }
-            *plen = qsap_scnprintf(presp, *plen, "%s", (status==eSUCCESS) ? SUCCESS : "failure Could not enable Wigig softap");
-            return;
-        case eCMD_SSID:
-            value = strlen(pVal);
-            if(SSD_MAX_LEN < value)
-                goto error;
-            /* Disable ssid2 while setting ssid */
-            qsap_change_cfg(pcfg, &cmd_list[eCMD_SSID2], DISABLE);
-            break;
-
-        case eCMD_SET_MAX_CLIENTS:
-            value = strlen(pVal);
-            break;
-        case eCMD_BSSID:
-            value = atoi(pVal);
-            if(FALSE == IS_VALID_BSSID(value))
-                goto error;
-            /** Write back the integer value. This is to avoid values like 01, 001, 0001
-              * being written to the configuration
-              */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
-        case eCMD_PASSPHRASE:
-            value = strlen(pVal);
-            if(FALSE == IS_VALID_PASSPHRASE_LEN(value))
-                goto error;
-            break;
-
-        case eCMD_CHAN:
-            value = atoi(pVal);
-
-            ulen = MAX_FILE_PATH_LEN;
-            value = qsap_set_channel(value, filename, &ulen);
-
-            *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
-            return;
-
-        case eCMD_BCN_INTERVAL:
-            value = atoi(pVal);
-            if(FALSE == IS_VALID_BEACON(value))
-                goto error;
-            /** Write back the integer value. This is to avoid values like 01, 001, 0001
-              * being written to the configuration
-              */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
-
-        case eCMD_DTIM_PERIOD:
-            value = atoi(pVal);
-            if(FALSE == IS_VALID_DTIM_PERIOD(value))
-                goto error;
-            /** Write back the integer value. This is to avoid values like 01, 001, 0001
-              * being written to the configuration
-              */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
-
-        case eCMD_HW_MODE:
-            status = FALSE;
-            for(value=HW_MODE_B; value<HW_MODE_UNKNOWN; value++) {
-                if(!strcmp(pVal, hw_mode[value])) {
-                    status = TRUE;
-                    break;
-                }
-            }
-
-            if(status == FALSE)
-                goto error;
-
-            ulen = MAX_FILE_PATH_LEN;
-            /* pVal is anull terminated string */
-            value = qsap_set_operating_mode(value, pVal, strlen(pVal)+1, filename, &ulen);
-            *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
-            return;
-
-        case eCMD_AUTH_ALGS:
-            value = atoi(pVal);
-            if((value != AHTH_ALG_OPEN) && (value != AUTH_ALG_SHARED) &&
-                          (value != AUTH_ALG_OPEN_SHARED))
-                goto error;
-            /** Write back the integer value. This is to avoid values like 01, 001, 0001
-              * being written to the configuration
-              */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
-
-        case eCMD_DEFAULT_KEY:
-            value = atoi(pVal);
-            if(FALSE == IS_VALID_WEP_KEY_IDX(value))
-                goto error;
-             /** Write back the integer value. This is to avoid values like 01, 001, 0001
-               * being written to the configuration
-               */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-
-            qsap_write_cfg(pcfg, &cmd_list[cNum], pVal, presp, plen, ini);
-
-            ulen = MAX_FILE_PATH_LEN;
-            if(SEC_MODE_WEP != qsap_read_security_mode(pcfg, filename, &ulen)) {
-                if(eERR_UNKNOWN == qsap_change_cfg(pcfg, &cmd_list[cNum], 0)) {
-                    ALOGE("%s: eCMD_DEFAULT_KEY \n", __func__);
-                    goto error;
-                }
-            }
 
+    if(param_list[cNum].type != QSAP_TYPE_NONE) {
+        if(*pVal != '=') {
+            *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_ARG);
             return;
+        }
+        pVal++;
+    }
 
-        case eCMD_WPA_PAIRWISE:
-        case eCMD_RSN_PAIRWISE:
-            if(FALSE == IS_VALID_PAIRWISE(pVal))
-                goto error;
-
-            /** If the encryption type is TKIP, disable the 802.11 HT */
-            value = 1;
-            if(!strcmp(pVal, "TKIP")) {
-                value = 0;
-            }
-
-            if(eERR_UNKNOWN == qsap_change_cfg(pconffile, &qsap_str[STR_HT_80211N], value)) {
-                ALOGE("%s: unable to update 802.11 HT\n", __func__);
-                goto error;
-            }
-
-            break;
-
-        case eCMD_WEP_KEY0:
-        case eCMD_WEP_KEY1:
-        case eCMD_WEP_KEY2:
-        case eCMD_WEP_KEY3:
-            if(FALSE == is_valid_wep_key(pVal, filename, MAX_FILE_PATH_LEN))
-                goto error;
-
-            qsap_write_cfg(pcfg, &cmd_list[cNum], filename, presp, plen, ini);
-
-            /** if the security mode is not WEP, update the WEP features, and
-                do NOT set the WEP security */
-            ulen = MAX_FILE_PATH_LEN;
-            if(SEC_MODE_WEP != qsap_read_security_mode(pcfg, filename, &ulen)) {
-                if(eERR_UNKNOWN == qsap_change_cfg(pcfg, &cmd_list[cNum], 0)) {
-                    ALOGE("%s: CMD_WEP_KEY0 \n", __func__);
-                    goto error;
-                }
-            }
+    qsap_set_param(pctx, cNum, pVal, presp, plen);
 
-            return;
+    return;
+}
 
-        case eCMD_RESET_AP:
-            value = atoi(pVal);
-            ALOGE("Reset :%d \n", value);
-            if(SAP_RESET_BSS == value) {
-                status = wifi_qsap_stop_softap();
-                if(status == eSUCCESS) {
-                    status = wifi_qsap_start_softap();
-                    if (eSUCCESS != status)
-                        wifi_qsap_unload_driver();
-                }
-            }
-            else if(SAP_RESET_DRIVER_BSS == value){
-                status = wifi_qsap_reload_softap();
-            }
-            else if(SAP_STOP_BSS == value) {
-                status = wifi_qsap_stop_bss();
-            }
-            else if(SAP_STOP_DRIVER_BSS == value) {
-                status = wifi_qsap_stop_softap();
-                if(status == eSUCCESS)
-                    status = wifi_qsap_unload_driver();
-            }
-#ifdef QCOM_WLAN_CONCURRENCY
-            else if(SAP_INITAP == value) {
-                status = wifi_qsap_start_softap_in_concurrency();
-            }
-            else if(SAP_EXITAP == value) {
-                status = wifi_qsap_stop_softap_in_concurrency();
-            }
-#endif
-            else {
-                status = !eSUCCESS;
-            }
-            *plen = qsap_scnprintf(presp, *plen, "%s", (status == eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
-            return;
+/**
+ * @brief
+ *        Set an integer parameter of a soft AP instance, without
+ *        going through the text protocol.
+ * @param pctx [IN] soft AP instance
+ * @param cNum [IN] command number
+ * @param value [IN] value of the parameter
+ * @return On success, eSUCCESS
+ *         eERR_INVALID_ARG if cNum is not a settable parameter,
+ *         eERR_INVALID_PARAM if the value is out of range,
+ *         or the error code of the failed update
+**/
+s32 qsap_set_int_ctx(struct qsap_ctx *pctx, esap_cmd_t cNum, s32 value)
+{
+    s8 val[16];
+    s8 resp[MAX_RESP_LEN];
+    u32 len = MAX_RESP_LEN;
+    s32 status;
 
-        case eCMD_DISASSOC_STA:
-            qsap_disassociate_sta(pVal, presp, plen);
-            return;
+    if((cNum <= eCMD_INVALID) || (cNum >= eCMD_LAST) || (param_list[cNum].type == QSAP_TYPE_NONE))
+        return eERR_INVALID_ARG;
 
-        case eCMD_RESET_TO_DEFAULT:
-            if(eSUCCESS == (status = wifi_qsap_reset_to_default(pconffile, DEFAULT_CONFIG_FILE_PATH))) {
-                if(eSUCCESS == (status = wifi_qsap_reset_to_default(fIni, DEFAULT_INI_FILE))) {
-                    status = wifi_qsap_reload_softap();
-                }
-            }
-            *plen = qsap_scnprintf(presp, *plen, "%s", (status ==  eSUCCESS) ? SUCCESS : ERR_UNKNOWN);
-            return;
+    qsap_scnprintf(val, sizeof(val), "%d", value);
 
-        case eCMD_DATA_RATES:
-            value = atoi(pVal);
-            qsap_set_data_rate(value, presp, plen);
-            return;
-        case eCMD_UUID:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_UUID_LEN(value))
-                goto error;
-            break;
-        case eCMD_DEVICE_NAME:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_DEVICENAME_LEN(value))
-                goto error;
-            break;
-        case eCMD_MANUFACTURER:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_MANUFACTURER_LEN(value))
-                goto error;
-            break;
+    qsap_lock(QSAP_LOCK_WRITE);
+    qsap_check_config_files(pctx);
+    status = qsap_set_param(pctx, cNum, val, resp, &len);
+    qsap_unlock(NULL);
 
-        case eCMD_MODEL_NAME:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_MODELNAME_LEN(value))
-                goto error;
-            break;
+    return status;
+}
 
-        case eCMD_MODEL_NUMBER:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_MODELNUM_LEN(value))
-                goto error;
-            break;
+/** Set an integer parameter of the default instance, see qsap_set_int_ctx() */
+s32 qsap_set_int(esap_cmd_t cNum, s32 value)
+{
+    return qsap_set_int_ctx(DEFAULT_CTX, cNum, value);
+}
 
-        case eCMD_SERIAL_NUMBER:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_SERIALNUM_LEN(value))
-                goto error;
-            break;
+/**
+ * @brief
+ *        Set a string parameter of a soft AP instance, without
+ *        going through the text protocol. Integer parameters are accepted
+ *        in their decimal form.
+ * @param pctx [IN] soft AP instance
+ * @param cNum [IN] command number
+ * @param pval [IN] value of the parameter
+ * @return On success, eSUCCESS
+ *         eERR_INVALID_ARG if cNum is not a settable parameter,
+ *         eERR_INVALID_PARAM if the value is not valid,
+ *         or the error code of the failed update
+**/
+s32 qsap_set_str_ctx(struct qsap_ctx *pctx, esap_cmd_t cNum, const s8 *pval)
+{
+    s8 resp[MAX_RESP_LEN];
+    u32 len = MAX_RESP_LEN;
+    u32 size;
+    s8 *pbuf;
+    s32 status;
 
-        case eCMD_DEVICE_TYPE:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_DEV_TYPE_LEN(value))
-                goto error;
-            break;
+    if((cNum <= eCMD_INVALID) || (cNum >= eCMD_LAST) || (param_list[cNum].type == QSAP_TYPE_NONE) || (pval == NULL))
+        return eERR_INVALID_ARG;
 
-        case eCMD_OS_VERSION:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_OS_VERSION_LEN(value))
-                goto error;
-            break;
+    /** The handlers may write back a formatted value to the buffer */
+    size = strlen(pval) + MAX_INT_STR + 1;
+    if(NULL == (pbuf = malloc(size))) {
+        ALOGE("%s: out of memory\n", __func__);
+        return eERR_UNKNOWN;
+    }
+    qsap_scnprintf(pbuf, size, "%s", pval);
 
-        case eCMD_FRIENDLY_NAME:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_FRIENDLY_NAME_LEN(value))
-                goto error;
-            break;
+    qsap_lock(QSAP_LOCK_WRITE);
+    qsap_check_config_files(pctx);
+    status = qsap_set_param(pctx, cNum, pbuf, resp, &len);
+    qsap_unlock(NULL);
 
-        case eCMD_MANUFACTURER_URL:
-        case eCMD_MODEL_URL:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_URL_LEN(value))
-                goto error;
-            break;
+    free(pbuf);
 
-        case eCMD_MODEL_DESC:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_MODEL_DESC_LEN(value))
-                goto error;
-            break;
+    return status;
+}
 
-        case eCMD_UPC:
-            value = strlen(pVal);
-            if(TRUE != IS_VALID_UPC_LEN(value))
-                goto error;
-            break;
-        case eCMD_WMM_STATE:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_WMM_STATE(value))
-                goto error;
+/** Set a string parameter of the default instance, see qsap_set_str_ctx() */
+s32 qsap_set_str(esap_cmd_t cNum, const s8 *pval)
+{
+    return qsap_set_str_ctx(DEFAULT_CTX, cNum, pval);
+}
 
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
-        case eCMD_WPS_STATE:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_WPS_STATE(value))
-                goto error;
-            /** Write back the integer value. This is to avoid values like 01, 001, 0001
-              * being written to the configuration
-              */
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            qsap_update_wps_config(pVal, presp, plen);
-            return;
+/**
+ * @brief
+ *        Get the value of a parameter of a soft AP instance, without going
+ *        through the text protocol.
+ * @param pctx [IN] soft AP instance
+ * @param cNum [IN] command number
+ * @param pbuf [OUT] buffer to store the null terminated value
+ * @param plen [IN-OUT]
+ *                 [IN]: length of the buffer, pbuf
+ *                [OUT]: length of the value
+ * @return On success, eSUCCESS
+ *         eERR_INVALID_ARG if the parameter can not be read,
+ *         eERR_INVALID_PARAM if pbuf is too small for the value,
+ *         eERR_UNKNOWN otherwise
+**/
+s32 qsap_get_str_ctx(struct qsap_ctx *pctx, esap_cmd_t cNum, s8 *pbuf, u32 *plen)
+{
+    struct qsap_resp resp;
+    s8 *pval;
+    u32 prefix;
+    u32 vlen;
+    s32 status = eERR_UNKNOWN;
+    u8 mode = QSAP_LOCK_READ;
 
-        case eCMD_WPS_CONFIG_METHOD:
-            qsap_config_wps_method(pVal, presp, plen);
-            return;
+    if((cNum <= eCMD_INVALID) || (cNum >= eCMD_LAST) || (pbuf == NULL) || (plen == NULL) || (*plen < 1))
+        return eERR_INVALID_ARG;
 
-        case eCMD_PROTECTION_FLAG:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_PROTECTION(value))
-                goto error;
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            sNum = STR_PROT_FLAG_IN_INI;
-            ini = INI_CONF_FILE;
-            break;
+    if(eSUCCESS != qsap_resp_init_alloc(&resp))
+        return eERR_UNKNOWN;
 
-        case eCMD_FRAG_THRESHOLD:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_FRAG_THRESHOLD(value))
-                goto error;
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
+    do {
+        qsap_resp_reset(&resp);
+        qsap_lock(mode);
+        qsap_check_config_files(pctx);
+
+        qsap_cfg_pass_begin();
+        qsap_get_to_resp(pctx, cNum, &resp);
+        qsap_cfg_pass_end();
+    } while(qsap_unlock(&mode));
+
+    /** The response is "success <cmd>=<value>" */
+    prefix = strlen(SUCCESS) + 1 + strlen(cmd_list[cNum].name) + 1;
+    if(strncmp(resp.buf, SUCCESS " ", strlen(SUCCESS) + 1) || (resp.len < prefix) ||
+       strncmp(resp.buf + strlen(SUCCESS) + 1, cmd_list[cNum].name, strlen(cmd_list[cNum].name)) ||
+       (resp.buf[prefix-1] != '=')) {
+        if(!strcmp(resp.buf, ERR_INVALID_ARG))
+            status = eERR_INVALID_ARG;
+        goto end;
+    }
 
-        case eCMD_REGULATORY_DOMAIN:
-            value = atoi(pVal);
+    pval = resp.buf + prefix;
+    vlen = resp.len - prefix;
+    if(vlen >= *plen) {
+        status = eERR_INVALID_PARAM;
+        goto end;
+    }
 
-            if(TRUE != IS_VALID_802DOT11D_STATE(value))
-                goto error;
+    memcpy(pbuf, pval, vlen);
+    pbuf[vlen] = '\0';
+    *plen = vlen;
+    status = eSUCCESS;
 
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
+end:
+    free(resp.buf);
 
-        case eCMD_RTS_THRESHOLD:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_RTS_THRESHOLD(value))
-                goto error;
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
+    return status;
+}
 
-        case eCMD_GTK_TIMEOUT:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_GTK(value))
-                goto error;
+/** Get the value of a parameter of the default instance, see qsap_get_str_ctx() */
+s32 qsap_get_str(esap_cmd_t cNum, s8 *pbuf, u32 *plen)
+{
+    return qsap_get_str_ctx(DEFAULT_CTX, cNum, pbuf, plen);
+}
 
-            break;
+/**
+ * @brief
+ *        Get the value of an integer parameter of a soft AP instance.
+ * @param pctx [IN] soft AP instance
+ * @param cNum [IN] command number
+ * @param pvalue [OUT] value of the parameter
+ * @return On success, eSUCCESS
+ *         eERR_INVALID_PARAM if the value is not an integer,
+ *         or the error code of qsap_get_str_ctx
+**/
+s32 qsap_get_int_ctx(struct qsap_ctx *pctx, esap_cmd_t cNum, s32 *pvalue)
+{
+    s8 buf[16];
+    u32 len = sizeof(buf);
+    s8 *pend;
+    long value;
+    s32 status;
 
-        case eCMD_TX_POWER:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_TX_POWER(value))
-                goto error;
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            sNum = STR_TX_POWER_IN_INI;
-            ini = INI_CONF_FILE;
-            break;
+    if(pvalue == NULL)
+        return eERR_INVALID_ARG;
 
-        case eCMD_INTRA_BSS_FORWARD:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_INTRA_BSS_STATUS(value))
-                goto error;
+    if(eSUCCESS != (status = qsap_get_str_ctx(pctx, cNum, buf, &len)))
+        return status;
 
-            if(DISABLE == value) {
-                status = qsap_change_cfg(pcfg,
-                          &cmd_list[eCMD_INTRA_BSS_FORWARD],DISABLE);
-            }
-             else {
-                status = qsap_change_cfg(pcfg,
-                          &cmd_list[eCMD_INTRA_BSS_FORWARD],ENABLE);
-            }
-            *plen = qsap_scnprintf(presp, *plen, "%s", (status == eSUCCESS) ?
-                     SUCCESS : ERR_UNKNOWN);
-            return;
+    errno = 0;
+    value = strtol(buf, &pend, 10);
+    if((pend == buf) || (*pend != '\0') || (errno == ERANGE) ||
+       (value < INT_MIN) || (value > INT_MAX))
+        return eERR_INVALID_PARAM;
 
-        case eCMD_COUNTRY_CODE:
-            value = strlen(pVal);
-            if(value > CTRY_MAX_LEN )
-                goto error;
-            break;
+    *pvalue = (s32)value;
 
-        case eCMD_AP_AUTOSHUTOFF:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_APSHUTOFFTIME(value))
-                goto error;
-            /* copy a larger value back to pVal. Please pay special care
-             * in caller to make sure that the buffer has sufficient size. */
-            qsap_scnprintf(pVal, MAX_INT_STR, "%d", value*60);
-            sNum = STR_AP_AUTOSHUTOFF;
-            ini = INI_CONF_FILE;
-            break;
+    return eSUCCESS;
+}
 
-        case eCMD_AP_ENERGY_DETECT_TH:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_ENERGY_DETECT_TH(value))
-                goto error;
+/** Get the value of an integer parameter of the default instance, see qsap_get_int_ctx() */
+s32 qsap_get_int(esap_cmd_t cNum, s32 *pvalue)
+{
+    return qsap_get_int_ctx(DEFAULT_CTX, cNum, pvalue);
+}
 
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            sNum = STR_AP_ENERGY_DETECT_TH;
-            ini = INI_CONF_FILE;
-            break;
+/**
+ * @brief
+ *        Resolve the soft AP instance addressed by a request, from the
+ *        optional qualifier "dual2g", "dual5g", "owe" or "60g" at its start.
+ *        A qualifier always names one of the default instances.
+ * @param pctx [IN] instance the request is executed on
+ * @param ppreq [IN-OUT] request, after the "get" or "set" keyword. On return,
+ *                       it points after the qualifier and the blank spaces.
+ * @return instance of the qualifier, pctx if there is no qualifier
+**/
+static struct qsap_ctx *qsap_resolve_ctx(struct qsap_ctx *pctx, s8 **ppreq)
+{
+    s8 *preq = *ppreq;
+    u32 i, len;
+
+    for(i=0; i<CONF_REQ_LAST; i++) {
+        len = strlen(Conf_req[i]);
+        if(!strncmp(preq, Conf_req[i], len) && ((preq[len] == '\0') || isblank(preq[len]))) {
+            preq += len;
+            SKIP_BLANK_SPACE(preq);
+            *ppreq = preq;
+            return &std_ctx[i];
+        }
+    }
 
-        case eCMD_IEEE80211H:
-            value = atoi(pVal);
-            if(TRUE != IS_VALID_DFS_STATE(value))
-                goto error;
+    return pctx;
+}
 
-            qsap_scnprintf(pVal, strlen(pVal)+1, "%d", value);
-            break;
+/**
+ * @brief
+ *      Execute a request, and store the response
+ * @param pctx soft AP instance
+ * @param pcmd string containing the request, "get ..." or "set ..."
+ * @param pr response
+ * @return
+ *         void
+*/
+static void qsap_exec_request(struct qsap_ctx *pctx, s8 *pcmd, struct qsap_resp *pr)
+{
+    s8 *preq;
+    u8 mode = QSAP_LOCK_READ;
 
-        case eCMD_SET_CHANNEL_RANGE:
-            ALOGE("eCMD_SET_CHANNEL_RANGE pcmd :%s\n", pcmd);
-            value = qsap_set_channel_range(pcmd);
-           *plen = qsap_scnprintf(presp, *plen, "%s", (value == eSUCCESS) ? SUCCESS :
-                             ERR_UNKNOWN);
-            return;
-        case eCMD_SSID2:
-            /* Disable ssid while setting ssid2 */
-            qsap_change_cfg(pcfg, &cmd_list[eCMD_SSID], DISABLE);
-            break;
+    ALOGD("CMD INPUT  [%s][%u]\n", pcmd, pr->size);
+    /* Skip any blank spaces */
+    SKIP_BLANK_SPACE(pcmd);
+
+    if(!strncmp(pcmd, Cmd_req[eCMD_GET], strlen(Cmd_req[eCMD_GET])) && isblank(pcmd[strlen(Cmd_req[eCMD_GET])])) {
+        preq = pcmd + strlen(Cmd_req[eCMD_GET]);
+        SKIP_BLANK_SPACE(preq);
+        pctx = qsap_resolve_ctx(pctx, &preq);
 
-        default: ;
-            /** Do not goto error, in default case */
+        /** Run again holding the lock if a configuration file must be fixed */
+        do {
+            qsap_resp_reset(pr);
+            qsap_lock(mode);
+            qsap_check_config_files(pctx);
+            qsap_handle_get_request(pctx, preq, pr);
+        } while(qsap_unlock(&mode));
     }
 
-    if(ini == INI_CONF_FILE) {
-        ALOGD("WRITE TO INI FILE :%s\n", qsap_str[sNum].name);
-        qsap_write_cfg(fIni, &qsap_str[sNum], pVal, presp, plen, ini);
+    else if(!(strncmp(pcmd, Cmd_req[eCMD_SET], strlen(Cmd_req[eCMD_SET]))) && isblank(pcmd[strlen(Cmd_req[eCMD_SET])]) ) {
+        esap_cmd_t cNum;
+        u32 len;
+        s8 *pout;
+
+        preq = pcmd + strlen(Cmd_req[eCMD_SET]);
+        SKIP_BLANK_SPACE(preq);
+        pctx = qsap_resolve_ctx(pctx, &preq);
+
+        /** A command for hostapd only reads the configuration, the callers
+          * may send it in parallel */
+        cNum = qsap_get_cmd_num(preq);
+        if((cNum == eCMD_INVALID) || !(param_list[cNum].flags & QSAP_PARAM_CTRL))
+            mode = QSAP_LOCK_WRITE;
+
+        /** Run again holding the lock if a configuration file must be fixed,
+          * the command is not sent before */
+        do {
+            qsap_resp_reset(pr);
+            qsap_lock(mode);
+            qsap_check_config_files(pctx);
+            if(!cfg_lock_retry) {
+                pout = qsap_resp_space(pr, MAX_RESP_LEN, &len);
+                qsap_handle_set_request(pctx, preq, pout, &len);
+                pr->len += len;
+            }
+        } while(qsap_unlock(&mode));
     }
+
     else {
-        qsap_write_cfg(pcfg, &cmd_list[cNum], pVal, presp, plen, ini);
+        qsap_resp_printf(pr, "%s", ERR_INVALIDREQ);
     }
 
-    return;
+    ALOGD("CMD OUTPUT [%s]\nlen :%u\n\n", pr->buf, pr->len);
 
-error:
-    *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALID_PARAM);
     return;
 }
 
 /**
  * @brief
- *      Initiate the command and return response
+ *      Initiate the command on a soft AP instance and return response
+ * @param pctx soft AP instance
  * @param pcmd string containing the command request
  *     The format of the command is
  *         get param=value
@@ -3171,43 +7462,232 @@ error:
  * @return
  *         void
 */
+void qsap_hostd_exec_cmd_ctx(struct qsap_ctx *pctx, s8 *pcmd, s8 *presp, u32 *plen)
+{
+    struct qsap_resp resp;
+
+    qsap_resp_init(&resp, presp, *plen);
+    qsap_exec_request(pctx, pcmd, &resp);
+    *plen = resp.len;
+
+    return;
+}
+
+/** Initiate the command on the default instance, see qsap_hostd_exec_cmd_ctx() */
 void qsap_hostd_exec_cmd(s8 *pcmd, s8 *presp, u32 *plen)
 {
-    ALOGD("CMD INPUT  [%s][%u]\n", pcmd, *plen);
-    /* Skip any blank spaces */
-    SKIP_BLANK_SPACE(pcmd);
+    qsap_hostd_exec_cmd_ctx(DEFAULT_CTX, pcmd, presp, plen);
+}
+
+/**
+ * @brief
+ *      Execute a request, and return the whole response in an allocated
+ *      buffer, whatever its length.
+ * @param pctx [IN] soft AP instance
+ * @param pcmd [IN] string containing the command request, as for
+ *                  qsap_hostd_exec_cmd()
+ * @param ppresp [OUT] null terminated response, to be released with free()
+ * @param plen [OUT] length of the response
+ * @return On success, eSUCCESS
+ *         If the response buffer can not be allocated, eERR_UNKNOWN
+*/
+s32 qsap_hostd_exec_cmd_alloc_ctx(struct qsap_ctx *pctx, s8 *pcmd, s8 **ppresp, u32 *plen)
+{
+    struct qsap_resp resp;
+
+    if(eSUCCESS != qsap_resp_init_alloc(&resp))
+        return eERR_UNKNOWN;
+
+    qsap_exec_request(pctx, pcmd, &resp);
+
+    *ppresp = resp.buf;
+    *plen = resp.len;
+
+    return eSUCCESS;
+}
+
+/** Execute a request on the default instance, see qsap_hostd_exec_cmd_alloc_ctx() */
+s32 qsap_hostd_exec_cmd_alloc(s8 *pcmd, s8 **ppresp, u32 *plen)
+{
+    return qsap_hostd_exec_cmd_alloc_ctx(DEFAULT_CTX, pcmd, ppresp, plen);
+}
+
+/** Responses of the chunked reads in progress. The response is read on the
+  * first call and kept until its last chunk is returned, so that the chunks
+  * are parts of one response, whatever the updates made meanwhile. The
+  * cursor holds the token of the response, and the offset of the next chunk.
+  * The oldest response is dropped for a new one when the table is full */
+#define QSAP_CHUNK_MAX            (4)
+#define QSAP_CHUNK_OFFSET_BITS    (24)
+#define QSAP_CHUNK_OFFSET_MASK    ((1U << QSAP_CHUNK_OFFSET_BITS) - 1)
+#define QSAP_CHUNK_TOKEN_MAX      ((1U << (32 - QSAP_CHUNK_OFFSET_BITS)) - 1)
+
+static struct qsap_chunk_resp {
+    struct qsap_ctx *pctx;
+    u32  token;                /** 1 to QSAP_CHUNK_TOKEN_MAX, 0 if the entry is free */
+    u32  seq;                  /** order of the responses, to drop the oldest */
+    s8  *pcmd;                 /** request of the response */
+    s8  *buf;
+    u32  len;
+} chunk_resp[QSAP_CHUNK_MAX];
+static u32 chunk_seq;
+static pthread_mutex_t chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void qsap_chunk_free(struct qsap_chunk_resp *pc)
+{
+    free(pc->pcmd);
+    free(pc->buf);
+    memset(pc, 0, sizeof(*pc));
+}
+
+/** Drop the responses of an instance being released */
+static void qsap_chunk_release_ctx(struct qsap_ctx *pctx)
+{
+    u32 i;
 
-    if(!(strncmp(pcmd, Cmd_req[eCMD_SET], strlen(Cmd_req[eCMD_SET])))) {
-       if(!(strncmp(pcmd+4, Conf_req[CONF_2g], strlen(Conf_req[CONF_2g])))) {
-           pconffile = CONFIG_FILE_2G;
-       } else if (!(strncmp(pcmd+4, Conf_req[CONF_5g], strlen(Conf_req[CONF_5g])))) {
-           pconffile = CONFIG_FILE_5G;
-       } else if (!(strncmp(pcmd+4, Conf_req[CONF_owe], strlen(Conf_req[CONF_owe])))) {
-           pconffile = CONFIG_FILE_OWE;
-       } else if (!(strncmp(pcmd+4, Conf_req[CONF_60g], strlen(Conf_req[CONF_60g])))) {
-           pconffile = CONFIG_FILE_60G;
-       } else {
-           pconffile = CONFIG_FILE;
-       }
+    pthread_mutex_lock(&chunk_lock);
+    for(i=0; i<QSAP_CHUNK_MAX; i++) {
+        if(chunk_resp[i].token && (chunk_resp[i].pctx == pctx))
+            qsap_chunk_free(&chunk_resp[i]);
     }
+    pthread_mutex_unlock(&chunk_lock);
+}
 
-    check_for_configuration_files();
+/**
+ * @brief
+ *      Read the response of a "get" request in chunks, for a caller buffer
+ *      smaller than the response. The request is executed on the first call,
+ *      the following calls return the next chunks of the same response. A
+ *      chunk ends after a blank space or a new line when possible, so that a
+ *      list entry or a parameter is not split across chunks.
+ * @param pctx [IN] soft AP instance
+ * @param pcmd [IN] string containing a "get" request, the same on each call
+ * @param presp [OUT] buffer to store the null terminated chunk
+ * @param plen [IN-OUT]
+ *                 [IN] : length of the buffer, presp
+ *                [OUT]: length of the chunk
+ * @param pcursor [IN-OUT] 0 for the first call. It is 0 on return when the
+ *                         chunk is the last one, else the cursor of the next
+ *                         chunk, to be passed back unchanged.
+ * @return On success, eSUCCESS
+ *         For a request other than "get" or an invalid cursor, eERR_INVALID_ARG
+ *         If the response of the cursor was dropped, eERR_NOT_READY: the read
+ *         must start again with a cursor 0
+ *         If the response buffer can not be allocated, eERR_UNKNOWN
+*/
+s32 qsap_hostd_exec_cmd_chunk_ctx(struct qsap_ctx *pctx, s8 *pcmd, s8 *presp, u32 *plen, u32 *pcursor)
+{
+    struct qsap_chunk_resp *pc = NULL;
+    struct qsap_resp resp;
+    u32 offset, remain, len, i;
+    s32 status = eSUCCESS;
 
-    if(!strncmp(pcmd, Cmd_req[eCMD_GET], strlen(Cmd_req[eCMD_GET])) && isblank(pcmd[strlen(Cmd_req[eCMD_GET])])) {
-        qsap_handle_get_request(pcmd, presp, plen);
+    SKIP_BLANK_SPACE(pcmd);
+
+    if((*plen < 2) || strncmp(pcmd, Cmd_req[eCMD_GET], strlen(Cmd_req[eCMD_GET])) ||
+       !isblank(pcmd[strlen(Cmd_req[eCMD_GET])]))
+        return eERR_INVALID_ARG;
+
+    if(*pcursor == 0) {
+        if(eSUCCESS != qsap_resp_init_alloc(&resp))
+            return eERR_UNKNOWN;
+
+        qsap_exec_request(pctx, pcmd, &resp);
+
+        /** The whole response fits, it is not kept */
+        if(resp.len < *plen) {
+            memcpy(presp, resp.buf, resp.len + 1);
+            *plen = resp.len;
+            free(resp.buf);
+            return eSUCCESS;
+        }
+
+        if(resp.len > QSAP_CHUNK_OFFSET_MASK) {
+            free(resp.buf);
+            return eERR_UNKNOWN;
+        }
+
+        pthread_mutex_lock(&chunk_lock);
+        for(i=0; i<QSAP_CHUNK_MAX; i++) {
+            if(chunk_resp[i].token == 0) {
+                pc = &chunk_resp[i];
+                break;
+            }
+            if((pc == NULL) || (chunk_resp[i].seq < pc->seq))
+                pc = &chunk_resp[i];
+        }
+        if(pc->token)
+            qsap_chunk_free(pc);
+
+        if(NULL == (pc->pcmd = strdup(pcmd))) {
+            ALOGE("%s: out of memory\n", __func__);
+            pthread_mutex_unlock(&chunk_lock);
+            free(resp.buf);
+            return eERR_UNKNOWN;
+        }
+
+        pc->seq = ++chunk_seq;
+        pc->token = chunk_seq % QSAP_CHUNK_TOKEN_MAX + 1;
+        pc->pctx = pctx;
+        pc->buf = resp.buf;
+        pc->len = resp.len;
+    }
+    else {
+        pthread_mutex_lock(&chunk_lock);
+        for(i=0; i<QSAP_CHUNK_MAX; i++) {
+            if(chunk_resp[i].token && (chunk_resp[i].token == *pcursor >> QSAP_CHUNK_OFFSET_BITS) &&
+               (chunk_resp[i].pctx == pctx) && !strcmp(chunk_resp[i].pcmd, pcmd)) {
+                pc = &chunk_resp[i];
+                break;
+            }
+        }
+        if(pc == NULL) {
+            status = eERR_NOT_READY;
+            goto end;
+        }
     }
 
-    else if(!(strncmp(pcmd, Cmd_req[eCMD_SET], strlen(Cmd_req[eCMD_SET]))) && isblank(pcmd[strlen(Cmd_req[eCMD_SET])]) ) {
-        qsap_handle_set_request(pcmd, presp, plen);
+    offset = *pcursor & QSAP_CHUNK_OFFSET_MASK;
+    if(offset > pc->len) {
+        status = eERR_INVALID_ARG;
+        goto end;
+    }
+
+    remain = pc->len - offset;
+    len = remain;
+    if(remain > *plen - 1) {
+        len = *plen - 1;
+        for(i = len; i > 0; i--) {
+            if((pc->buf[offset + i - 1] == ' ') || (pc->buf[offset + i - 1] == '\n')) {
+                len = i;
+                break;
+            }
+        }
     }
 
+    memcpy(presp, pc->buf + offset, len);
+    presp[len] = '\0';
+    *plen = len;
+
+    if(len < remain) {
+        *pcursor = (pc->token << QSAP_CHUNK_OFFSET_BITS) | (offset + len);
+    }
     else {
-        *plen = qsap_scnprintf(presp, *plen, "%s", ERR_INVALIDREQ);
+        *pcursor = 0;
+        qsap_chunk_free(pc);
     }
 
-    ALOGD("CMD OUTPUT [%s]\nlen :%u\n\n", presp, *plen);
+end:
+    pthread_mutex_unlock(&chunk_lock);
+
+    return status;
+}
 
-    return;
+/** Read the response of a "get" request of the default instance in chunks,
+  * see qsap_hostd_exec_cmd_chunk_ctx() */
+s32 qsap_hostd_exec_cmd_chunk(s8 *pcmd, s8 *presp, u32 *plen, u32 *pcursor)
+{
+    return qsap_hostd_exec_cmd_chunk_ctx(DEFAULT_CTX, pcmd, presp, plen, pcursor);
 }
 
 /* netd and Froyo Native UI specific API */
@@ -3216,9 +7696,6 @@ void qsap_hostd_exec_cmd(s8 *pcmd, s8 *presp, u32 *plen)
 #define DEFAULT_CHANNEL      4
 #define DEFAULT_PASSPHRASE   "12345678"
 #define DEFAULT_AUTH_ALG     1
-#define RECV_BUF_LEN         255
-#define CMD_BUF_LEN          255
-#define SET_BUF_LEN          15
 
 /** Command input
     argv[3] = SSID,
@@ -3229,13 +7706,12 @@ void qsap_hostd_exec_cmd(s8 *pcmd, s8 *presp, u32 *plen)
 */
 int qsapsetSoftap(int argc, char *argv[])
 {
-    char cmdbuf[CMD_BUF_LEN];
-    char respbuf[RECV_BUF_LEN];
-    u32 rlen = RECV_BUF_LEN;
+    char ssid[SSD_MAX_LEN + 1];
+    struct qsap_ctx *pctx;
+    s8 *preq;
     int i;
     int hidden = 0;
     int sec = SEC_MODE_NONE;
-    char setCmd[SET_BUF_LEN] = "set";
     int offset = 0;
 
     ALOGD("%s, %s, %s, %d\n", __FUNCTION__, argv[0], argv[1], argc);
@@ -3249,65 +7725,55 @@ int qsapsetSoftap(int argc, char *argv[])
          && (strncmp(argv[2], Conf_req[CONF_2g], 4) == 0
              || strncmp(argv[2], Conf_req[CONF_owe], 3) == 0
              || strncmp(argv[2], Conf_req[CONF_60g], 3) == 0)) {
-            snprintf(setCmd, SET_BUF_LEN, "set %s", argv[2]);
             offset = 1;
             argc--;
     }
+    preq = offset ? argv[2] : "";
+    pctx = qsap_resolve_ctx(DEFAULT_CTX, &preq);
 
-    /* set interface */
-    if (argc > 2) {
-        snprintf(cmdbuf, CMD_BUF_LEN, "%s interface=%s", setCmd, argv[2 + offset]);
-    }
-    else {
-        snprintf(cmdbuf, CMD_BUF_LEN, "%s interface=%s", setCmd, DEFAULT_INTFERACE);
-    }
-    (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
+    qsap_lock(QSAP_LOCK_WRITE);
+    qsap_check_config_files(pctx);
+
+    /* Stage all the updates, the configuration is written once on commit */
+    qsap_begin_transaction();
 
+    /* set interface */
+    (void) qsap_set_str_ctx(pctx, eCMD_INTERFACE, (argc > 2) ? argv[2 + offset] : DEFAULT_INTFERACE);
 
     /** set SSID */
     if(argc > 3) {
         // In case of dual2g/5g, Set ssid2 with hex values to accomodate sapce and special characters.
-        if (offset)
-            qsap_scnprintf(cmdbuf, sizeof(cmdbuf), "%s ssid2=%s", setCmd, argv[3 + offset]);
-        else
-            qsap_scnprintf(cmdbuf, sizeof(cmdbuf), "%s ssid=%s",setCmd, argv[3]);
+        if(eSUCCESS != qsap_set_str_ctx(pctx, offset ? eCMD_SSID2 : eCMD_SSID, argv[3 + offset])) {
+            ALOGE("Failed to set ssid\n");
+            goto error;
+        }
     }
     else {
-        qsap_scnprintf(cmdbuf, sizeof(cmdbuf), "%s ssid=%s_%d", setCmd, DEFAULT_SSID, rand());
-    }
-    (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
-
-    if(strncmp("success", respbuf, rlen) != 0) {
-        ALOGE("Failed to set ssid\n");
-        return eERR_UNKNOWN;
+        qsap_scnprintf(ssid, sizeof(ssid), "%s_%d", DEFAULT_SSID, rand());
+        if(eSUCCESS != qsap_set_str_ctx(pctx, eCMD_SSID, ssid)) {
+            ALOGE("Failed to set ssid\n");
+            goto error;
+        }
     }
 
-    rlen = RECV_BUF_LEN;
     if (argc > 4) {
         if (strcmp(argv[4 + offset], "hidden") == 0) {
              hidden = 1;
         }
-        snprintf(cmdbuf, CMD_BUF_LEN, "%s ignore_broadcast_ssid=%d", setCmd, hidden);
-        (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
-        if(strncmp("success", respbuf, rlen) != 0) {
+        if(eSUCCESS != qsap_set_int_ctx(pctx, eCMD_BSSID, hidden)) {
             ALOGE("Failed to set ignore_broadcast_ssid \n");
-            return -1;
+            goto error;
         }
     }
     /** channel */
-    rlen = RECV_BUF_LEN;
     if(argc > 5) {
-        snprintf(cmdbuf, CMD_BUF_LEN, "%s channel=%d", setCmd, atoi(argv[5 + offset]));
-        (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
-
-        if(strncmp("success", respbuf, rlen) != 0) {
+        if(eSUCCESS != qsap_set_int_ctx(pctx, eCMD_CHAN, atoi(argv[5 + offset]))) {
             ALOGE("Failed to set channel \n");
-            return -1;
+            goto error;
         }
     }
 
     /** Security */
-    rlen = RECV_BUF_LEN;
     if(argc > 6) {
 
         /**TODO : need to identify the SEC strings for "wep", "wpa", "wpa2" */
@@ -3322,135 +7788,168 @@ int qsapsetSoftap(int argc, char *argv[])
 
         else if(!strcmp(argv[6 + offset], "wpa2-psk"))
             sec = SEC_MODE_WPA2_PSK;
-
-        qsap_scnprintf(cmdbuf, sizeof(cmdbuf), "%s security_mode=%d",setCmd, sec);
     }
     else {
-        qsap_scnprintf(cmdbuf, sizeof(cmdbuf) , "%s security_mode=%d", setCmd, DEFAULT_AUTH_ALG);
+        sec = DEFAULT_AUTH_ALG;
     }
 
-    (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
-
-    if(strncmp("success", respbuf, rlen) != 0) {
+    if(eSUCCESS != qsap_set_int_ctx(pctx, eCMD_SEC_MODE, sec)) {
         ALOGE("Failed to set security mode\n");
-        return -1;
+        goto error;
     }
 
     /** Key -- passphrase */
-    rlen = RECV_BUF_LEN;
     if ( (sec == SEC_MODE_WPA_PSK) || (sec == SEC_MODE_WPA2_PSK) ) {
         if(argc > 7) {
             /* If the input passphrase is more than 63 characters, consider first 63 characters only*/
             if ( strlen(argv[7 + offset]) > 63 ) argv[7 + offset][63] = '\0';
-            qsap_scnprintf(cmdbuf, CMD_BUF_LEN, "%s wpa_passphrase=%s",setCmd, argv[7 + offset]);
         }
-        else {
-            qsap_scnprintf(cmdbuf, sizeof(cmdbuf), "%s wpa_passphrase=%s", setCmd, DEFAULT_PASSPHRASE);
+        if(eSUCCESS != qsap_set_str_ctx(pctx, eCMD_PASSPHRASE, (argc > 7) ? argv[7 + offset] : DEFAULT_PASSPHRASE)) {
+            ALOGE("Failed to set passphrase \n");
+            goto error;
         }
     }
 
-    (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
-    if(strncmp("success", respbuf, rlen) != 0) {
-        ALOGE("Failed to set passphrase \n");
-        return -1;
-    }
-
-    rlen = RECV_BUF_LEN;
     if(argc > 8) {
-        qsap_scnprintf(cmdbuf, sizeof(cmdbuf), "%s max_num_sta=%d",setCmd, atoi(argv[8 + offset]));
-    }
-    (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
-
-    if(strncmp("success", respbuf, rlen) != 0) {
-        ALOGE("Failed to set maximun client connections number \n");
-        return -1;
+        if(eSUCCESS != qsap_set_int_ctx(pctx, eCMD_SET_MAX_CLIENTS, atoi(argv[8 + offset]))) {
+            ALOGE("Failed to set maximun client connections number \n");
+            goto error;
+        }
     }
-    rlen = RECV_BUF_LEN;
-
-    qsap_scnprintf(cmdbuf, sizeof(cmdbuf), "%s commit", setCmd);
-
-    (void) qsap_hostd_exec_cmd(cmdbuf, respbuf, &rlen);
 
-    if(strncmp("success", respbuf, rlen) != 0) {
+    if(eSUCCESS != qsap_commit_transaction()) {
         ALOGE("Failed to COMMIT \n");
+        qsap_unlock(NULL);
         return -1;
     }
 
+    qsap_unlock(NULL);
     return 0;
+
+error:
+    /* Drop the updates staged so far */
+    qsap_abort_transaction();
+    qsap_unlock(NULL);
+
+    return -1;
 }
 
 
-static int check_for_config_file_size(FILE *fp)
+/** Results for the accept list and the deny list */
+static struct qsap_file_check list_checked[2];
+
+/** Check if a file still has the identity recorded by its last check */
+static int qsap_file_check_match(struct qsap_file_check *pchk, struct stat *pst)
 {
-   int length = 0;
+    u32 seq = __atomic_load_n(&pchk->seq, __ATOMIC_ACQUIRE);
+    int match;
 
-   if( NULL != fp )
-   {
-      fseek(fp, 0L, SEEK_END);
-      length = ftell(fp);
-   }
+    if(seq & 1)
+        return FALSE;
 
-   return length;
+    match = __atomic_load_n(&pchk->valid, __ATOMIC_RELAXED) &&
+            (__atomic_load_n(&pchk->dev, __ATOMIC_RELAXED) == pst->st_dev) &&
+            (__atomic_load_n(&pchk->ino, __ATOMIC_RELAXED) == pst->st_ino) &&
+            (__atomic_load_n(&pchk->size, __ATOMIC_RELAXED) == pst->st_size) &&
+            (__atomic_load_n(&pchk->mtime.tv_sec, __ATOMIC_RELAXED) == pst->st_mtim.tv_sec) &&
+            (__atomic_load_n(&pchk->mtime.tv_nsec, __ATOMIC_RELAXED) == pst->st_mtim.tv_nsec);
+
+    /** The record did not change while it was compared */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return match && (__atomic_load_n(&pchk->seq, __ATOMIC_RELAXED) == seq);
 }
 
-void check_for_configuration_files(void)
+/** Record the identity of a file found valid, or forget it if 'pst' is NULL.
+  * Called with cfg_lock held */
+static void qsap_file_check_set(struct qsap_file_check *pchk, struct stat *pst)
 {
-    FILE * fp;
-    char *pfile;
+    u32 seq = pchk->seq;
 
-    /* Check if configuration files are present, if not create the default files */
+    __atomic_store_n(&pchk->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
 
-    /* If configuration file does not exist copy the default file */
-    if ( NULL == (fp = fopen(pconffile, "r")) ) {
-        wifi_qsap_reset_to_default(pconffile, DEFAULT_CONFIG_FILE_PATH);
+    if(NULL != pst) {
+        __atomic_store_n(&pchk->dev, pst->st_dev, __ATOMIC_RELAXED);
+        __atomic_store_n(&pchk->ino, pst->st_ino, __ATOMIC_RELAXED);
+        __atomic_store_n(&pchk->size, pst->st_size, __ATOMIC_RELAXED);
+        __atomic_store_n(&pchk->mtime.tv_sec, pst->st_mtim.tv_sec, __ATOMIC_RELAXED);
+        __atomic_store_n(&pchk->mtime.tv_nsec, pst->st_mtim.tv_nsec, __ATOMIC_RELAXED);
     }
-    else {
+    __atomic_store_n(&pchk->valid, (NULL != pst), __ATOMIC_RELAXED);
 
-        /* The configuration file could be of 0 byte size, replace with default */
-        if (check_for_config_file_size(fp) <= 0)
-            wifi_qsap_reset_to_default(pconffile, DEFAULT_CONFIG_FILE_PATH);
+    __atomic_store_n(&pchk->seq, seq + 2, __ATOMIC_RELEASE);
+}
 
-        fclose(fp);
-    }
+/**
+ * @brief
+ *        Make sure a configuration file exists and is not empty, else copy the
+ *        default file. The file is checked again only if it changed since it
+ *        was found valid.
+ * @param pchk [IN-OUT] result of the previous check of the file
+ * @param pfile [IN] file path
+ * @param pdefault [IN] default file path
+ * @param fix_mode [IN] if set, the file mode is set to 0660
+ * @return void
+*/
+static void qsap_check_file(struct qsap_file_check *pchk, s8 *pfile, s8 *pdefault, int fix_mode)
+{
+    struct stat st;
+
+    if((fstatat(AT_FDCWD, pfile, &st, 0) == 0) && (st.st_size > 0)) {
+        if(qsap_file_check_match(pchk, &st))
+            return;
+
+        if(fix_mode && ((st.st_mode & 0777) != 0660)) {
+            if(!qsap_lock_update())
+                return;
 
-    /* If Accept MAC list file does not exist, copy the default file */
-    if ( NULL == (fp = fopen(ACCEPT_LIST_FILE, "r")) ) {
-        wifi_qsap_reset_to_default(ACCEPT_LIST_FILE, DEFAULT_ACCEPT_LIST_FILE_PATH);
+            /* Provide read and write permissions to the owner */
+            if(chmod(pfile, 0660) < 0) {
+                ALOGE("Error changing permissions of %s to 0660: %s",
+                        pfile, strerror(errno));
+            }
+        }
+        /** A valid file is used as it is by a reader, only an update records it */
+        else if(cfg_lock_depth && (cfg_lock_mode == QSAP_LOCK_READ)) {
+            return;
+        }
     }
     else {
+        if(!qsap_lock_update())
+            return;
 
-        /* The configuration file could be of 0 byte size, replace with default */
-        if (check_for_config_file_size(fp) <= 0)
-            wifi_qsap_reset_to_default(ACCEPT_LIST_FILE, DEFAULT_ACCEPT_LIST_FILE_PATH);
+        /* The file does not exist, or is of 0 byte size, copy the default file */
+        qsap_file_check_set(pchk, NULL);
+        wifi_qsap_reset_to_default(pfile, pdefault);
 
-        fclose(fp);
+        if(fstatat(AT_FDCWD, pfile, &st, 0) < 0)
+            return;
     }
 
-    /* Provide read and write permissions to the owner */
-    pfile = ACCEPT_LIST_FILE;
-    if (chmod(pfile, 0660) < 0) {
-        ALOGE("Error changing permissions of %s to 0660: %s",
-                pfile, strerror(errno));
-    }
-    /* If deny MAC list file does not exist, copy the default file */
-    if ( NULL == (fp = fopen(DENY_LIST_FILE, "r")) ) {
-        wifi_qsap_reset_to_default(DENY_LIST_FILE, DEFAULT_DENY_LIST_FILE_PATH);
-    }
-    else {
+    qsap_file_check_set(pchk, &st);
+}
+
+/**
+ * @brief
+ *        Check if the configuration files of a request are present, if not
+ *        create the default files.
+ * @param pctx [IN] soft AP instance of the request
+**/
+static void qsap_check_config_files(struct qsap_ctx *pctx)
+{
+    qsap_check_file(&pctx->conf_check, pctx->conf, DEFAULT_CONFIG_FILE_PATH, FALSE);
+    qsap_check_file(&list_checked[0], ACCEPT_LIST_FILE, DEFAULT_ACCEPT_LIST_FILE_PATH, TRUE);
+    qsap_check_file(&list_checked[1], DENY_LIST_FILE, DEFAULT_DENY_LIST_FILE_PATH, TRUE);
 
-        /* The configuration file could be of 0 byte size, replace with default */
-        if (check_for_config_file_size(fp) <= 0)
-            wifi_qsap_reset_to_default(DENY_LIST_FILE, DEFAULT_DENY_LIST_FILE_PATH);
+    return;
+}
 
-        fclose(fp);
-    }
+void check_for_configuration_files(void)
+{
+    qsap_lock(QSAP_LOCK_WRITE);
+    qsap_check_config_files(DEFAULT_CTX);
+    qsap_unlock(NULL);
 
-    /* Provide read and write permissions to the owner */
-    pfile = DENY_LIST_FILE;
-    if (chmod(pfile, 0660) < 0) {
-        ALOGE("Error changing permissions of %s to 0660: %s",
-                pfile, strerror(errno));
-    }
     return;
 }
 
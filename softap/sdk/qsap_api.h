@@ -35,6 +35,7 @@
 extern "C" {
 #endif
 #include <android/log.h>
+#include <sys/types.h>
 typedef unsigned char      u8;
 typedef char               s8;
 typedef unsigned short int u16;
@@ -78,7 +79,10 @@ enum error_val {
     eERR_LOAD_FAILED_SOFTAP,
     eERR_SET_CHAN_RANGE,
     eERR_GET_AUTO_CHAN,
-    eERR_SET_TX_POWER
+    eERR_SET_TX_POWER,
+    eERR_INVALID_ARG,
+    eERR_INVALID_PARAM,
+    eERR_NOT_READY
 };
 
 #ifndef WIFI_DRIVER_CONF_FILE
@@ -268,7 +272,8 @@ enum eConf_req {
   * command names stored in the 'cmd_list'.
   *
   * Warning: An addtion of an entry in 'esap_cmd', should be followed
-  * by an addition of a command name string in the 'cmd_list' array
+  * by an addition of a command name string in the 'cmd_list' array,
+  * at the index of the new entry
   */
 typedef enum esap_cmd {
     eCMD_INVALID             = -1,
@@ -369,11 +374,15 @@ typedef enum esap_cmd {
     eCMD_ENABLE_EDMG         = 86,
     eCMD_EDMG_CHANNEL        = 87,
 
+    eCMD_BEGIN               = 88,
+    eCMD_ABORT               = 89,
+
     eCMD_LAST     /** New command numbers should be added above this */
 } esap_cmd_t;
 
 /** non-commands */
 typedef enum esap_str {
+    eSTR_INVALID                 = -1,
     STR_WPA                      = 0,
     STR_ACCEPT_MAC_FILE          = 1,
     STR_DENY_MAC_FILE            = 2,
@@ -624,9 +633,51 @@ typedef struct sap_auto_channel_info {
 /** Validate the 802dot11h state */
 #define IS_VALID_DFS_STATE(x) (((x == ENABLE) || (x == DISABLE)) ? TRUE: FALSE)
 
+/** Callback receiving one configuration parameter. The key and the value are
+  * not null terminated */
+typedef void (*qsap_config_cb_t)(void *ctx, const s8 *key, u32 klen, const s8 *val, u32 vlen);
+
+/** Soft AP instance: its configuration file, driver ini file, interface and
+  * the sockets used to reach the driver and hostapd. The functions without a
+  * context argument work on the default instance, qsap_ctx_default(). */
+typedef struct qsap_ctx qsap_ctx_t;
+
+/** Events of hostapd reported to the callbacks of qsap_event_register() */
+typedef enum esap_event {
+    eEVENT_STA_CONNECTED = 0,    /** AP-STA-CONNECTED */
+    eEVENT_STA_DISCONNECTED,     /** AP-STA-DISCONNECTED */
+    eEVENT_AP_ENABLED,           /** AP-ENABLED */
+    eEVENT_AP_DISABLED,          /** AP-DISABLED */
+    eEVENT_WPS,                  /** WPS-* */
+    eEVENT_DFS,                  /** DFS-* */
+    eEVENT_LAST
+} esap_event_t;
+
+#define QSAP_EVENT_MASK(e)    (1 << (e))
+#define QSAP_EVENT_ALL        (QSAP_EVENT_MASK(eEVENT_LAST) - 1)
+
+/** Event received from hostapd. The strings are valid during the callback only */
+struct qsap_event {
+    esap_event_t type;
+    u32    level;       /** level of the hostapd message, the N of "<N>" */
+    const s8 *name;     /** name of the event, e.g. "AP-STA-CONNECTED" */
+    const s8 *args;     /** arguments following the name, "" if none */
+    u8     mac[6];      /** station address of the station events */
+};
+
+/** Callback receiving the events of a soft AP instance, called from the event
+  * thread of the SDK */
+typedef void (*qsap_event_cb_t)(void *arg, qsap_ctx_t *pctx, const struct qsap_event *pevent);
+
+/** Callback receiving the completion of a command of qsap_ctrl_submit(). The
+  * reply is null terminated, valid during the callback only */
+typedef void (*qsap_ctrl_cb_t)(void *arg, u32 token, s32 status, const s8 *presp, u32 len);
+
 /** Function declartion */
 int qsap_hostd_exec(int argc, char ** argv);
 void qsap_hostd_exec_cmd(s8 *pcmd, s8 *presp, u32 *plen);
+s32 qsap_hostd_exec_cmd_alloc(s8 *pcmd, s8 **ppresp, u32 *plen);
+s32 qsap_hostd_exec_cmd_chunk(s8 *pcmd, s8 *presp, u32 *plen, u32 *pcursor);
 s8 *qsap_get_config_value(s8 *pfile, struct Command *pcmd, s8 *pbuf, u32 *plen);
 int qsapsetSoftap(int argc, char *argv[]);
 int qsap_add_or_remove_interface(const char *iface_name, int create_iface);
@@ -635,6 +686,36 @@ s16 wifi_qsap_reset_to_default(s8 *pcfgfile, s8 *pdefault);
 void check_for_configuration_files(void);
 void qsap_set_ini_filename(void);
 int qsap_set_channel_range(s8 * cmd);
+s32 qsap_param_needs_restart(esap_cmd_t cNum);
+s32 qsap_get_all_config(qsap_config_cb_t cb, void *ctx);
+s32 qsap_set_int(esap_cmd_t cNum, s32 value);
+s32 qsap_set_str(esap_cmd_t cNum, const s8 *pval);
+s32 qsap_get_int(esap_cmd_t cNum, s32 *pvalue);
+s32 qsap_get_str(esap_cmd_t cNum, s8 *pbuf, u32 *plen);
+qsap_ctx_t *qsap_ctx_create(const s8 *pconf, const s8 *pini, const s8 *piface);
+void qsap_ctx_destroy(qsap_ctx_t *pctx);
+qsap_ctx_t *qsap_ctx_default(void);
+void qsap_hostd_exec_cmd_ctx(qsap_ctx_t *pctx, s8 *pcmd, s8 *presp, u32 *plen);
+s32 qsap_hostd_exec_cmd_alloc_ctx(qsap_ctx_t *pctx, s8 *pcmd, s8 **ppresp, u32 *plen);
+s32 qsap_hostd_exec_cmd_chunk_ctx(qsap_ctx_t *pctx, s8 *pcmd, s8 *presp, u32 *plen, u32 *pcursor);
+s32 qsap_get_all_config_ctx(qsap_ctx_t *pctx, qsap_config_cb_t cb, void *ctx);
+s32 qsap_set_int_ctx(qsap_ctx_t *pctx, esap_cmd_t cNum, s32 value);
+s32 qsap_set_str_ctx(qsap_ctx_t *pctx, esap_cmd_t cNum, const s8 *pval);
+s32 qsap_get_int_ctx(qsap_ctx_t *pctx, esap_cmd_t cNum, s32 *pvalue);
+s32 qsap_get_str_ctx(qsap_ctx_t *pctx, esap_cmd_t cNum, s8 *pbuf, u32 *plen);
+int qsap_set_channel_range_ctx(qsap_ctx_t *pctx, s8 *cmd);
+int qsap_get_mode_ctx(qsap_ctx_t *pctx, s32 *pmode);
+void qsap_del_ctrl_iface_ctx(qsap_ctx_t *pctx);
+s8 *qsap_ctx_get_iface(qsap_ctx_t *pctx, s8 *pbuf, u32 *plen);
+int qsap_ctx_get_sock(qsap_ctx_t *pctx);
+pid_t *qsap_ctx_wigig_pid(qsap_ctx_t *pctx);
+s32 qsap_event_register(u32 mask, qsap_event_cb_t cb, void *arg, u32 *pid);
+s32 qsap_event_register_ctx(qsap_ctx_t *pctx, u32 mask, qsap_event_cb_t cb, void *arg, u32 *pid);
+s32 qsap_event_unregister(u32 id);
+s32 qsap_ctrl_submit(const s8 *pcmd, qsap_ctrl_cb_t cb, void *arg, u32 *ptoken);
+s32 qsap_ctrl_submit_ctx(qsap_ctx_t *pctx, const s8 *pcmd, qsap_ctrl_cb_t cb, void *arg, u32 *ptoken);
+s32 qsap_ctrl_result(u32 token, s32 *pstatus, s8 *presp, u32 *plen);
+int qsap_ctrl_get_fd(void);
 int qsap_get_sap_auto_channel_slection(s32 *pautochan);
 int qsap_get_mode(s32 *pmode);
 int qsap_prepare_softap(void);